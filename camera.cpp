@@ -3,16 +3,17 @@
 
 #include "camera.h"
 #include "transform.h"
-#include "cxx_exception.h"
-
-#include <QFile>
-#include <QFileInfo>
-#include <QImage>
+#include "ray_replay.h"
+#include "ray_file_writer.h"
+#include "rnd.h"
+#include "canvas_image_converter.h"
+#include "ray_tracer.h"
 
 namespace raytracer {
 
 Camera::Camera() :
-    m_transform(fsmx::identity<m4f>())
+    m_transform(fsmx::identity<m4f>()),
+    m_compressRays(false)
 {
 }
 
@@ -26,75 +27,132 @@ void Camera::setTransform(const m4f& transform)
     m_transform = transform;
 }
 
+void Camera::finish()
+{
+    if (m_raysWriter)
+        m_raysWriter->close();
+}
+
+QString Camera::name() const
+{
+    return m_name;
+}
+
+void Camera::setName(const QString& name)
+{
+    m_name = name;
+}
+
+QString Camera::raysInputFileName() const
+{
+    return m_raysInputFileName;
+}
+
+void Camera::setRaysInputFileName(const QString& fileName)
+{
+    m_raysInputFileName = fileName;
+}
+
+QString Camera::verticesInputFileName() const
+{
+    return m_verticesInputFileName;
+}
+
+void Camera::setVerticesInputFileName(const QString& fileName)
+{
+    m_verticesInputFileName = fileName;
+}
+
+QString Camera::raysOutputFileName() const
+{
+    return m_raysOutputFileName;
+}
+
+void Camera::setRaysOutputFileName(const QString& fileName, bool compress)
+{
+    m_raysOutputFileName = fileName;
+    m_compressRays = compress;
+}
+
 void Camera::read(const QVariant& v)
 {
     m_transform = fsmx::identity<m4f>();
     Transform::Ptr t;
     if (readOptionalTypedProperty(t, v, "transform"))
         (*t)(m_transform);
+    m_name.clear();
+    readOptionalProperty(m_name, v, "name");
+    m_raysInputFileName.clear();
+    readOptionalProperty(m_raysInputFileName, v, "read_rays");
+    m_verticesInputFileName.clear();
+    readOptionalProperty(m_verticesInputFileName, v, "read_vertices");
+    m_raysOutputFileName.clear();
+    readOptionalProperty(m_raysOutputFileName, v, "write_rays");
+    m_compressRays = false;
+    readOptionalProperty(m_compressRays, v, "compress_rays");
 }
 
 void Camera::readRays(const QString& fileName)
 {
-    QFile f(fileName);
-    if (!f.open(QIODevice::ReadOnly)) {
-        QFileInfo fi(fileName);
-        throw cxx::exception(std::string("Failed to open rays input '") + fi.absoluteFilePath().toStdString() + "'");
-    }
-    SurfaceProperties *surfProp = cameraPrimitive()->surfaceProperties().get();
-    Q_ASSERT(surfProp);
-    SurfacePoint sp = fsmx::zero<SurfacePoint>();
-    RayTracer *rt = nullptr;
-    const quint64 RayDataSize = sizeof(RayData);
-    forever {
-        RayData rd;
-        if (f.read(reinterpret_cast<char*>(&rd), RayDataSize) != RayDataSize)
-            break;
-        sppos(sp) = rd.collisionPos;
-        surfProp->processCollision(rd.ray, sp, *rt);
-    }
-}
-
-QImage Camera::Canvas::toImage() const
-{
-    QImage image(m_size[0], m_size[1], QImage::Format_RGB32);
-    if (empty())
-        return image;
-
-    // Determine canvas color range
-    auto minIntensity = m_data[0][0];
-    auto maxIntensity = minIntensity;
-    std::for_each(begin(), end(), [&minIntensity, &maxIntensity](const v3f& color) {
-        for (int i=0; i< 3; ++i) {
-            auto intensity = color[i];
-            if (minIntensity > intensity)
-                minIntensity = intensity;
-            else if (maxIntensity < intensity)
-                maxIntensity = intensity;
-        }
-    });
-
-    // In case of monotonous color, return all-black or all-gray image
-    if (minIntensity == maxIntensity) {
-        image.fill(minIntensity == 0.f ?   0xff000000u :   0xff888888u);
-        return image;
-    }
-
-    // Copy canvas pixels to the image
-    uchar *bits = image.bits();
-    v2i xy;
-    int idx;
-    for (xy[1]=m_size[1]-1; xy[1]>=0; --xy[1])
-        for (xy[0]=0, idx=index(xy); xy[0]<m_size[0]; ++xy[0], ++idx) {
-            bits[3] = 0xff;
-            for (int i=0; i<3; ++i) {
-                auto& color = pixel(idx);
-                auto normalizedIntensity = (color[i] - minIntensity) / (maxIntensity - minIntensity);
-                bits[2-i] = static_cast<uchar>(normalizedIntensity * 255.999);
-            }
-            bits += 4;
-        }
-    return image;
+    RayReplay(fileName).run(std::vector<Camera*>(1, this));
+}
+
+void Camera::splat(Canvas& canvas, const v2i& xy, const Ray& ray, const RayTracer& rayTracer)
+{
+    canvas.add(xy, ray.color, canvas.layerCount() == 0 ?   -1 :   rayTracer.currentLightGroup(), ray.generation, rayTracer.raySourceFeatures());
+}
+
+void Camera::resetRaysWriter(RayFileFormat::Header& header)
+{
+    m_raysWriter.reset();
+    if (m_raysOutputFileName.isEmpty())
+        return;
+    header.setCameraName(m_name);
+    header.setCameraTransform(m_transform);
+    header.seed = rnd::seed();
+    m_raysWriter = std::make_shared<RayFileWriter>(m_raysOutputFileName, header, m_compressRays);
+}
+
+const std::shared_ptr<RayFileWriter>& Camera::raysWriter() const
+{
+    return m_raysWriter;
+}
+
+Camera::Canvas Camera::Canvas::relight(const std::vector<v3f>& factors) const
+{
+    Q_ASSERT(factors.size() == m_layers.size());
+    Canvas result;
+    result.m_size = m_size;
+    result.m_data = m_data;
+    for (std::size_t i=0; i<m_layers.size(); ++i)
+        m_layers[i].addTo(result.m_data.data(), factors[i] - mkv3f(1.f, 1.f, 1.f));
+    result.copyFeatureBuffers(*this);
+    return result;
+}
+
+Camera::Canvas Camera::Canvas::limitBounces(int maxGeneration) const
+{
+    if (maxGeneration >= bounceLayerCount())
+        return *this;
+    Canvas result(m_size);
+    for (int i=0; i<=maxGeneration; ++i)
+        m_bounceLayers[i].addTo(result.m_data.data(), mkv3f(1.f, 1.f, 1.f));
+    result.copyFeatureBuffers(*this);
+    return result;
+}
+
+void Camera::Canvas::copyFeatureBuffers(const Canvas& that)
+{
+    Q_ASSERT(m_size[0] == that.m_size[0]   &&   m_size[1] == that.m_size[1]);
+    m_sampleCounts = that.m_sampleCounts;
+    m_squaredLuminanceSums = that.m_squaredLuminanceSums;
+    m_normalSums = that.m_normalSums;
+    m_albedoSums = that.m_albedoSums;
+}
+
+QImage Camera::Canvas::toImage(QImage::Format format) const
+{
+    return CanvasImageConverter(format).convert(*this);
 }
 
 } // end namespace raytracer
@@ -6,11 +6,17 @@
 
 #include "primitive.h"
 #include "ray.h"
+#include "ray_file_format.h"
+#include "sparse_canvas.h"
 
-class QImage;
+#include <QStringList>
+#include <QImage>
 
 namespace raytracer {
 
+class RayFileWriter;
+class RayTracer;
+
 /// \brief Interface for a camera.
 class Camera :
         public Readable,
@@ -22,6 +28,14 @@ public:
     public:
         Canvas() : m_size(fsmx::zero<v2i>()) {}
         Canvas(const v2i& size) : m_size(size), m_data(size[0]*size[1], fsmx::zero<v3f>()) {}
+
+        /// \brief Returns canvas of the size specified, whose pixels are not initialized.
+        static Canvas uninitialized(const v2i& size) {
+            Canvas result;
+            result.m_size = size;
+            result.m_data.resize(size[0]*size[1]);
+            return result;
+        }
         const v2i& size() const { return m_size; }
         std::vector< v3f >::size_type length() const { return m_data.size(); }
         bool empty() const { return m_data.empty(); }
@@ -56,12 +70,134 @@ public:
         std::vector< v3f >::iterator end() { return m_data.end(); }
         std::vector< v3f >::const_iterator begin() const { return m_data.begin(); }
         std::vector< v3f >::const_iterator end() const { return m_data.end(); }
-        QImage toImage() const;
+        /// \brief Adds pixels of \a that; layers and bounce layers are added
+        /// if both canvases have the same ones.
+        Canvas& operator+=(const Canvas& that) {
+            Q_ASSERT(m_size[0] == that.m_size[0]   &&   m_size[1] == that.m_size[1]);
+            auto src = that.m_data.begin();
+            for (auto& pixel : m_data)
+                pixel += *src++;
+            if (that.m_layerNames == m_layerNames)
+                for (std::size_t i=0; i<m_layers.size(); ++i)
+                    m_layers[i] += that.m_layers[i];
+            if (that.m_bounceLayers.size() == m_bounceLayers.size())
+                for (std::size_t i=0; i<m_bounceLayers.size(); ++i)
+                    m_bounceLayers[i] += that.m_bounceLayers[i];
+            if (hasFeatureBuffers()   &&   that.hasFeatureBuffers())
+                for (std::size_t i=0; i<m_sampleCounts.size(); ++i) {
+                    m_sampleCounts[i] += that.m_sampleCounts[i];
+                    m_squaredLuminanceSums[i] += that.m_squaredLuminanceSums[i];
+                    m_normalSums[i] += that.m_normalSums[i];
+                    m_albedoSums[i] += that.m_albedoSums[i];
+                }
+            return *this;
+        }
+
+        /// \brief Adds \a color to pixel \a xy, to layer \a layer, if it exists,
+        /// and to the bounce layer of ray generation \a generation, if it exists.
+        ///
+        /// If the canvas has feature buffers, the sample is also counted there, along with
+        /// \a features of the surface the ray comes from, if known.
+        void add(const v2i& xy, const v3f& color, int layer, int generation, const SurfaceFeatures *features = nullptr) {
+            pixel(xy) += color;
+            if (layer >= 0   &&   layer < layerCount())
+                m_layers[layer].add(xy, color);
+            if (generation >= 0   &&   generation < bounceLayerCount())
+                m_bounceLayers[generation].add(xy, color);
+            if (!m_sampleCounts.empty()) {
+                int i = index(xy);
+                float luminance = (color[0] + color[1] + color[2]) / 3.f;
+                m_sampleCounts[i] += 1.f;
+                m_squaredLuminanceSums[i] += luminance*luminance;
+                if (features) {
+                    m_normalSums[i] += features->normal;
+                    m_albedoSums[i] += features->albedo;
+                }
+            }
+        }
+
+        /// \brief Creates empty layers with the names specified, replacing existing ones.
+        ///
+        /// Layers keep parts of the image separately, e.g., contributions of light
+        /// groups (see RayTracer::Options::lightCanvases), so that they can be
+        /// recombined with different weights after rendering (see relight()).
+        void setLayers(const QStringList& names) {
+            m_layerNames = names;
+            m_layers.assign(names.size(), SparseCanvas(m_size));
+        }
+        int layerCount() const { return m_layers.size(); }
+        const QStringList& layerNames() const { return m_layerNames; }
+        const SparseCanvas& layer(int index) const {
+            Q_ASSERT(index >= 0   &&   index < layerCount());
+            return m_layers[index];
+        }
+
+        /// \brief Returns a copy of the canvas, without layers, in which the contribution
+        /// of each layer is multiplied component-wise by the corresponding element of \a factors.
+        ///
+        /// Parts of the image not contained in any layer are kept as they are;
+        /// feature buffers are copied.
+        Canvas relight(const std::vector<v3f>& factors) const;
+
+        /// \brief Creates \a count empty bounce layers, replacing existing ones.
+        ///
+        /// Bounce layer \a g keeps contributions of rays of generation \a g, i.e.,
+        /// of light reflected \a g times (see RayTracer::Options::bounceCanvases).
+        /// Contributions of rays of generations not less than \a count are only
+        /// added to the canvas.
+        void setBounceLayerCount(int count) {
+            m_bounceLayers.assign(count, SparseCanvas(m_size));
+        }
+        int bounceLayerCount() const { return m_bounceLayers.size(); }
+        const SparseCanvas& bounceLayer(int generation) const {
+            Q_ASSERT(generation >= 0   &&   generation < bounceLayerCount());
+            return m_bounceLayers[generation];
+        }
+
+        /// \brief Creates or removes per-pixel buffers guiding the denoiser (see DenoiseImage).
+        ///
+        /// For each pixel, the buffers keep the number of samples added, the sum of squared
+        /// sample luminances, estimating the variance of the pixel value, and the sums of
+        /// normals and albedos of the surfaces the samples come from
+        /// (see RayTracer::Options::featureCanvases).
+        void setFeatureBuffers(bool enabled) {
+            std::size_t n = enabled ?   m_data.size() :   0;
+            m_sampleCounts.assign(n, 0.f);
+            m_squaredLuminanceSums.assign(n, 0.f);
+            m_normalSums.assign(n, fsmx::zero<v3f>());
+            m_albedoSums.assign(n, fsmx::zero<v3f>());
+        }
+        bool hasFeatureBuffers() const { return !m_sampleCounts.empty(); }
+        const std::vector<float>& sampleCounts() const { return m_sampleCounts; }
+        const std::vector<float>& squaredLuminanceSums() const { return m_squaredLuminanceSums; }
+        const std::vector<v3f>& normalSums() const { return m_normalSums; }
+        const std::vector<v3f>& albedoSums() const { return m_albedoSums; }
+
+        /// \brief Replaces feature buffers with those of \a that, which must be of the same size.
+        void copyFeatureBuffers(const Canvas& that);
+
+        /// \brief Returns the canvas as if rays of generations greater than
+        /// \a maxGeneration were not traced.
+        ///
+        /// The result has no layers but keeps feature buffers; the canvas is returned as is if it has
+        /// no bounce layers or \a maxGeneration is not less than bounceLayerCount().
+        Canvas limitBounces(int maxGeneration) const;
+
+        /// \brief Converts the canvas to an image (see CanvasImageConverter).
+        QImage toImage(QImage::Format format = QImage::Format_RGB32) const;
     private:
         v2i m_size;
         std::vector< v3f > m_data;
+        QStringList m_layerNames;
+        std::vector< SparseCanvas > m_layers;
+        std::vector< SparseCanvas > m_bounceLayers;
+        std::vector< float > m_sampleCounts;
+        std::vector< float > m_squaredLuminanceSums;
+        std::vector< v3f > m_normalSums;
+        std::vector< v3f > m_albedoSums;
     };
 
+    /// \brief Ray data in the legacy rays file format (see RayFileReader).
     struct RayData {
         Ray ray;
         v3f collisionPos;
@@ -90,19 +226,96 @@ public:
     /// \brief Returns camera canvas.
     virtual const Canvas& canvas() const = 0;
 
+    /// \brief Returns camera canvas, overload.
+    virtual Canvas& canvas() = 0;
+
+    /// \brief Creates surface properties processing collisions with the camera primitive
+    /// as cameraPrimitive() does, but accumulating the image in \a canvas.
+    ///
+    /// Used to replay rays from a file (see RayReplay) into a canvas per thread, and to
+    /// render light path vertices (see verticesInputFileName()); the returned object does
+    /// not write rays to a file and refers to the camera, which must not change while
+    /// the object is in use.
+    virtual SurfaceProperties::Ptr makeSurfaceProperties(Canvas& canvas) const = 0;
+
+    /// \brief Adds the color of \a ray hitting pixel \a xy to \a canvas, including its layer
+    /// of the current light group and its bounce layer, along with features of the surface
+    /// the ray comes from (see Canvas::add()).
+    ///
+    /// To be called by surface properties of camera primitives; layers are not used
+    /// when \a canvas has none.
+    static void splat(Canvas& canvas, const v2i& xy, const Ray& ray, const RayTracer& rayTracer);
+
+    /// \brief Called when ray tracing finishes or is terminated.
+    ///
+    /// The default implementation closes the rays output file, if any.
+    virtual void finish();
+
     /// \brief Returns primitive transformation matrix.
     const m4f& transform() const;
 
     /// \brief Sets primitive transformation matrix.
     void setTransform(const m4f &transform);
 
-    /// \brief Reads camera transformation.
+    /// \brief Returns camera name (empty by default).
+    QString name() const;
+
+    /// \brief Sets camera name.
+    void setName(const QString& name);
+
+    /// \brief Returns name of the file to replay rays from (empty by default).
+    ///
+    /// Rays are replayed by RayTracer::run(), after clear() and before ray tracing.
+    QString raysInputFileName() const;
+
+    /// \brief Sets name of the file to replay rays from.
+    void setRaysInputFileName(const QString& fileName);
+
+    /// \brief Returns name of the file to render light path vertices from (empty by default).
+    ///
+    /// The file is written by RayTracer (see LightVertexCache); each vertex is connected
+    /// to the camera screen by RayTracer::run(), after clear(), in a run that traces no
+    /// light (see RayTracer::Options::traceLight); the connecting rays are not written to
+    /// the rays file of the camera. Only light scattered by diffuse surfaces is rendered
+    /// this way: light sources seen directly and paths reaching the camera via mirrors
+    /// or refraction are missing.
+    QString verticesInputFileName() const;
+
+    /// \brief Sets name of the file to render light path vertices from.
+    void setVerticesInputFileName(const QString& fileName);
+
+    /// \brief Returns name of the file to write rays hitting the camera to (empty by default).
+    QString raysOutputFileName() const;
+
+    /// \brief Sets name of the file to write rays to; \a compress enables chunk compression.
+    ///
+    /// The file is created by clear().
+    void setRaysOutputFileName(const QString& fileName, bool compress = false);
+
+    /// \brief Reads camera transformation, name, rays input and output files, and vertices input file.
     void read(const QVariant& v);
 
-    /// \brief Reads RayData from a file and processes the corresponding rays.
+    /// \brief Reads rays from a file (see RayFileReader) and processes them.
     void readRays(const QString& fileName);
+
+protected:
+    /// \brief Creates rays output file if it is specified, otherwise resets the rays writer.
+    ///
+    /// To be called by clear(). Camera name, transformation and random seed are set in
+    /// \a header by this method; all other header fields must be set by the caller.
+    void resetRaysWriter(RayFileFormat::Header& header);
+
+    /// \brief Returns rays writer created by resetRaysWriter(), or null.
+    const std::shared_ptr<RayFileWriter>& raysWriter() const;
+
 private:
     m4f m_transform;
+    QString m_name;
+    QString m_raysInputFileName;
+    QString m_verticesInputFileName;
+    QString m_raysOutputFileName;
+    bool m_compressRays;
+    std::shared_ptr<RayFileWriter> m_raysWriter;
 };
 
 } // end namespace raytracer
@@ -0,0 +1,701 @@
+/// \file
+/// \brief Implementation of the CanvasFile class.
+
+#include "canvas_file.h"
+#include "worker_pool.h"
+#include "math_util.h"
+#include "cxx_exception.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+
+namespace raytracer {
+
+namespace {
+
+static_assert(sizeof(v3f) == 3*sizeof(float), "Canvas pixels are expected to be three packed floats");
+
+void fail(const std::string& message, const QString& fileName)
+{
+    throw cxx::exception(message + " '" + QFileInfo(fileName).absoluteFilePath().toStdString() + "'");
+}
+
+std::vector<char> readFile(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        fail("Failed to open canvas input", fileName);
+    std::vector<char> result(file.size());
+    if (file.read(result.data(), result.size()) != static_cast<qint64>(result.size()))
+        fail("Failed to read canvas input", fileName);
+    return result;
+}
+
+void writeFile(const QString& fileName, const std::vector< std::vector<char> >& parts)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        fail("Failed to open canvas output", fileName);
+    for (const auto& part : parts)
+        if (file.write(part.data(), part.size()) != static_cast<qint64>(part.size()))
+            fail("Failed to write canvas output", fileName);
+}
+
+template<class T>
+void append(std::vector<char>& buffer, const T& value)
+{
+    const char *p = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), p, p + sizeof(T));
+}
+
+void appendString(std::vector<char>& buffer, const char *s)
+{
+    buffer.insert(buffer.end(), s, s + std::strlen(s) + 1);
+}
+
+// Reads little-endian numbers and zero-terminated strings from a range of bytes,
+// failing if the range is exceeded
+class ByteReader
+{
+public:
+    ByteReader(const std::vector<char>& data, const QString& fileName) :
+        m_data(data), m_fileName(fileName), m_pos(0), m_end(data.size())
+    {}
+
+    template<class T>
+    T get() {
+        T result;
+        std::memcpy(&result, getBytes(sizeof(T)), sizeof(T));
+        return result;
+    }
+
+    const char *getBytes(std::size_t size) {
+        if (size > m_end - m_pos)
+            fail("Canvas input is corrupt", m_fileName);
+        const char *result = m_data.data() + m_pos;
+        m_pos += size;
+        return result;
+    }
+
+    std::string getString() {
+        auto begin = m_data.begin() + m_pos;
+        auto end = std::find(begin, m_data.begin() + m_end, '\0');
+        if (end == m_data.begin() + m_end)
+            fail("Canvas input is corrupt", m_fileName);
+        m_pos += end - begin + 1;
+        return std::string(begin, end);
+    }
+
+    // Returns reader of the next size bytes and skips them
+    ByteReader sub(std::size_t size) {
+        ByteReader result(*this);
+        getBytes(size);
+        result.m_end = m_pos;
+        return result;
+    }
+
+    void seek(quint64 pos) {
+        if (pos > m_end)
+            fail("Canvas input is corrupt", m_fileName);
+        m_pos = pos;
+    }
+
+    std::size_t pos() const {
+        return m_pos;
+    }
+
+    // Returns the number of bytes left
+    std::size_t size() const {
+        return m_end - m_pos;
+    }
+
+private:
+    const std::vector<char>& m_data;
+    const QString& m_fileName;
+    std::size_t m_pos;
+    std::size_t m_end;
+};
+
+
+
+// Portable Float Map: text header "PF\n<width> <height>\n<scale>\n", followed by
+// rows of RGB floats, bottom to top; negative scale means little-endian numbers
+
+void writePfm(const Camera::Canvas& canvas, const QString& fileName)
+{
+    const v2i& size = canvas.size();
+    std::string header = "PF\n" + std::to_string(size[0]) + " " + std::to_string(size[1]) + "\n-1.0\n";
+    std::vector< std::vector<char> > parts(2);
+    parts[0].assign(header.begin(), header.end());
+    if (!canvas.empty()) {
+        const char *pixels = reinterpret_cast<const char*>(&canvas[0][0]);
+        parts[1].assign(pixels, pixels + canvas.length()*sizeof(v3f));
+    }
+    writeFile(fileName, parts);
+}
+
+std::string readPfmToken(ByteReader& reader)
+{
+    std::string result;
+    forever {
+        char c = reader.get<char>();
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            if (!result.empty())
+                return result;
+        }
+        else
+            result += c;
+    }
+}
+
+Camera::Canvas readPfm(const std::vector<char>& file, const QString& fileName)
+{
+    ByteReader reader(file, fileName);
+    std::string type = readPfmToken(reader);
+    if (type != "PF"   &&   type != "Pf")
+        fail("Invalid PFM input", fileName);
+    int componentCount = type == "PF" ?   3 :   1;
+    int width = std::atoi(readPfmToken(reader).c_str());
+    int height = std::atoi(readPfmToken(reader).c_str());
+    float scale = static_cast<float>(std::atof(readPfmToken(reader).c_str()));
+    if (width <= 0   ||   height <= 0   ||   scale == 0.f   ||
+            static_cast<quint64>(width)*height*componentCount*sizeof(float) != file.size() - reader.pos())
+        fail("PFM input is corrupt", fileName);
+
+    // Rows are stored bottom to top, as in the canvas
+    auto result = Camera::Canvas::uninitialized(mkv2i(width, height));
+    bool bigEndian = scale > 0.f;
+    const char *src = reader.getBytes(file.size() - reader.pos());
+    WorkerPool::instance().run(height, [&](int y) {
+        const char *rowSrc = src + static_cast<std::size_t>(y)*width*componentCount*sizeof(float);
+        v3f *row = &result[result.index(mkv2i(0, y))];
+        for (int x=0; x<width; ++x)
+            for (int c=0; c<3; ++c) {
+                char bytes[4];
+                std::memcpy(bytes, rowSrc + (x*componentCount + c%componentCount)*sizeof(float), 4);
+                if (bigEndian) {
+                    std::swap(bytes[0], bytes[3]);
+                    std::swap(bytes[1], bytes[2]);
+                }
+                std::memcpy(&row[x][c], bytes, 4);
+            }
+    });
+    return result;
+}
+
+
+
+// OpenEXR, see "OpenEXR File Layout", https://openexr.com/en/latest/OpenEXRFileLayout.html
+namespace exr {
+
+const quint32 Magic = 20000630;
+const quint32 Version = 2;
+const quint32 VersionMask = 0xff;
+const quint32 TiledFlag = 0x200;
+const quint32 LongNamesFlag = 0x400;
+
+enum PixelType {
+    UintPixel = 0,
+    HalfPixel = 1,
+    FloatPixel = 2
+};
+
+int pixelTypeSize(int pixelType) {
+    return pixelType == HalfPixel ?   2 :   4;
+}
+
+int linesPerBlock(int compression) {
+    return compression == CanvasFile::ZipCompression ?   16 :   1;
+}
+
+// Blocks of pixels stored in chunks: tiles or groups of scan lines
+struct Layout
+{
+    int width;
+    int height;
+    int blockWidth;
+    int blockHeight;
+    int blockCountX;
+    int blockCountY;
+
+    Layout(int width, int height, int blockWidth, int blockHeight) :
+        width(width), height(height), blockWidth(blockWidth), blockHeight(blockHeight),
+        blockCountX((width + blockWidth - 1) / blockWidth),
+        blockCountY((height + blockHeight - 1) / blockHeight)
+    {}
+
+    int chunkCount() const {
+        return blockCountX * blockCountY;
+    }
+};
+
+// Applies the OpenEXR ZIP predictor to data and compresses it with zlib; returns false,
+// leaving data as it is, if compression does not reduce the size
+bool zipCompress(std::vector<char>& data)
+{
+    std::size_t n = data.size();
+    if (n < 2)
+        return false;
+
+    // Put even bytes first, then odd ones
+    std::vector<uchar> tmp(n);
+    uchar *t1 = tmp.data();
+    uchar *t2 = tmp.data() + (n+1)/2;
+    for (std::size_t i=0; i<n; ) {
+        *t1++ = data[i++];
+        if (i < n)
+            *t2++ = data[i++];
+    }
+
+    // Replace bytes with differences from previous ones
+    for (std::size_t i=n-1; i>0; --i)
+        tmp[i] = static_cast<uchar>(tmp[i] - tmp[i-1] + 128);
+
+    // Drop the size prefix added by qCompress(), keeping the zlib stream
+    QByteArray compressed = qCompress(tmp.data(), static_cast<int>(n));
+    if (static_cast<std::size_t>(compressed.size()) - 4 >= n)
+        return false;
+    data.assign(compressed.constData() + 4, compressed.constData() + compressed.size());
+    return true;
+}
+
+std::vector<char> zipUncompress(const char *data, int size, std::size_t expectedSize, const QString& fileName)
+{
+    // qUncompress() expects the size of uncompressed data as a big-endian prefix
+    QByteArray compressed;
+    compressed.resize(size + 4);
+    for (int i=0; i<4; ++i)
+        compressed.data()[i] = static_cast<char>(expectedSize >> (24 - 8*i));
+    std::memcpy(compressed.data() + 4, data, size);
+    QByteArray uncompressed = qUncompress(compressed);
+    if (static_cast<std::size_t>(uncompressed.size()) != expectedSize)
+        fail("OpenEXR input is corrupt: failed to uncompress data", fileName);
+
+    uchar *t = reinterpret_cast<uchar*>(uncompressed.data());
+    for (std::size_t i=1; i<expectedSize; ++i)
+        t[i] = static_cast<uchar>(t[i-1] + t[i] - 128);
+
+    std::vector<char> result(expectedSize);
+    const uchar *t1 = t;
+    const uchar *t2 = t + (expectedSize+1)/2;
+    for (std::size_t i=0; i<expectedSize; ) {
+        result[i++] = *t1++;
+        if (i < expectedSize)
+            result[i++] = *t2++;
+    }
+    return result;
+}
+
+void appendAttribute(std::vector<char>& header, const char *name, const char *type, const std::vector<char>& value)
+{
+    appendString(header, name);
+    appendString(header, type);
+    append(header, static_cast<qint32>(value.size()));
+    header.insert(header.end(), value.begin(), value.end());
+}
+
+template<class T>
+void appendAttribute(std::vector<char>& header, const char *name, const char *type, const T& value)
+{
+    std::vector<char> buffer;
+    append(buffer, value);
+    appendAttribute(header, name, type, buffer);
+}
+
+void appendStringAttribute(std::vector<char>& header, const char *name, const std::string& value)
+{
+    appendAttribute(header, name, "string", std::vector<char>(value.begin(), value.end()));
+}
+
+void write(
+        const Camera::Canvas& canvas, const QString& fileName,
+        const CanvasFile::RenderInfo& info, const CanvasFile::Options& options)
+{
+    int width = canvas.size()[0];
+    int height = canvas.size()[1];
+    if (width <= 0   ||   height <= 0)
+        fail("Unable to write empty canvas", fileName);
+    bool tiled = options.tileSize > 0;
+    Layout layout(width, height,
+                  tiled ?   options.tileSize :   width,
+                  tiled ?   options.tileSize :   linesPerBlock(options.compression));
+    int pixelType = options.halfPrecision ?   HalfPixel :   FloatPixel;
+    int componentSize = pixelTypeSize(pixelType);
+
+    // Header; attributes are sorted by name, as OpenEXR does
+    std::vector<char> header;
+    append(header, Magic);
+    append(header, Version | (tiled ?   TiledFlag :   0));
+    std::vector<char> channels;
+    for (const char *name : { "B", "G", "R" }) {
+        appendString(channels, name);
+        append(channels, static_cast<qint32>(pixelType));
+        append(channels, static_cast<quint32>(0));  // pLinear and reserved bytes
+        append(channels, static_cast<qint32>(1));   // x sampling
+        append(channels, static_cast<qint32>(1));   // y sampling
+    }
+    channels.push_back(0);
+    appendAttribute(header, "channels", "chlist", channels);
+    appendAttribute(header, "compression", "compression", static_cast<quint8>(options.compression));
+    const qint32 window[] = { 0, 0, width-1, height-1 };
+    appendAttribute(header, "dataWindow", "box2i", window);
+    appendAttribute(header, "displayWindow", "box2i", window);
+    appendAttribute(header, "lineOrder", "lineOrder", static_cast<quint8>(0));
+    appendAttribute(header, "pixelAspectRatio", "float", 1.f);
+    if (info.isValid()) {
+        appendStringAttribute(header, "raytracerRayLimit", std::to_string(info.rayLimit));
+        appendStringAttribute(header, "raytracerSeed", std::to_string(info.seed));
+        const qint32 shard[] = { info.shardIndex, info.shardCount };
+        appendAttribute(header, "raytracerShard", "v2i", shard);
+        appendStringAttribute(header, "raytracerTotalRayLimit", std::to_string(info.totalRayLimit));
+    }
+    const float screenWindowCenter[] = { 0.f, 0.f };
+    appendAttribute(header, "screenWindowCenter", "v2f", screenWindowCenter);
+    appendAttribute(header, "screenWindowWidth", "float", 1.f);
+    if (tiled) {
+        std::vector<char> tiles;
+        append(tiles, static_cast<quint32>(layout.blockWidth));
+        append(tiles, static_cast<quint32>(layout.blockHeight));
+        append(tiles, static_cast<quint8>(0));  // one level, rounding down
+        appendAttribute(header, "tiles", "tiledesc", tiles);
+    }
+    header.push_back(0);
+
+    // Chunks are encoded and compressed in parallel. File scan lines go top to bottom,
+    // so scan line y holds canvas row height-1-y. Within each scan line of a chunk,
+    // channels are stored one after another, in the header order: B, G, R.
+    int chunkCount = layout.chunkCount();
+    std::vector< std::vector<char> > parts(chunkCount + 2);
+    WorkerPool::instance().run(chunkCount, [&](int chunk) {
+        int bx = chunk % layout.blockCountX;
+        int by = chunk / layout.blockCountX;
+        int x0 = bx*layout.blockWidth;
+        int x1 = std::min(x0 + layout.blockWidth, width);
+        int y0 = by*layout.blockHeight;
+        int y1 = std::min(y0 + layout.blockHeight, height);
+        std::vector<char> data(static_cast<std::size_t>(y1-y0)*(x1-x0)*3*componentSize);
+        char *dst = data.data();
+        for (int y=y0; y<y1; ++y) {
+            const v3f *row = &canvas[canvas.index(mkv2i(0, height-1-y))];
+            for (int c=2; c>=0; --c)
+                for (int x=x0; x<x1; ++x) {
+                    if (pixelType == HalfPixel) {
+                        quint16 h = floatToHalf(row[x][c]);
+                        std::memcpy(dst, &h, 2);
+                    }
+                    else
+                        std::memcpy(dst, &row[x][c], 4);
+                    dst += componentSize;
+                }
+        }
+        if (options.compression != CanvasFile::NoCompression)
+            zipCompress(data);
+
+        auto& part = parts[chunk + 2];
+        if (tiled) {
+            append(part, static_cast<qint32>(bx));
+            append(part, static_cast<qint32>(by));
+            append(part, static_cast<qint32>(0));   // level x
+            append(part, static_cast<qint32>(0));   // level y
+        }
+        else
+            append(part, static_cast<qint32>(y0));
+        append(part, static_cast<qint32>(data.size()));
+        part.insert(part.end(), data.begin(), data.end());
+    });
+
+    // Offset table
+    auto& offsets = parts[1];
+    quint64 offset = header.size() + chunkCount*sizeof(quint64);
+    for (int chunk=0; chunk<chunkCount; ++chunk) {
+        append(offsets, offset);
+        offset += parts[chunk + 2].size();
+    }
+    parts[0].swap(header);
+    writeFile(fileName, parts);
+}
+
+quint64 toUInt64(const ByteReader& value)
+{
+    ByteReader copy(value);
+    std::string s(copy.getBytes(copy.size()), copy.size());
+    return std::strtoull(s.c_str(), nullptr, 10);
+}
+
+Camera::Canvas read(const std::vector<char>& file, const QString& fileName, CanvasFile::RenderInfo& info)
+{
+    ByteReader reader(file, fileName);
+    if (reader.get<quint32>() != Magic)
+        fail("Invalid OpenEXR input", fileName);
+    quint32 version = reader.get<quint32>();
+    if ((version & VersionMask) != Version   ||   (version & ~(VersionMask | TiledFlag | LongNamesFlag)) != 0)
+        fail("Unsupported OpenEXR input (multi-part and deep images are not supported)", fileName);
+    bool tiled = (version & TiledFlag) != 0;
+
+    // Header attributes; component -1 means the channel is ignored, 3 means grayscale
+    struct Channel {
+        int pixelType;
+        int component;
+    };
+    std::vector<Channel> channels;
+    bool hasColor = false;
+    int compression = -1;
+    qint32 window[4];
+    bool hasWindow = false;
+    quint32 tileSize[2] = { 0, 0 };
+    forever {
+        std::string name = reader.getString();
+        if (name.empty())
+            break;
+        reader.getString();     // type
+        qint32 size = reader.get<qint32>();
+        if (size < 0)
+            fail("OpenEXR input is corrupt", fileName);
+        ByteReader value = reader.sub(size);
+        if (name == "channels") {
+            forever {
+                std::string channelName = value.getString();
+                if (channelName.empty())
+                    break;
+                Channel channel;
+                channel.pixelType = value.get<qint32>();
+                value.getBytes(4);  // pLinear and reserved bytes
+                qint32 xSampling = value.get<qint32>();
+                qint32 ySampling = value.get<qint32>();
+                if (channel.pixelType < UintPixel   ||   channel.pixelType > FloatPixel)
+                    fail("OpenEXR input is corrupt: invalid pixel type", fileName);
+                if (xSampling != 1   ||   ySampling != 1)
+                    fail("Unsupported OpenEXR input (subsampled channels are not supported)", fileName);
+                auto pos = std::string("RGBY").find(channelName);
+                channel.component = channelName.size() == 1   &&   pos != std::string::npos ?   static_cast<int>(pos) :   -1;
+                hasColor = hasColor   ||   (channel.component >= 0   &&   channel.component < 3);
+                channels.push_back(channel);
+            }
+        }
+        else if (name == "compression")
+            compression = value.get<quint8>();
+        else if (name == "dataWindow") {
+            for (auto& x : window)
+                x = value.get<qint32>();
+            hasWindow = true;
+        }
+        else if (name == "raytracerShard") {
+            info.shardIndex = value.get<qint32>();
+            info.shardCount = value.get<qint32>();
+        }
+        else if (name == "raytracerRayLimit")
+            info.rayLimit = toUInt64(value);
+        else if (name == "raytracerTotalRayLimit")
+            info.totalRayLimit = toUInt64(value);
+        else if (name == "raytracerSeed")
+            info.seed = static_cast<quint32>(toUInt64(value));
+        else if (name == "tiles") {
+            tileSize[0] = value.get<quint32>();
+            tileSize[1] = value.get<quint32>();
+            if ((value.get<quint8>() & 0xf) != 0)
+                fail("Unsupported OpenEXR input (mipmaps and ripmaps are not supported)", fileName);
+        }
+    }
+    if (hasColor)
+        for (auto& channel : channels)
+            if (channel.component == 3)
+                channel.component = -1;
+    if (channels.empty()   ||   !hasWindow)
+        fail("OpenEXR input is corrupt: missing required attributes", fileName);
+    if (compression != CanvasFile::NoCompression   &&
+            compression != CanvasFile::ZipsCompression   &&
+            compression != CanvasFile::ZipCompression)
+        fail("Unsupported OpenEXR input (only ZIP and ZIPS compression is supported)", fileName);
+    qint64 width = static_cast<qint64>(window[2]) - window[0] + 1;
+    qint64 height = static_cast<qint64>(window[3]) - window[1] + 1;
+    if (width <= 0   ||   height <= 0   ||   width*height > (1 << 28))
+        fail("OpenEXR input is corrupt: invalid data window", fileName);
+    if (tiled   &&   (tileSize[0] == 0   ||   tileSize[1] == 0))
+        fail("OpenEXR input is corrupt: invalid tile size", fileName);
+    // Tiles may be larger than the image; blocks are clipped to it anyway
+    Layout layout(width, height,
+                  tiled ?   static_cast<int>(std::min<qint64>(tileSize[0], width)) :   width,
+                  tiled ?   static_cast<int>(std::min<qint64>(tileSize[1], height)) :   linesPerBlock(compression));
+    std::size_t pixelSize = 0;
+    for (const auto& channel : channels)
+        pixelSize += pixelTypeSize(channel.pixelType);
+
+    // Offset table
+    int chunkCount = layout.chunkCount();
+    std::vector<quint64> offsets(chunkCount);
+    for (auto& offset : offsets)
+        offset = reader.get<quint64>();
+
+    // Chunks are uncompressed and decoded in parallel
+    Camera::Canvas result(mkv2i(layout.width, layout.height));
+    WorkerPool::instance().run(chunkCount, [&](int chunk) {
+        ByteReader chunkReader(file, fileName);
+        chunkReader.seek(offsets[chunk]);
+        int x0 = 0;
+        int y0;
+        if (tiled) {
+            qint32 bx = chunkReader.get<qint32>();
+            qint32 by = chunkReader.get<qint32>();
+            qint32 levelX = chunkReader.get<qint32>();
+            qint32 levelY = chunkReader.get<qint32>();
+            if (bx < 0   ||   bx >= layout.blockCountX   ||   by < 0   ||   by >= layout.blockCountY   ||
+                    levelX != 0   ||   levelY != 0)
+                fail("OpenEXR input is corrupt: invalid tile", fileName);
+            x0 = bx*layout.blockWidth;
+            y0 = by*layout.blockHeight;
+        }
+        else {
+            y0 = chunkReader.get<qint32>() - window[1];
+            if (y0 < 0   ||   y0 >= layout.height   ||   y0 % layout.blockHeight != 0)
+                fail("OpenEXR input is corrupt: invalid scan line", fileName);
+        }
+        int x1 = std::min(x0 + layout.blockWidth, layout.width);
+        int y1 = std::min(y0 + layout.blockHeight, layout.height);
+        qint32 dataSize = chunkReader.get<qint32>();
+        if (dataSize < 0)
+            fail("OpenEXR input is corrupt", fileName);
+        const char *data = chunkReader.getBytes(dataSize);
+        std::size_t expectedSize = static_cast<std::size_t>(y1-y0)*(x1-x0)*pixelSize;
+        std::vector<char> buffer;
+        if (static_cast<std::size_t>(dataSize) < expectedSize   &&   compression != CanvasFile::NoCompression) {
+            buffer = zipUncompress(data, dataSize, expectedSize, fileName);
+            data = buffer.data();
+        }
+        else if (static_cast<std::size_t>(dataSize) != expectedSize)
+            fail("OpenEXR input is corrupt: invalid chunk size", fileName);
+
+        for (int y=y0; y<y1; ++y) {
+            v3f *row = &result[result.index(mkv2i(0, layout.height-1-y))];
+            for (const auto& channel : channels) {
+                int size = pixelTypeSize(channel.pixelType);
+                if (channel.component < 0) {
+                    data += (x1-x0)*size;
+                    continue;
+                }
+                for (int x=x0; x<x1; ++x, data+=size) {
+                    float value;
+                    if (channel.pixelType == HalfPixel) {
+                        quint16 h;
+                        std::memcpy(&h, data, 2);
+                        value = halfToFloat(h);
+                    }
+                    else if (channel.pixelType == FloatPixel)
+                        std::memcpy(&value, data, 4);
+                    else {
+                        quint32 u;
+                        std::memcpy(&u, data, 4);
+                        value = static_cast<float>(u);
+                    }
+                    if (channel.component == 3)
+                        row[x] = mkv3f(value, value, value);
+                    else
+                        row[x][channel.component] = value;
+                }
+            }
+        }
+    });
+    return result;
+}
+
+} // end namespace exr
+
+} // anonymous namespace
+
+
+
+CanvasFile::RenderInfo::RenderInfo() :
+    shardIndex(0),
+    shardCount(0),
+    rayLimit(0),
+    totalRayLimit(0),
+    seed(0)
+{
+}
+
+bool CanvasFile::RenderInfo::isValid() const {
+    return shardCount > 0   &&   shardIndex >= 0   &&   shardIndex < shardCount;
+}
+
+CanvasFile::Options::Options() :
+    halfPrecision(false),
+    compression(ZipCompression),
+    tileSize(0)
+{
+}
+
+CanvasFile::Options& CanvasFile::Options::setHalfPrecision(bool halfPrecision) {
+    this->halfPrecision = halfPrecision;
+    return *this;
+}
+
+CanvasFile::Options& CanvasFile::Options::setCompression(Compression compression) {
+    this->compression = compression;
+    return *this;
+}
+
+CanvasFile::Options& CanvasFile::Options::setTileSize(int tileSize) {
+    this->tileSize = tileSize;
+    return *this;
+}
+
+bool CanvasFile::isSupported(const QString& fileName)
+{
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    return suffix == "pfm"   ||   suffix == "exr";
+}
+
+CanvasFile::Format CanvasFile::format(const QString& fileName)
+{
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "pfm")
+        return Pfm;
+    else if (suffix == "exr")
+        return Exr;
+    else
+        throw cxx::exception(std::string("Unsupported canvas file format '") + suffix.toStdString() + "'");
+}
+
+void CanvasFile::write(const Camera::Canvas& canvas, const QString& fileName, const Options& options)
+{
+    write(canvas, fileName, RenderInfo(), options);
+}
+
+void CanvasFile::write(
+        const Camera::Canvas& canvas, const QString& fileName,
+        const RenderInfo& info, const Options& options)
+{
+    switch (format(fileName)) {
+    case Pfm:
+        writePfm(canvas, fileName);
+        break;
+    case Exr:
+        exr::write(canvas, fileName, info, options);
+        break;
+    }
+}
+
+Camera::Canvas CanvasFile::read(const QString& fileName, RenderInfo *info)
+{
+    auto format = CanvasFile::format(fileName);
+    auto file = readFile(fileName);
+    RenderInfo readInfo;
+    if (!info)
+        info = &readInfo;
+    *info = RenderInfo();
+    switch (format) {
+    case Pfm:
+        return readPfm(file, fileName);
+    case Exr:
+        return exr::read(file, fileName, *info);
+    }
+    Q_ASSERT(false);
+    return Camera::Canvas();
+}
+
+} // end namespace raytracer
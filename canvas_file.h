@@ -0,0 +1,113 @@
+/// \file
+/// \brief Declaration of the CanvasFile class.
+
+#ifndef CANVAS_FILE_H
+#define CANVAS_FILE_H
+
+#include "camera.h"
+
+namespace raytracer {
+
+/// \brief Writes and reads canvases in floating-point image formats, keeping pixel values as they are.
+///
+/// Unlike images obtained by Camera::Canvas::toImage(), saved canvases can be processed,
+/// merged, or tone-mapped in a different way without rendering them again.
+/// Supported formats are
+/// - Portable Float Map (.pfm), three floats per pixel;
+/// - OpenEXR (.exr), single part, channels R, G, B of half precision or float numbers,
+///   scan lines or tiles, optionally compressed (see Options).
+/// .
+/// The format is chosen by the file name suffix. Layers, bounce layers and feature buffers
+/// of the canvas are not saved. OpenEXR files also keep information on the render (see RenderInfo)
+/// in header attributes, so that parts of one render made by different processes can be merged
+/// (see RenderShard).
+///
+/// The reader accepts OpenEXR files written by other software, as long as they are single part
+/// images with one level of tiles, if tiled, and use no compression or ZIP/ZIPS compression;
+/// channels other than R, G, B (or Y, for grayscale images) are ignored.
+class CanvasFile
+{
+public:
+    enum Format {
+        Pfm,
+        Exr
+    };
+
+    /// \brief OpenEXR compression methods supported.
+    enum Compression {
+        NoCompression = 0,
+        ZipsCompression = 2,    ///< \brief zlib, each scan line compressed separately.
+        ZipCompression = 3      ///< \brief zlib, blocks of 16 scan lines or tiles.
+    };
+
+    /// \brief Options of the OpenEXR writer.
+    struct Options
+    {
+        /// \brief Whether color components are stored as half precision numbers
+        /// rather than as floats (false by default).
+        ///
+        /// Half precision halves the file size; components greater than 65504 become infinite.
+        bool halfPrecision;
+
+        /// \brief Compression method (ZipCompression by default).
+        Compression compression;
+
+        /// \brief Width and height of tiles; zero (default) means the file is made of scan lines.
+        int tileSize;
+
+        Options();
+        Options& setHalfPrecision(bool halfPrecision);
+        Options& setCompression(Compression compression);
+        Options& setTileSize(int tileSize);
+    };
+
+    /// \brief Information on the render a canvas comes from.
+    struct RenderInfo
+    {
+        /// \brief Zero-based index of the shard (see RenderShard).
+        int shardIndex;
+
+        /// \brief Number of shards the render is split into; zero means the information is missing.
+        int shardCount;
+
+        /// \brief Ray limit of the shard (see RayTracer::Options::totalRayLimit).
+        quint64 rayLimit;
+
+        /// \brief Ray limit of the whole render.
+        quint64 totalRayLimit;
+
+        /// \brief Seed of the random number generator (see rnd).
+        quint32 seed;
+
+        /// \brief Initializes information as missing.
+        RenderInfo();
+
+        bool isValid() const;
+    };
+
+    /// \brief Returns true if \a fileName has the suffix of a supported format.
+    static bool isSupported(const QString& fileName);
+
+    /// \brief Returns the format corresponding to the suffix of \a fileName.
+    ///
+    /// Throws an exception if the format is not supported.
+    static Format format(const QString& fileName);
+
+    /// \brief Writes \a canvas to file \a fileName; \a options only apply to OpenEXR files.
+    static void write(const Camera::Canvas& canvas, const QString& fileName, const Options& options = Options());
+
+    /// \brief Writes \a canvas to file \a fileName, along with \a info, if the file is OpenEXR.
+    static void write(
+            const Camera::Canvas& canvas, const QString& fileName,
+            const RenderInfo& info, const Options& options = Options());
+
+    /// \brief Reads canvas from file \a fileName.
+    ///
+    /// If \a info is not null, it receives information on the render; the information
+    /// is missing (see RenderInfo::isValid()) for PFM files and files written by other software.
+    static Camera::Canvas read(const QString& fileName, RenderInfo *info = nullptr);
+};
+
+} // end namespace raytracer
+
+#endif // CANVAS_FILE_H
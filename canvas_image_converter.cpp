@@ -0,0 +1,238 @@
+/// \file
+/// \brief Implementation of the CanvasImageConverter class.
+
+#include "canvas_image_converter.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace raytracer {
+
+namespace {
+
+struct TileRect
+{
+    int x0, y0, x1, y1;
+};
+
+TileRect tileRect(const v2i& size, int tile)
+{
+    const int tileCountX = (size[0] + CanvasImageConverter::TileSize - 1) / CanvasImageConverter::TileSize;
+    TileRect r;
+    r.x0 = (tile % tileCountX) * CanvasImageConverter::TileSize;
+    r.y0 = (tile / tileCountX) * CanvasImageConverter::TileSize;
+    r.x1 = std::min(r.x0 + static_cast<int>(CanvasImageConverter::TileSize), size[0]);
+    r.y1 = std::min(r.y0 + static_cast<int>(CanvasImageConverter::TileSize), size[1]);
+    return r;
+}
+
+int tileCount(const v2i& size)
+{
+    return ((size[0] + CanvasImageConverter::TileSize - 1) / CanvasImageConverter::TileSize) *
+           ((size[1] + CanvasImageConverter::TileSize - 1) / CanvasImageConverter::TileSize);
+}
+
+struct ValueRange
+{
+    float minValue;
+    float maxValue;
+
+    ValueRange() :
+        minValue(std::numeric_limits<float>::max()),
+        maxValue(-std::numeric_limits<float>::max())
+    {}
+
+    void add(const float *values, int count)
+    {
+        for (int i=0; i<count; ++i) {
+            minValue = std::min(minValue, values[i]);
+            maxValue = std::max(maxValue, values[i]);
+        }
+    }
+
+    void add(const ValueRange& that)
+    {
+        minValue = std::min(minValue, that.minValue);
+        maxValue = std::max(maxValue, that.maxValue);
+    }
+};
+
+static_assert(sizeof(v3f) == 3*sizeof(float), "Canvas rows are expected to be arrays of floats");
+
+inline const float *rowData(const Camera::Canvas& canvas, int x, int y)
+{
+    return &canvas.data()[x + y*canvas.size()[0]][0];
+}
+
+} // anonymous namespace
+
+CanvasImageConverter::CanvasImageConverter(QImage::Format format) :
+    m_format(format),
+    m_minValue(0.f),
+    m_maxValue(0.f),
+    m_convertedTileCount(0)
+{
+}
+
+QImage::Format CanvasImageConverter::format() const
+{
+    return m_format;
+}
+
+QImage CanvasImageConverter::convert(const Camera::Canvas& canvas)
+{
+    return convert(canvas, false);
+}
+
+QImage CanvasImageConverter::update(const Camera::Canvas& canvas)
+{
+    const v2i& size = canvas.size();
+    if (m_snapshot.empty()   ||   m_snapshot.size()[0] != size[0]   ||   m_snapshot.size()[1] != size[1])
+        return convert(canvas, true);
+
+    // Find changed tiles and their range
+    const int n = tileCount(size);
+    std::vector<char> changed(n, 0);
+    std::vector<ValueRange> ranges(n);
+    WorkerPool::instance().run(n, [&](int tile) {
+        auto r = tileRect(size, tile);
+        const int rowLength = 3*(r.x1 - r.x0);
+        for (int y=r.y0; y<r.y1; ++y) {
+            const float *row = rowData(canvas, r.x0, y);
+            if (!changed[tile]   &&   std::memcmp(row, rowData(m_snapshot, r.x0, y), rowLength*sizeof(float)) == 0)
+                continue;
+            changed[tile] = 1;
+            ranges[tile].add(row, rowLength);
+        }
+    });
+    ValueRange range;
+    std::vector<int> changedTiles;
+    for (int tile=0; tile<n; ++tile)
+        if (changed[tile]) {
+            changedTiles.push_back(tile);
+            range.add(ranges[tile]);
+        }
+    if (!changedTiles.empty()   &&   (range.minValue < m_minValue   ||   range.maxValue > m_maxValue))
+        return convert(canvas, true);
+
+    // Convert changed tiles using the previous range
+    uchar *bits = m_image.bits();
+    int bytesPerLine = m_image.bytesPerLine();
+    WorkerPool::instance().run(changedTiles.size(), [&](int i) {
+        convertTile(canvas, changedTiles[i], bits, bytesPerLine);
+    });
+    m_convertedTileCount = changedTiles.size();
+    return result();
+}
+
+void CanvasImageConverter::reset()
+{
+    m_snapshot = Camera::Canvas();
+}
+
+float CanvasImageConverter::minValue() const
+{
+    return m_minValue;
+}
+
+float CanvasImageConverter::maxValue() const
+{
+    return m_maxValue;
+}
+
+int CanvasImageConverter::convertedTileCount() const
+{
+    return m_convertedTileCount;
+}
+
+QImage CanvasImageConverter::convert(const Camera::Canvas& canvas, bool keepSnapshot)
+{
+    const v2i& size = canvas.size();
+    if (m_image.isNull()   ||   m_image.width() != size[0]   ||   m_image.height() != size[1])
+        m_image = QImage(size[0], size[1], workingFormat());
+    m_snapshot = keepSnapshot ?   Camera::Canvas::uninitialized(size) :   Camera::Canvas();
+    m_convertedTileCount = 0;
+    if (canvas.empty())
+        return result();
+
+    // Determine canvas color range
+    const int n = tileCount(size);
+    std::vector<ValueRange> ranges(n);
+    WorkerPool::instance().run(n, [&](int tile) {
+        auto r = tileRect(size, tile);
+        for (int y=r.y0; y<r.y1; ++y)
+            ranges[tile].add(rowData(canvas, r.x0, y), 3*(r.x1 - r.x0));
+    });
+    ValueRange range;
+    for (const auto& r : ranges)
+        range.add(r);
+    m_minValue = range.minValue;
+    m_maxValue = range.maxValue;
+
+    // Convert all tiles
+    uchar *bits = m_image.bits();
+    int bytesPerLine = m_image.bytesPerLine();
+    WorkerPool::instance().run(n, [&](int tile) {
+        convertTile(canvas, tile, bits, bytesPerLine);
+    });
+    m_convertedTileCount = n;
+    return result();
+}
+
+QImage::Format CanvasImageConverter::workingFormat() const
+{
+    switch (m_format) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_RGB888:
+        return m_format;
+    default:
+        return QImage::Format_RGB32;
+    }
+}
+
+QImage CanvasImageConverter::result() const
+{
+    return m_format == workingFormat() ?   m_image :   m_image.convertToFormat(m_format);
+}
+
+void CanvasImageConverter::convertTile(const Camera::Canvas& canvas, int tile, uchar *bits, int bytesPerLine)
+{
+    // In case of monotonous color, the image is all-black or all-gray
+    float scale, offset;
+    if (m_minValue < m_maxValue) {
+        scale = 255.999f / (m_maxValue - m_minValue);
+        offset = -m_minValue*scale;
+    }
+    else {
+        scale = 0.f;
+        offset = m_minValue == 0.f ?   0.f :   136.f;
+    }
+
+    const v2i& size = canvas.size();
+    auto r = tileRect(size, tile);
+    const int width = r.x1 - r.x0;
+    const bool rgb888 = workingFormat() == QImage::Format_RGB888;
+    uchar components[3*TileSize];
+    for (int y=r.y0; y<r.y1; ++y) {
+        const float *src = rowData(canvas, r.x0, y);
+        for (int i=0; i<3*width; ++i)
+            components[i] = static_cast<uchar>(std::max(0.f, std::min(src[i]*scale + offset, 255.f)));
+        uchar *line = bits + (size[1] - 1 - y)*bytesPerLine;
+        if (rgb888)
+            std::memcpy(line + 3*r.x0, components, 3*width);
+        else {
+            QRgb *dst = reinterpret_cast<QRgb*>(line) + r.x0;
+            for (int x=0; x<width; ++x)
+                dst[x] = qRgb(components[3*x], components[3*x+1], components[3*x+2]);
+        }
+        if (!m_snapshot.empty())
+            std::copy(canvas.data().begin() + r.x0 + y*size[0],
+                      canvas.data().begin() + r.x1 + y*size[0],
+                      m_snapshot.data().begin() + r.x0 + y*size[0]);
+    }
+}
+
+} // end namespace raytracer
@@ -0,0 +1,73 @@
+/// \file
+/// \brief Declaration of the CanvasImageConverter class.
+
+#ifndef CANVAS_IMAGE_CONVERTER_H
+#define CANVAS_IMAGE_CONVERTER_H
+
+#include "camera.h"
+
+#include <QImage>
+
+namespace raytracer {
+
+/// \brief Converts canvases to images, mapping the range of color components to [0, 255].
+///
+/// The canvas is processed in square tiles, in parallel (see WorkerPool).
+/// Supported image formats are QImage::Format_RGB32, QImage::Format_ARGB32 and
+/// QImage::Format_RGB888 (which has no padding byte); other formats are obtained by
+/// converting a QImage::Format_RGB32 image.
+///
+/// Canvas rows are stored in the image bottom to top.
+class CanvasImageConverter
+{
+public:
+    /// \brief Width and height of a tile.
+    enum { TileSize = 64 };
+
+    explicit CanvasImageConverter(QImage::Format format = QImage::Format_RGB32);
+
+    QImage::Format format() const;
+
+    /// \brief Converts the whole canvas, determining the range of its color components.
+    ///
+    /// If all components are equal, the image is black if they are zero, and gray otherwise.
+    QImage convert(const Camera::Canvas& canvas);
+
+    /// \brief Converts canvas incrementally, reusing the result of the previous call.
+    ///
+    /// Only tiles changed since the previous call are converted, using the previous range
+    /// of color components. The whole canvas is converted, as by convert(), on the first
+    /// call, after reset(), when the canvas size changes, or when the changed tiles do not
+    /// fit into the previous range.
+    ///
+    /// Changes are found by comparing the canvas with a copy of the one previously converted,
+    /// so the canvas may come from any image processor.
+    QImage update(const Camera::Canvas& canvas);
+
+    /// \brief Makes the next call to update() convert the whole canvas.
+    void reset();
+
+    /// \brief Returns the range of color components used by the last conversion.
+    float minValue() const;
+    float maxValue() const;
+
+    /// \brief Returns the number of tiles converted by the last call to update().
+    int convertedTileCount() const;
+
+private:
+    QImage::Format m_format;
+    QImage m_image;
+    Camera::Canvas m_snapshot;
+    float m_minValue;
+    float m_maxValue;
+    int m_convertedTileCount;
+
+    QImage convert(const Camera::Canvas& canvas, bool keepSnapshot);
+    QImage::Format workingFormat() const;
+    QImage result() const;
+    void convertTile(const Camera::Canvas& canvas, int tile, uchar *bits, int bytesPerLine);
+};
+
+} // end namespace raytracer
+
+#endif // CANVAS_IMAGE_CONVERTER_H
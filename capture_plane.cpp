@@ -0,0 +1,134 @@
+/// \file
+/// \brief Implementation of the CapturePlane class.
+
+#include "capture_plane.h"
+#include "primitives/single_sided_rectangle.h"
+#include "transform.h"
+#include "ray_tracer.h"
+#include "ray.h"
+#include "ray_file_writer.h"
+
+namespace raytracer {
+
+namespace {
+
+class CameraSurfProp : public SurfaceProperties
+{
+public:
+    CameraSurfProp(
+            const CapturePlane::Geometry& geom,
+            const std::shared_ptr<RayFileWriter>& raysWriter,
+            Camera::Canvas& canvas) :
+        m_raysWriter(raysWriter),
+        m_canvas(canvas),
+        m_pixelScale(mkv2f(-0.5f*geom.resx, 0.5f*geom.resy)),
+        m_pixelOffset(mkv2f(0.5f*geom.resx, 0.5f*geom.resy))
+    {
+    }
+
+    void processCollision(
+            const Ray& ray,
+            const SurfacePoint& surfacePoint,
+            RayTracer& rayTracer) const
+    {
+        if (m_raysWriter)
+            m_raysWriter->write(ray, surfacePoint);
+
+        // The plane is rotated about the y axis, so the texture coordinate 1
+        // decreases along the x axis of the camera coordinate system
+        auto tex = sptex(surfacePoint);
+        auto xy = mkv2i(
+            static_cast<int>(tex[0]*m_pixelScale[0] + m_pixelOffset[0]),
+            static_cast<int>(tex[1]*m_pixelScale[1] + m_pixelOffset[1]));
+        if (!m_canvas.contains(xy))
+            return;
+        Camera::splat(m_canvas, xy, ray, rayTracer);
+    }
+    void read(const QVariant&) {}
+
+private:
+    std::shared_ptr<RayFileWriter> m_raysWriter;
+    Camera::Canvas& m_canvas;
+    v2f m_pixelScale;
+    v2f m_pixelOffset;
+};
+
+} // anonymous namespace
+
+REGISTER_GENERATOR(CapturePlane)
+
+void CapturePlane::clear()
+{
+    m_canvas = Canvas(mkv2i(m_geometry.resx, m_geometry.resy));
+
+    m_primitive = std::make_shared<SingleSidedRectangle>(m_geometry.width, m_geometry.height);
+
+    m4f T = transform();
+    Rotate(mkv3f(0.f, 1.f, 0.f), 180.f)(T);
+    m_primitive->setTransform(T);
+
+    m_primitive->setName("capture plane");
+
+    RayFileFormat::Header header;
+    header.setCameraType("CapturePlane");
+    header.flags = RayFileFormat::VirtualPlane;
+    header.setScreen(T, m_geometry.width, m_geometry.height);
+    header.resolution[0] = m_geometry.resx;
+    header.resolution[1] = m_geometry.resy;
+    header.parameters[0] = m_geometry.width;
+    header.parameters[1] = m_geometry.height;
+    resetRaysWriter(header);
+
+    m_primitive->setSurfaceProperties(std::make_shared<CameraSurfProp>(
+                                          m_geometry, raysWriter(), m_canvas));
+}
+
+Primitive::Ptr CapturePlane::cameraPrimitive() const
+{
+    return m_primitive;
+}
+
+const Camera::Canvas& CapturePlane::canvas() const {
+    return m_canvas;
+}
+
+Camera::Canvas& CapturePlane::canvas() {
+    return m_canvas;
+}
+
+SurfaceProperties::Ptr CapturePlane::makeSurfaceProperties(Canvas& canvas) const
+{
+    return std::make_shared<CameraSurfProp>(
+                m_geometry, std::shared_ptr<RayFileWriter>(), canvas);
+}
+
+void CapturePlane::read(const QVariant &v)
+{
+    Camera::read(v);
+
+    m_geometry = Geometry();
+
+    QVariantMap m = safeVariantMap(v);
+    readOptionalProperty(m, "geometry", [this](const QVariant& v) {
+        Geometry g;
+        QVariantMap m = safeVariantMap(v);
+        readOptionalProperty(g.width, m, "width");
+        readOptionalProperty(g.height, m, "height");
+        readOptionalProperty(g.resx, m, "resx");
+        readOptionalProperty(g.resy, m, "resy");
+        m_geometry = g;
+    });
+}
+
+const CapturePlane::Geometry& CapturePlane::geometry() const
+{
+    return m_geometry;
+}
+
+void CapturePlane::setGeometry(const Geometry& geometry)
+{
+    m_geometry = geometry;
+    clear();
+}
+
+} // end namespace raytracer
@@ -0,0 +1,67 @@
+/// \file
+/// \brief Declaration of the CapturePlane class.
+
+#ifndef CAPTURE_PLANE_H
+#define CAPTURE_PLANE_H
+
+#include "camera.h"
+
+namespace raytracer {
+
+/// \brief Virtual plane capturing rays crossing it.
+///
+/// The plane is a rectangle centered at the origin of the camera coordinate system,
+/// lying in its xy plane; like camera screens, it is transparent and only receives
+/// rays travelling in the positive z direction. Captured rays are written to the
+/// rays output file (see Camera::setRaysOutputFileName()), marked with
+/// RayFileFormat::VirtualPlane, so they can be replayed into cameras of any type
+/// placed behind the plane. The canvas shows irradiance on the plane.
+class CapturePlane : public Camera
+{
+    DECL_GENERATOR(CapturePlane)
+public:
+    struct Geometry
+    {
+        /// \brief Plane width (along the x axis).
+        float width;
+
+        /// \brief Plane height (along the y axis).
+        float height;
+
+        /// \brief Canvas resolution in the x direction.
+        int resx;
+
+        /// \brief Canvas resolution in the y direction.
+        int resy;
+
+        Geometry() :
+            width(1.f),
+            height(1.f),
+            resx(512),
+            resy(512)
+        {}
+    };
+
+    void clear();
+
+    Primitive::Ptr cameraPrimitive() const;
+
+    const Canvas& canvas() const;
+    Canvas& canvas();
+
+    SurfaceProperties::Ptr makeSurfaceProperties(Canvas& canvas) const;
+
+    void read(const QVariant &v);
+
+    const Geometry& geometry() const;
+    void setGeometry(const Geometry& geometry);
+
+private:
+    Primitive::Ptr m_primitive;
+    Geometry m_geometry;
+    Canvas m_canvas;
+};
+
+} // end namespace raytracer
+
+#endif // CAPTURE_PLANE_H
@@ -0,0 +1,14 @@
+# Command line application running batch commands (see CommandLine);
+# links neither QtWidgets nor a platform plugin, QtGui is only used for QImage
+
+include(../raytracer.pri)
+include(../core/core.pri)
+
+QT       = core gui network
+
+TARGET = raytracer_cli
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += ../cli_main.cpp
@@ -0,0 +1,9 @@
+#include "command_line.h"
+
+#include <QCoreApplication>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    return raytracer::CommandLine(a.arguments().mid(1)).run();
+}
@@ -0,0 +1,491 @@
+/// \file
+/// \brief Implementation of the CommandLine class.
+
+#include "command_line.h"
+#include "ray_tracer.h"
+#include "render_server.h"
+#include "render_client.h"
+#include "worker_pool.h"
+#include "json_parser.h"
+#include "cxx_exception.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QTime>
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+#if defined(__MINGW32__) && (__GNUC__ <= 4   ||   (__GNUC__ == 4 && __GNUC_MINOR__ <= 8))
+#define defaultfloat ""
+#endif
+
+namespace raytracer {
+
+namespace {
+
+// Interval between checks of the time limit, in milliseconds
+const int TimeLimitCheckInterval = 100;
+
+void fail(const QString& message)
+{
+    throw cxx::exception(message.toStdString());
+}
+
+double parseNumber(const QString& option, const QString& value, double minValue)
+{
+    bool ok = false;
+    double result = value.toDouble(&ok);
+    if (!ok   ||   result < minValue)
+        fail(QString("Invalid value '%1' of option %2").arg(value, option));
+    return result;
+}
+
+int parseInt(const QString& option, const QString& value, int minValue)
+{
+    bool ok = false;
+    int result = value.toInt(&ok);
+    if (!ok   ||   result < minValue)
+        fail(QString("Invalid value '%1' of option %2").arg(value, option));
+    return result;
+}
+
+// Makes output file name for each camera: with more than one camera,
+// camera name or index is appended to the base name
+QStringList cameraImageFileNames(const QString& imageFileName, const QStringList& cameraNames)
+{
+    QStringList result;
+    if (cameraNames.size() == 1)
+        result << imageFileName;
+    else {
+        QFileInfo fi(imageFileName);
+        QString base = imageFileName.left(imageFileName.size() - fi.suffix().size() - 1);
+        for (int i=0; i<cameraNames.size(); ++i) {
+            QString cameraName = cameraNames[i];
+            if (cameraName.isEmpty())
+                cameraName = QString::number(i);
+            result << QString("%1_%2.%3").arg(base, cameraName, fi.suffix());
+        }
+    }
+    foreach (const QString& fileName, result)
+        if (QFileInfo(fileName).exists())
+            fail(QString("Output image file %1 already exists").arg(fileName));
+    return result;
+}
+
+} // anonymous namespace
+
+CommandLine::CommandLine(const QStringList& args) :
+    m_mode(GuiMode),
+    m_hasSeed(false),
+    m_seed(0),
+    m_timeLimit(0),
+    m_threadCount(0),
+    m_progressInterval(10000)
+{
+    try {
+        parse(args);
+    }
+    catch(const std::exception& e) {
+        m_error = QString::fromUtf8(e.what());
+    }
+}
+
+bool CommandLine::isEmpty() const {
+    return m_mode == GuiMode   &&   m_error.isEmpty();
+}
+
+int CommandLine::run()
+{
+    using namespace std;
+    if (!m_error.isEmpty()   ||   m_mode == GuiMode) {
+        if (!m_error.isEmpty())
+            cerr << m_error.toStdString() << endl;
+        printUsage();
+        return 1;
+    }
+    try {
+        if (m_threadCount > 0)
+            WorkerPool::setInstanceThreadCount(m_threadCount);
+        switch (m_mode) {
+        case BatchMode:
+            runBatch();
+            break;
+        case ClientMode:
+            runClient();
+            break;
+        case MergeMode:
+            runMerge();
+            break;
+        case ServerMode:
+            runServer();
+            break;
+        case QuitServerMode:
+            quitServer();
+            break;
+        default:
+            Q_ASSERT(false);
+        }
+        return 0;
+    }
+    catch(const std::exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+}
+
+void CommandLine::printUsage()
+{
+    using namespace std;
+    cerr << "Usage:" << endl
+         << "  raytracer [scene]" << endl
+         << "    Opens the scene in the GUI (not available in raytracer_cli)" << endl
+         << "  raytracer scene image [options]" << endl
+         << "    Renders the scene to image (.png, .jpg, or raw canvas .pfm, .exr)" << endl
+         << "    --shard i/n         Render shard i of n, to be merged later; image must be .exr" << endl
+         << "    --seed s            Random number seed; shards of one render must use the same seed (0 by default)" << endl
+         << "    --rays n            Ray limit, replacing max_rays of the scene, e.g., 1e8" << endl
+         << "    --time-limit sec    Stop tracing after the time limit; light sources emit rays one after" << endl
+         << "                        another, so an interrupted render misses light of some sources" << endl
+         << "                        (cannot be combined with --shard)" << endl
+         << "    --threads n         Number of threads of image conversion and compression" << endl
+         << "    --progress sec      Interval between progress messages (10 by default, 0 for none)" << endl
+         << "    --overrides json    Object with properties replacing those of the scene file," << endl
+         << "                        e.g., {\"options\":{\"max_reflections\":10}}" << endl
+         << "    --connect server    Render by the render server rather than in this process" << endl
+         << "                        (--time-limit and --threads do not apply)" << endl
+         << "  raytracer --merge image shard.exr... [--scene scene]" << endl
+         << "    Sums canvases of shards and saves the result to image;" << endl
+         << "    the image processor of the scene is applied to .png and .jpg images" << endl
+         << "  raytracer --server server [--threads n]" << endl
+         << "    Runs render server listening on local socket server, keeping recently used scenes" << endl
+         << "    prepared for tracing" << endl
+         << "  raytracer --connect server --quit" << endl
+         << "    Makes the render server quit" << endl
+         << "Output options of render and merge commands:" << endl
+         << "    --format f          Image format: png, jpg, pfm, or exr; appended to image if it has no suffix" << endl
+         << "                        (png by default)" << endl
+         << "    --half              Store half precision numbers in .exr files" << endl
+         << "    --compression c     Compression of .exr files: none, zips, or zip (default)" << endl
+         << "    --tile n            Store .exr files as n x n tiles rather than scan lines" << endl
+         << "The raytracer_cli executable runs all commands but the first one without linking the GUI." << endl;
+}
+
+void CommandLine::parse(const QStringList& args)
+{
+    // Separate options from positional arguments
+    QStringList options;
+    bool merge = false;
+    bool quit = false;
+    QString serverName;
+    QString connectName;
+    quint64 rayLimit = 0;
+    for (int i=0; i<args.size(); ++i) {
+        const QString& arg = args[i];
+        if (!arg.startsWith("--")) {
+            m_positional << arg;
+            continue;
+        }
+        options << arg;
+        if (arg == "--merge")
+            merge = true;
+        else if (arg == "--quit")
+            quit = true;
+        else if (arg == "--half")
+            m_canvasFileOptions.setHalfPrecision(true);
+        else {
+            if (++i == args.size())
+                fail("Option " + arg + " requires a value");
+            const QString& value = args[i];
+            if (arg == "--shard")
+                m_shard = RenderShard::parse(value);
+            else if (arg == "--seed") {
+                bool ok = false;
+                m_seed = value.toUInt(&ok);
+                if (!ok)
+                    fail("Invalid seed '" + value + "'");
+                m_hasSeed = true;
+            }
+            else if (arg == "--rays")
+                rayLimit = static_cast<quint64>(parseNumber(arg, value, 1));
+            else if (arg == "--time-limit")
+                m_timeLimit = std::max(1, static_cast<int>(parseNumber(arg, value, 0.001) * 1000));
+            else if (arg == "--threads")
+                m_threadCount = parseInt(arg, value, 1);
+            else if (arg == "--progress")
+                m_progressInterval = static_cast<int>(parseNumber(arg, value, 0) * 1000);
+            else if (arg == "--overrides") {
+                QVariant overrides = parseJson(value);
+                if (overrides.type() != QVariant::Map)
+                    fail("Overrides must be a JSON object");
+                m_overrides = m_overrides.isValid() ?   overrideProperties(m_overrides, overrides) :   overrides;
+            }
+            else if (arg == "--format") {
+                m_format = value.toLower();
+                if (!QRegExp("png|jpe?g|pfm|exr").exactMatch(m_format))
+                    fail("Unknown image format '" + value + "'");
+            }
+            else if (arg == "--compression") {
+                if (value == "none")
+                    m_canvasFileOptions.setCompression(CanvasFile::NoCompression);
+                else if (value == "zips")
+                    m_canvasFileOptions.setCompression(CanvasFile::ZipsCompression);
+                else if (value == "zip")
+                    m_canvasFileOptions.setCompression(CanvasFile::ZipCompression);
+                else
+                    fail("Unknown compression '" + value + "'");
+            }
+            else if (arg == "--tile")
+                m_canvasFileOptions.setTileSize(parseInt(arg, value, 1));
+            else if (arg == "--scene")
+                m_sceneFileName = value;
+            else if (arg == "--server")
+                serverName = value;
+            else if (arg == "--connect")
+                connectName = value;
+            else
+                fail("Unknown option " + arg);
+        }
+    }
+
+    // The ray limit replaces that of the scene and of overrides
+    if (rayLimit > 0) {
+        QVariantMap rayOptions;
+        rayOptions["max_rays"] = rayLimit;
+        QVariantMap rayOverrides;
+        rayOverrides["options"] = rayOptions;
+        m_overrides = overrideProperties(m_overrides.isValid() ?   m_overrides :   QVariantMap(), rayOverrides);
+    }
+
+    // Determine the command and check that its options apply to it
+    QStringList outputOptions = QStringList() << "--format" << "--half" << "--compression" << "--tile";
+    QStringList renderOptions = QStringList(outputOptions)
+            << "--shard" << "--seed" << "--rays" << "--progress" << "--overrides";
+    QStringList allowedOptions;
+    if (!serverName.isEmpty()) {
+        m_mode = ServerMode;
+        m_serverName = serverName;
+        allowedOptions << "--server" << "--threads";
+    }
+    else if (quit) {
+        if (connectName.isEmpty())
+            fail("Option --quit requires --connect");
+        m_mode = QuitServerMode;
+        m_serverName = connectName;
+        allowedOptions << "--connect" << "--quit";
+    }
+    else if (merge) {
+        if (m_positional.size() < 2)
+            fail("Option --merge requires the image and shard files");
+        m_mode = MergeMode;
+        allowedOptions << outputOptions << "--merge" << "--scene" << "--threads";
+    }
+    else if (m_positional.size() == 2) {
+        if (connectName.isEmpty()) {
+            m_mode = BatchMode;
+            allowedOptions << renderOptions << "--time-limit" << "--threads";
+            // A shard cut short is not a sample of the whole render, so merging would bias the image
+            if (m_timeLimit > 0   &&   m_shard.count() > 1)
+                fail("Option --time-limit cannot be combined with --shard");
+        }
+        else {
+            m_mode = ClientMode;
+            m_serverName = connectName;
+            allowedOptions << renderOptions << "--connect";
+        }
+    }
+    else if (m_positional.size() < 2   &&   options.isEmpty())
+        return;
+    else
+        fail("Invalid arguments");
+    if (m_positional.size() > 0   &&   (m_mode == ServerMode   ||   m_mode == QuitServerMode))
+        fail("Unexpected argument " + m_positional[0]);
+    foreach (const QString& option, options)
+        if (!allowedOptions.contains(option))
+            fail("Option " + option + " does not apply to this command");
+}
+
+QString CommandLine::outputFileName(QString imageFileName) const
+{
+    bool knownFormat = imageFileName.indexOf(QRegExp("\\.png$|\\.jpe?g$")) != -1   ||
+            CanvasFile::isSupported(imageFileName);
+    if (!knownFormat)
+        imageFileName += "." + (m_format.isEmpty() ?   QString("png") :   m_format);
+    else if (!m_format.isEmpty()   &&   !imageFileName.endsWith("." + m_format, Qt::CaseInsensitive))
+        fail("Image file " + imageFileName + " does not match format " + m_format);
+    if (m_shard.count() > 1   &&   !imageFileName.endsWith(".exr", Qt::CaseInsensitive))
+        fail("Shards must be saved to .exr files, to be merged later");
+    return imageFileName;
+}
+
+void CommandLine::save(const Camera::Canvas& canvas, const QString& fileName,
+                       const CanvasFile::RenderInfo& info, const ImageProcessor& imageProcessor) const
+{
+    if (CanvasFile::isSupported(fileName))
+        // Keep raw canvas, to be processed or merged later
+        CanvasFile::write(canvas, fileName, info, m_canvasFileOptions);
+    else if (!imageProcessor(canvas).toImage(QImage::Format_RGB888).save(fileName))
+        fail("Failed to save image " + fileName);
+}
+
+void CommandLine::runBatch()
+{
+    using namespace std;
+    QString sceneFileName = m_positional[0];
+    QString imageFileName = outputFileName(m_positional[1]);
+    FileReader::Ptr f = FileReader::newInstance("JsonFileReader");
+    RayTracer rayTracer;
+    QVariant scene = f->read(sceneFileName);
+    rayTracer.read(m_overrides.isValid() ?   overrideProperties(scene, m_overrides) :   scene);
+
+    // Trace the part of the ray limit assigned to the shard, with its own random numbers
+    rnd::Seed baseSeed = m_hasSeed ?   m_seed :   m_shard.count() > 1 ?   0 :   rnd::seed();
+    auto options = rayTracer.options();
+    quint64 totalRayLimit = options.totalRayLimit;
+    options.totalRayLimit = m_shard.rayLimit(totalRayLimit);
+    rayTracer.setOptions(options);
+    rnd::setSeed(m_shard.seed(baseSeed));
+
+    auto& cameras = rayTracer.cameras();
+    if (cameras.empty())
+        fail("There is no camera in the scene");
+    QStringList cameraNames;
+    for (const Camera::Ptr& camera : cameras)
+        cameraNames << camera->name();
+    QStringList imageFileNames = cameraImageFileNames(imageFileName, cameraNames);
+
+    cout << "Input scene: " << sceneFileName.toStdString() << endl;
+    if (m_shard.count() > 1)
+        cout << "Shard " << m_shard.index()+1 << " of " << m_shard.count() << ", seed " << baseSeed << endl;
+    foreach (const QString& fileName, imageFileNames)
+        cout << "Output image: " << fileName.toStdString() << endl;
+
+    // The progress callback also checks the time limit, more often than progress is printed
+    QTime time;
+    quint64 totalRays = options.totalRayLimit;
+    quint64 tracedRays = 0;
+    bool timeLimitReached = false;
+    int lastProgressTime = 0;
+    int callbackInterval = m_progressInterval;
+    if (m_timeLimit > 0)
+        callbackInterval = callbackInterval > 0 ?
+                    std::min(callbackInterval, TimeLimitCheckInterval) :
+                    TimeLimitCheckInterval;
+    cout << setprecision(3);
+    if (callbackInterval > 0)
+        rayTracer.setProgressCallback([&](float progress, bool finished, quint64 rays) {
+            tracedRays = rays;
+            int elapsed = time.elapsed();
+            if (m_timeLimit > 0   &&   !finished   &&   !timeLimitReached   &&   elapsed >= m_timeLimit) {
+                timeLimitReached = true;
+                rayTracer.requestTermination();
+            }
+            if (m_progressInterval > 0   &&   (finished   ||   elapsed - lastProgressTime >= m_progressInterval)) {
+                lastProgressTime = elapsed;
+                cout << "progress: "<< defaultfloat << progress*100 << "%, "
+                     << scientific << static_cast<double>(rays) << " of " << static_cast<double>(totalRays) << " rays, "
+                     << defaultfloat << elapsed / 1000. << " s"
+                     << endl;
+            }
+        }, callbackInterval);
+    time.start();
+    rayTracer.run();
+    cout << defaultfloat;
+    cout << "Time elapsed (sec): " << time.elapsed() / 1000. << endl;
+
+    auto info = m_shard.renderInfo(totalRayLimit, baseSeed);
+    if (timeLimitReached) {
+        // Light sources emit rays in turn, so those not reached are missing from the image
+        cout << "Time limit reached after " << scientific << static_cast<double>(tracedRays) << " rays, "
+             << "the image lacks light of sources not traced completely" << endl;
+        cout << defaultfloat;
+    }
+    for (std::size_t i=0; i<cameras.size(); ++i)
+        save(cameras[i]->canvas(), imageFileNames[i], info, *rayTracer.imageProcessor());
+}
+
+void CommandLine::runClient()
+{
+    using namespace std;
+    QString sceneFileName = m_positional[0];
+    QString imageFileName = outputFileName(m_positional[1]);
+
+    // The server resolves file names relative to the working directory of the client
+    QVariantMap request;
+    request["scene"] = QFileInfo(sceneFileName).absoluteFilePath();
+    request["dir"] = QDir::currentPath();
+    if (m_overrides.isValid())
+        request["overrides"] = m_overrides;
+    if (m_shard.count() > 1)
+        request["shard"] = QString("%1/%2").arg(m_shard.index()+1).arg(m_shard.count());
+    if (m_hasSeed)
+        request["seed"] = m_seed;
+    // Raw canvases are saved as they are, images are processed by the server
+    request["processed"] = !CanvasFile::isSupported(imageFileName);
+
+    cout << "Input scene: " << sceneFileName.toStdString() << endl;
+    cout << "Render server: " << m_serverName.toStdString() << endl;
+    QTime time;
+    cout << setprecision(3);
+    RenderClient::ProgressCallback progressCallback;
+    if (m_progressInterval > 0) {
+        request["progress_interval"] = m_progressInterval;
+        progressCallback = [&time](float progress, quint64 rays) {
+            cout << "progress: "<< defaultfloat << progress*100 << "%, "
+                 << scientific << static_cast<double>(rays) << " rays, "
+                 << defaultfloat << time.elapsed() / 1000. << " s"
+                 << endl;
+        };
+    }
+    time.start();
+    auto result = RenderClient(m_serverName).render(request, progressCallback);
+    cout << defaultfloat;
+    cout << "Time elapsed (sec): " << time.elapsed() / 1000. << endl;
+    cout << "Server time (sec): " << result.seconds << (result.cached ?   ", scene cached" :   "") << endl;
+
+    if (result.outputs.empty())
+        fail("There is no camera in the scene");
+    QStringList cameraNames;
+    for (const RenderClient::Output& output : result.outputs)
+        cameraNames << output.camera;
+    QStringList imageFileNames = cameraImageFileNames(imageFileName, cameraNames);
+    IdentityImageProcessor identity;
+    for (std::size_t i=0; i<result.outputs.size(); ++i) {
+        cout << "Output image: " << imageFileNames[i].toStdString() << endl;
+        save(result.outputs[i].canvas, imageFileNames[i], result.outputs[i].info, identity);
+    }
+}
+
+void CommandLine::runMerge()
+{
+    using namespace std;
+    QString imageFileName = outputFileName(m_positional[0]);
+    if (QFileInfo(imageFileName).exists())
+        fail(QString("Output image file %1 already exists").arg(imageFileName));
+    CanvasFile::RenderInfo info;
+    QStringList shardFileNames = m_positional.mid(1);
+    auto canvas = RenderShard::merge(shardFileNames, &info);
+    ImageProcessor::Ptr imageProcessor = IdentityImageProcessor::newInstance();
+    if (!m_sceneFileName.isEmpty()   &&   !CanvasFile::isSupported(imageFileName)) {
+        RayTracer rayTracer;
+        rayTracer.read(FileReader::newInstance("JsonFileReader")->read(m_sceneFileName));
+        imageProcessor = rayTracer.imageProcessor();
+    }
+    save(canvas, imageFileName, info, *imageProcessor);
+    cout << "Merged " << shardFileNames.size() << " shards into " << imageFileName.toStdString() << endl;
+}
+
+void CommandLine::runServer()
+{
+    std::cout << "Render server: " << m_serverName.toStdString() << std::endl;
+    RenderServer(m_serverName).run();
+}
+
+void CommandLine::quitServer()
+{
+    RenderClient(m_serverName).quit();
+}
+
+} // end namespace raytracer
@@ -0,0 +1,80 @@
+/// \file
+/// \brief Declaration of the CommandLine class.
+
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include "canvas_file.h"
+#include "render_shard.h"
+#include "image_processor.h"
+
+#include <QStringList>
+#include <QVariant>
+
+namespace raytracer {
+
+/// \brief Commands rendering without the GUI, specified by command line arguments.
+///
+/// The commands are batch render of a scene to image files, locally or by the render
+/// server (see RenderServer), merge of shards (see RenderShard), running the render
+/// server and making it quit; see printUsage() for arguments. Commands only need
+/// QCoreApplication, so the GUI executable runs them without creating its widgets,
+/// and the command line executable does not link the GUI at all.
+class CommandLine
+{
+public:
+    /// \brief Parses command line arguments \a args, excluding the program name.
+    explicit CommandLine(const QStringList& args);
+
+    /// \brief Returns true if the arguments specify no command, i.e., there are
+    /// no arguments or only the scene file to open in the GUI.
+    bool isEmpty() const;
+
+    /// \brief Runs the command and returns the exit code of the process.
+    ///
+    /// Progress is printed to the standard output, errors to the standard error;
+    /// invalid arguments are reported along with the usage.
+    int run();
+
+    /// \brief Prints command line usage to the standard error.
+    static void printUsage();
+
+private:
+    enum Mode {
+        GuiMode,
+        BatchMode,
+        ClientMode,
+        MergeMode,
+        ServerMode,
+        QuitServerMode
+    };
+
+    Mode m_mode;
+    QString m_error;
+    QStringList m_positional;
+    QString m_sceneFileName;
+    QString m_serverName;
+    RenderShard m_shard;
+    bool m_hasSeed;
+    rnd::Seed m_seed;
+    QVariant m_overrides;
+    int m_timeLimit;            // Milliseconds, zero means no limit
+    int m_threadCount;          // Zero means the default
+    int m_progressInterval;     // Milliseconds, zero means no progress output
+    QString m_format;
+    CanvasFile::Options m_canvasFileOptions;
+
+    void parse(const QStringList& args);
+    QString outputFileName(QString imageFileName) const;
+    void save(const Camera::Canvas& canvas, const QString& fileName,
+              const CanvasFile::RenderInfo& info, const ImageProcessor& imageProcessor) const;
+    void runBatch();
+    void runClient();
+    void runMerge();
+    void runServer();
+    void quitServer();
+};
+
+} // end namespace raytracer
+
+#endif // COMMAND_LINE_H
@@ -0,0 +1,22 @@
+# Links the static core library built by core.pro
+
+# The build directory of core.pro, wherever the including project is
+win32:CONFIG(release, debug|release): RAYTRACER_CORE_DIR = $$shadowed($$PWD)/release
+else:win32:CONFIG(debug, debug|release): RAYTRACER_CORE_DIR = $$shadowed($$PWD)/debug
+else: RAYTRACER_CORE_DIR = $$shadowed($$PWD)
+
+# Generators are registered by static objects nothing refers to (see REGISTER_GENERATOR),
+# so the whole library is linked rather than just the object files referenced
+win32-msvc* {
+    LIBS += -L$$RAYTRACER_CORE_DIR -lraytracer_core
+    QMAKE_LFLAGS += /WHOLEARCHIVE:raytracer_core.lib
+    PRE_TARGETDEPS += $$RAYTRACER_CORE_DIR/raytracer_core.lib
+}
+else:macx {
+    LIBS += -Wl,-force_load,$$RAYTRACER_CORE_DIR/libraytracer_core.a
+    PRE_TARGETDEPS += $$RAYTRACER_CORE_DIR/libraytracer_core.a
+}
+else {
+    LIBS += -Wl,--whole-archive $$RAYTRACER_CORE_DIR/libraytracer_core.a -Wl,--no-whole-archive
+    PRE_TARGETDEPS += $$RAYTRACER_CORE_DIR/libraytracer_core.a
+}
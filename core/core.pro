@@ -0,0 +1,126 @@
+# Ray tracing core: scene, primitives, cameras, surface properties, image processing,
+# and batch commands (see CommandLine); linked by the GUI and command line applications
+
+include(../raytracer.pri)
+
+QT       = core gui network
+
+TARGET = raytracer_core
+TEMPLATE = lib
+CONFIG += staticlib
+
+SOURCES += \
+    ../primitive_search.cpp \
+    ../ray_tracer.cpp \
+    ../scene.cpp \
+    ../camera.cpp \
+    ../primitives/sphere.cpp \
+    ../primitive.cpp \
+    ../json_file_reader.cpp \
+    ../json_parser.cpp \
+    ../primitives/rectangle.cpp \
+    ../transform.cpp \
+    ../simple_camera.cpp \
+    ../lights/point_light.cpp \
+    ../light_source.cpp \
+    ../surfprop/black_surface.cpp \
+    ../surfprop/s_p_reflection.cpp \
+    ../rnd.cpp \
+    ../surfprop/simple_diffuse_surface.cpp \
+    ../surfprop/s_p_matt.cpp \
+    ../primitives/single_sided_rectangle.cpp \
+    ../image_processor.cpp \
+    ../flat_lens_camera.cpp \
+    ../lights/area_light.cpp \
+    ../lights/rectangle_light.cpp \
+    ../lights/sphere_light.cpp \
+    ../lights/primitive_light.cpp \
+    ../surfprop/emissive_surface.cpp \
+    ../lens_prescription.cpp \
+    ../lens_polynomial.cpp \
+    ../polynomial_lens_camera.cpp \
+    ../ray_data_writer.cpp \
+    ../ray_file_format.cpp \
+    ../ray_file_reader.cpp \
+    ../ray_file_writer.cpp \
+    ../ray_replay.cpp \
+    ../light_vertex_cache.cpp \
+    ../sparse_canvas.cpp \
+    ../worker_pool.cpp \
+    ../image_filter.cpp \
+    ../denoise_image.cpp \
+    ../canvas_image_converter.cpp \
+    ../progress_monitor.cpp \
+    ../canvas_file.cpp \
+    ../render_shard.cpp \
+    ../render_message.cpp \
+    ../render_server.cpp \
+    ../render_client.cpp \
+    ../command_line.cpp \
+    ../capture_plane.cpp
+
+HEADERS += \
+    ../compile_assert.h \
+    ../fsmx.h \
+    ../cxx_exception.h \
+    ../m_const.h \
+    ../surf_mesh_common.h \
+    ../surf_mesh_extruded.h \
+    ../surf_mesh_revolved.h \
+    ../primitive.h \
+    ../ray.h \
+    ../bounding_sphere.h \
+    ../common.h \
+    ../primitive_search.h \
+    ../surface_point.h \
+    ../surface_properties.h \
+    ../ray_tracer.h \
+    ../scene.h \
+    ../camera.h \
+    ../light_source.h \
+    ../primitives/sphere.h \
+    ../serial.h \
+    ../factory.h \
+    ../json_file_reader.h \
+    ../json_parser.h \
+    ../primitives/rectangle.h \
+    ../transform.h \
+    ../simple_camera.h \
+    ../lights/point_light.h \
+    ../surfprop/black_surface.h \
+    ../surfprop/s_p_reflection.h \
+    ../rnd.h \
+    ../surfprop/simple_diffuse_surface.h \
+    ../surfprop/s_p_matt.h \
+    ../primitives/single_sided_rectangle.h \
+    ../math_util.h \
+    ../image_processor.h \
+    ../flat_lens_camera.h \
+    ../lights/area_light.h \
+    ../lights/rectangle_light.h \
+    ../lights/sphere_light.h \
+    ../lights/primitive_light.h \
+    ../surfprop/emissive_surface.h \
+    ../ray_batch.h \
+    ../lens_prescription.h \
+    ../lens_polynomial.h \
+    ../polynomial_lens_camera.h \
+    ../ray_data_writer.h \
+    ../ray_file_format.h \
+    ../ray_file_reader.h \
+    ../ray_file_writer.h \
+    ../ray_replay.h \
+    ../light_vertex_cache.h \
+    ../sparse_canvas.h \
+    ../worker_pool.h \
+    ../image_filter.h \
+    ../denoise_image.h \
+    ../canvas_image_converter.h \
+    ../progress_monitor.h \
+    ../canvas_file.h \
+    ../render_shard.h \
+    ../render_message.h \
+    ../render_server.h \
+    ../render_client.h \
+    ../command_line.h \
+    ../capture_plane.h
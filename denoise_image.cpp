@@ -0,0 +1,186 @@
+/// \file
+/// \brief Implementation of the DenoiseImage class.
+
+#include "denoise_image.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace raytracer {
+
+REGISTER_GENERATOR(DenoiseImage)
+
+namespace {
+
+// Width and height of a tile processed by one task
+const int TileSize = 32;
+
+// Guide data of a pixel
+struct GuidePixel
+{
+    v3f color;
+    float variance;
+    bool hasFeatures;
+    v3f normal;
+    v3f albedo;
+};
+
+inline float squaredDistance(const v3f& a, const v3f& b)
+{
+    v3f d = a - b;
+    return dot(d, d);
+}
+
+} // anonymous namespace
+
+DenoiseImage::DenoiseImage() :
+    m_radius(4),
+    m_spatialSigma(-1.f),
+    m_strength(2.f),
+    m_colorSigma(0.2f),
+    m_normalSigma(0.3f),
+    m_albedoSigma(0.1f)
+{
+}
+
+DenoiseImage& DenoiseImage::setRadius(int radius)
+{
+    m_radius = std::max(radius, 0);
+    return *this;
+}
+
+DenoiseImage& DenoiseImage::setSpatialSigma(float spatialSigma)
+{
+    m_spatialSigma = spatialSigma;
+    return *this;
+}
+
+DenoiseImage& DenoiseImage::setStrength(float strength)
+{
+    m_strength = strength;
+    return *this;
+}
+
+DenoiseImage& DenoiseImage::setColorSigma(float colorSigma)
+{
+    m_colorSigma = colorSigma;
+    return *this;
+}
+
+DenoiseImage& DenoiseImage::setNormalSigma(float normalSigma)
+{
+    m_normalSigma = normalSigma;
+    return *this;
+}
+
+DenoiseImage& DenoiseImage::setAlbedoSigma(float albedoSigma)
+{
+    m_albedoSigma = albedoSigma;
+    return *this;
+}
+
+Camera::Canvas DenoiseImage::operator()(const Camera::Canvas& canvas) const
+{
+    const int width = canvas.size()[0];
+    const int height = canvas.size()[1];
+    auto& pool = WorkerPool::instance();
+
+    // Collect guide data
+    const bool hasStatistics = canvas.hasFeatureBuffers();
+    std::vector<GuidePixel> guide(canvas.length());
+    pool.run(height, [&](int y) {
+        for (int i=y*width, end=i+width; i<end; ++i) {
+            auto& g = guide[i];
+            g.color = canvas[i];
+            g.hasFeatures = false;
+            if (hasStatistics) {
+                g.variance = canvas.squaredLuminanceSums()[i];
+                const v3f& normalSum = canvas.normalSums()[i];
+                float normalLength = normalSum.norm2();
+                if (normalLength > 0.f) {
+                    g.hasFeatures = true;
+                    g.normal = normalSum / normalLength;
+                    g.albedo = canvas.albedoSums()[i] / canvas.sampleCounts()[i];
+                }
+            }
+            else {
+                float luminance = (g.color[0] + g.color[1] + g.color[2]) / 3.f;
+                g.variance = luminance*luminance*m_colorSigma*m_colorSigma;
+            }
+        }
+    });
+
+    // Precompute spatial weights
+    const int r = m_radius;
+    const int n = 2*r + 1;
+    const float spatialSigma = m_spatialSigma > 0.f ?   m_spatialSigma :   std::max(0.5f*r, 0.5f);
+    std::vector<float> spatialWeights(n*n);
+    for (int dy=-r; dy<=r; ++dy)
+        for (int dx=-r; dx<=r; ++dx)
+            spatialWeights[(dx+r) + (dy+r)*n] = std::exp(-0.5f*(dx*dx + dy*dy)/(spatialSigma*spatialSigma));
+    const float colorFactor = 3.f*m_strength*m_strength;
+    const float normalFactor = m_normalSigma > 0.f ?   0.5f / (m_normalSigma*m_normalSigma) :   0.f;
+    const float albedoFactor = m_albedoSigma > 0.f ?   0.5f / (m_albedoSigma*m_albedoSigma) :   0.f;
+
+    // Filter tiles
+    auto result = Camera::Canvas::uninitialized(canvas.size());
+    const int tileCountX = (width + TileSize - 1) / TileSize;
+    const int tileCountY = (height + TileSize - 1) / TileSize;
+    pool.run(tileCountX*tileCountY, [&](int tile) {
+        int x0 = (tile % tileCountX) * TileSize;
+        int y0 = (tile / tileCountX) * TileSize;
+        int x1 = std::min(x0 + TileSize, width);
+        int y1 = std::min(y0 + TileSize, height);
+        for (int y=y0; y<y1; ++y)
+            for (int x=x0; x<x1; ++x) {
+                const auto& p = guide[x + y*width];
+                v3f sum = fsmx::zero<v3f>();
+                float weightSum = 0.f;
+                for (int qy=std::max(y-r, 0), qyEnd=std::min(y+r+1, height); qy<qyEnd; ++qy)
+                    for (int qx=std::max(x-r, 0), qxEnd=std::min(x+r+1, width); qx<qxEnd; ++qx) {
+                        const auto& q = guide[qx + qy*width];
+                        float exponent = 0.f;
+
+                        // Color difference compared to the noise level; squaredDistance()
+                        // sums three components, hence the factor of 3 in colorFactor
+                        float colorDistance = squaredDistance(p.color, q.color);
+                        if (colorDistance > 0.f) {
+                            float noise = colorFactor*(p.variance + q.variance);
+                            if (!(noise > 0.f))
+                                continue;
+                            exponent += colorDistance / noise;
+                        }
+                        if (p.hasFeatures   &&   q.hasFeatures)
+                            exponent += normalFactor*squaredDistance(p.normal, q.normal) +
+                                        albedoFactor*squaredDistance(p.albedo, q.albedo);
+                        float weight = spatialWeights[(qx-x+r) + (qy-y+r)*n] * std::exp(-exponent);
+                        sum += q.color*weight;
+                        weightSum += weight;
+                    }
+                result[x + y*width] = sum / weightSum;
+            }
+    });
+    result.copyFeatureBuffers(canvas);
+    return result;
+}
+
+void DenoiseImage::read(const QVariant &v)
+{
+    m_radius = 4;
+    m_spatialSigma = -1.f;
+    m_strength = 2.f;
+    m_colorSigma = 0.2f;
+    m_normalSigma = 0.3f;
+    m_albedoSigma = 0.1f;
+
+    readOptionalProperty(m_radius, v, "radius");
+    readOptionalProperty(m_spatialSigma, v, "spatial_sigma");
+    readOptionalProperty(m_strength, v, "strength");
+    readOptionalProperty(m_colorSigma, v, "color_sigma");
+    readOptionalProperty(m_normalSigma, v, "normal_sigma");
+    readOptionalProperty(m_albedoSigma, v, "albedo_sigma");
+    m_radius = std::max(m_radius, 0);
+}
+
+} // end namespace raytracer
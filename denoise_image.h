@@ -0,0 +1,63 @@
+/// \file
+/// \brief Declaration of the DenoiseImage class.
+
+#ifndef DENOISE_IMAGE_H
+#define DENOISE_IMAGE_H
+
+#include "image_processor.h"
+
+namespace raytracer {
+
+/// \brief Edge-aware denoiser: cross-bilateral filter guided by pixel statistics and surface features.
+///
+/// Each pixel is replaced with the weighted average of pixels in the square window
+/// of the specified radius. The weight of a neighbor is the product of
+/// - the Gaussian of the distance between pixels (\c spatial_sigma);
+/// - the Gaussian of the color difference, normalized by the noise level of both pixels
+///   times \c strength: neighbors whose difference can be explained by noise are averaged,
+///   and real edges are kept;
+/// - the Gaussian of the difference of surface normals (\c normal_sigma) and albedos
+///   (\c albedo_sigma), if both pixels have features.
+///
+/// The noise level of a pixel is estimated from its feature buffers
+/// (see Camera::Canvas::setFeatureBuffers() and RayTracer::Options::featureCanvases);
+/// without them, it is taken to be \c color_sigma times the pixel luminance, and surface
+/// features are not used. Image processors keep feature buffers, but the noise level
+/// refers to the rendered image, so the denoiser is best placed before stages changing
+/// pixel values nonlinearly, such as ClampImage and LogScaleImage.
+///
+/// The image is processed in tiles, in parallel (see WorkerPool). The result has no layers
+/// but keeps feature buffers.
+///
+/// Properties read from a map (all optional): \c radius (default 4), \c spatial_sigma
+/// (default is half the radius), \c strength (default 2), \c color_sigma (default 0.2),
+/// \c normal_sigma (default 0.3, zero disables the weight), \c albedo_sigma (default 0.1,
+/// zero disables the weight).
+class DenoiseImage : public ImageProcessor
+{
+    DECL_GENERATOR(DenoiseImage)
+public:
+    DenoiseImage();
+
+    DenoiseImage& setRadius(int radius);
+    DenoiseImage& setSpatialSigma(float spatialSigma);
+    DenoiseImage& setStrength(float strength);
+    DenoiseImage& setColorSigma(float colorSigma);
+    DenoiseImage& setNormalSigma(float normalSigma);
+    DenoiseImage& setAlbedoSigma(float albedoSigma);
+
+    Camera::Canvas operator()(const Camera::Canvas& canvas) const;
+    void read(const QVariant &v);
+
+private:
+    int m_radius;
+    float m_spatialSigma;
+    float m_strength;
+    float m_colorSigma;
+    float m_normalSigma;
+    float m_albedoSigma;
+};
+
+} // end namespace raytracer
+
+#endif // DENOISE_IMAGE_H
@@ -6,6 +6,10 @@
 #include "transform.h"
 #include "ray_tracer.h"
 #include "ray.h"
+#include "ray_file_writer.h"
+#include <cmath>
+#include <vector>
+#include <algorithm>
 
 namespace raytracer {
 
@@ -14,15 +18,29 @@ namespace {
 class CameraSurfProp : public SurfaceProperties
 {
 public:
+    /// \brief Bound of the interpolation error of lens normal components taken from the lens table.
+    static constexpr float LensTableMaxError = 1e-6f;
+
+    /// \brief Maximum number of lens table entries; if the screen is so large relative to
+    /// the lens radius that more entries are needed for the error bound, no table is used.
+    static const int LensTableMaxSize = 1 << 16;
+
     CameraSurfProp(
             const FlatLensCamera::Geometry& geom,
+            const std::shared_ptr<RayFileWriter>& raysWriter,
             Camera::Canvas& canvas,
             const m4f& transform) :
         m_geom(geom),
+        m_raysWriter(raysWriter),
         m_canvas(canvas),
         m_transform(transform),
-        m_invTransform(transform.inv())
+        m_invTransform(transform.inv()),
+        m_invR(1.f / geom.R),
+        m_eta(1.f / geom.refractionCoefficient),
+        m_pixelScale(mkv2f(-geom.resx/geom.matrixWidth, -geom.resy/geom.matrixHeight)),
+        m_pixelOffset(mkv2f(0.5f*geom.resx, 0.5f*geom.resy))
     {
+        buildLensTable();
     }
 
     void processCollision(
@@ -30,7 +48,8 @@ public:
             const SurfacePoint& surfacePoint,
             RayTracer& rayTracer) const
     {
-        Q_UNUSED(rayTracer);
+        if (m_raysWriter)
+            m_raysWriter->write(ray, surfacePoint);
 
 //        if (ray.generation == 0)
 //            // Ignore direct rays from light source
@@ -38,34 +57,36 @@ public:
 
         auto rEye = m_invTransform*conv<v4f>(v3f(sppos(surfacePoint)));
         v2f rScreen = rEye.block<2,1>(0,0);
-        float x = rScreen.norm2();
         v3f e = affine(m_invTransform)*ray.dir;
-        // The direction of the refracted ray
-        if (x != 0.f) {
-            float alpha = atan(x/m_geom.R);
-            v3f tau = mkv3f(rScreen[0]/x, rScreen[1]/x, 0.f);
-            v3f n = tau*static_cast<float>(sin(alpha));
-            n[2] = static_cast<float>(-cos(alpha));
-
-            v3f q = cross(n, e);
-            float sinIncomingTheta = q.norm2();
-            if (sinIncomingTheta != 0.f) {
-                q /= sinIncomingTheta;
-                float sinOutcomingTheta = sinIncomingTheta/m_geom.refractionCoefficient;
-                e = rotation(q, asin(sinIncomingTheta) - asin(sinOutcomingTheta))*e;
-            }
+
+        // The normal to the lens surface, n = (sin(alpha)*tau, -cos(alpha)),
+        // where tan(alpha) = |rScreen|/R and tau is the unit radial direction
+        float c = lensCos(rScreen[0]*rScreen[0] + rScreen[1]*rScreen[1]);
+        float cr = c*m_invR;
+        v3f n = mkv3f(rScreen[0]*cr, rScreen[1]*cr, -c);
+
+        // The direction of the refracted ray (Snell's law in vector form)
+        float cosIncomingTheta = -dot(n, e);
+        if (cosIncomingTheta < 0.f) {
+            n = -n;
+            cosIncomingTheta = -cosIncomingTheta;
         }
+        float k = 1.f - m_eta*m_eta*(1.f - cosIncomingTheta*cosIncomingTheta);
+        if (k < 0.f)
+            // Total internal reflection
+            return;
+        e = m_eta*e + (m_eta*cosIncomingTheta - std::sqrt(k))*n;
 
         float rayParamOnMatrix = m_geom.fx / e[2];
         v2f rMatrix = rScreen + rayParamOnMatrix*e.block<2,1>(0,0);
         auto xy = mkv2i(
-            static_cast<int>((0.5f - rMatrix[0]/m_geom.matrixWidth) * m_geom.resx),
-            static_cast<int>((0.5f - rMatrix[1]/m_geom.matrixHeight) * m_geom.resy));
+            static_cast<int>(rMatrix[0]*m_pixelScale[0] + m_pixelOffset[0]),
+            static_cast<int>(rMatrix[1]*m_pixelScale[1] + m_pixelOffset[1]));
         if (!m_canvas.contains(xy))
             return;
 
         //*
-        m_canvas[xy] += ray.color;
+        Camera::splat(m_canvas, xy, ray, rayTracer);
         /*/
         auto& pixel = m_canvas[index];
         for (int i=0; i<3; ++i)
@@ -76,9 +97,53 @@ public:
 
 private:
     const FlatLensCamera::Geometry& m_geom;
+    std::shared_ptr<RayFileWriter> m_raysWriter;
     Camera::Canvas& m_canvas;
     const m4f& m_transform;
     m4f m_invTransform;
+    float m_invR;
+    float m_eta;
+    v2f m_pixelScale;
+    v2f m_pixelOffset;
+
+    // Table of cos(alpha) = 1/sqrt(1 + rho^2/R^2) on a uniform grid in rho^2,
+    // rho being the distance from the screen center; each entry holds
+    // the value at a grid node and the increment to the next node.
+    // Empty if cos(alpha) is computed exactly (see LensTableMaxSize).
+    std::vector<v2f> m_lensTable;
+    float m_lensTableInvStep;
+
+    void buildLensTable()
+    {
+        // Linear interpolation error is at most h^2/8*max|f''|, where
+        // f(s) = 1/sqrt(1 + s/R^2), max|f''| = 3/(4*R^4), and h is the step in s = rho^2.
+        float R2 = m_geom.R*m_geom.R;
+        float rho2Max = 0.25f*(m_geom.screenWidth*m_geom.screenWidth + m_geom.screenHeight*m_geom.screenHeight);
+        float step = R2 * std::sqrt(32.f/3.f*LensTableMaxError);
+        m_lensTable.clear();
+        float intervals = std::ceil(rho2Max / step);
+        if (!(intervals <= LensTableMaxSize - 2))
+            return;
+        int size = static_cast<int>(intervals) + 2;
+        step = rho2Max / (size - 2);
+        m_lensTableInvStep = 1.f / step;
+        m_lensTable.resize(size);
+        auto f = [R2](double s) { return static_cast<float>(1 / std::sqrt(1 + s/R2)); };
+        for (int i=0; i<size; ++i) {
+            float f0 = f(i*step);
+            m_lensTable[i] = mkv2f(f0, f((i+1)*step) - f0);
+        }
+    }
+
+    float lensCos(float rho2) const
+    {
+        if (m_lensTable.empty())
+            return 1.f / std::sqrt(1.f + rho2*m_invR*m_invR);
+        float u = rho2*m_lensTableInvStep;
+        int i = std::min(static_cast<int>(u), static_cast<int>(m_lensTable.size()) - 1);
+        const v2f& entry = m_lensTable[i];
+        return entry[0] + (u - i)*entry[1];
+    }
 };
 
 } // anonymous namespace
@@ -107,25 +172,42 @@ void FlatLensCamera::clear()
     m_primitive->setTransform(T);
 
     m_primitive->setName("camera screen");
-    m_primitive->setSurfaceProperties(
-                std::make_shared<CameraSurfProp>(
-                    m_geometry,
-                    m_canvas,
-                    transform()));
-    if (!m_raysInputFileName.isEmpty())
-        readRays(m_raysInputFileName);
+
+    RayFileFormat::Header header;
+    header.setCameraType("FlatLensCamera");
+    header.setScreen(T, m_geometry.screenWidth, m_geometry.screenHeight);
+    header.resolution[0] = m_geometry.resx;
+    header.resolution[1] = m_geometry.resy;
+    header.parameters[0] = m_geometry.fovy;
+    header.parameters[1] = m_geometry.aspect;
+    header.parameters[2] = m_geometry.dist;
+    header.parameters[3] = m_geometry.focusingDistance;
+    header.parameters[4] = m_geometry.refractionCoefficient;
+    resetRaysWriter(header);
+
+    m_primitive->setSurfaceProperties(std::make_shared<CameraSurfProp>(
+                                          m_geometry, raysWriter(), m_canvas, transform()));
 }
 
 const Camera::Canvas& FlatLensCamera::canvas() const {
     return m_canvas;
 }
 
+Camera::Canvas& FlatLensCamera::canvas() {
+    return m_canvas;
+}
+
+SurfaceProperties::Ptr FlatLensCamera::makeSurfaceProperties(Canvas& canvas) const
+{
+    return std::make_shared<CameraSurfProp>(
+                m_geometry, std::shared_ptr<RayFileWriter>(), canvas, transform());
+}
+
 void FlatLensCamera::read(const QVariant &v)
 {
     Camera::read(v);
 
     m_geometry = Geometry();
-    m_raysInputFileName.clear();
 
     QVariantMap m = safeVariantMap(v);
     readOptionalProperty(m, "geometry", [this](const QVariant& v) {
@@ -141,8 +223,6 @@ void FlatLensCamera::read(const QVariant &v)
         m_geometry = g;
         m_geometry.computeValues();
     });
-    readOptionalProperty(m_raysInputFileName, m, "read_rays");
-
 }
 
 void FlatLensCamera::setGeometry(const Geometry& geometry)
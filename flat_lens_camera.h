@@ -90,6 +90,9 @@ public:
     Primitive::Ptr cameraPrimitive() const;
 
     const Canvas& canvas() const;
+    Canvas& canvas();
+
+    SurfaceProperties::Ptr makeSurfaceProperties(Canvas& canvas) const;
 
     void read(const QVariant &v);
 
@@ -99,7 +102,6 @@ public:
 private:
     Primitive::Ptr m_primitive;
     Geometry m_geometry;
-    QString m_raysInputFileName;
     Canvas m_canvas;
 };
 
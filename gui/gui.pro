@@ -0,0 +1,27 @@
+# GUI application; without arguments or with a scene file, opens the main window,
+# otherwise runs a batch command (see CommandLine) without creating QApplication
+
+include(../raytracer.pri)
+include(../core/core.pri)
+
+QT       += core gui network
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = raytracer
+TEMPLATE = app
+
+SOURCES += \
+    ../main.cpp \
+    ../mainwindow.cpp \
+    ../ray_tracer_controller.cpp \
+    ../image_processor_controller.cpp \
+    ../preview_renderer.cpp
+
+HEADERS += \
+    ../mainwindow.h \
+    ../ray_tracer_controller.h \
+    ../image_processor_controller.h \
+    ../preview_renderer.h
+
+FORMS    += ../mainwindow.ui
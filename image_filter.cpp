@@ -0,0 +1,321 @@
+/// \file
+/// \brief Implementation of separable image filters.
+
+#include "image_filter.h"
+#include "worker_pool.h"
+#include "cxx_exception.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace raytracer {
+
+REGISTER_GENERATOR(GaussianBlurImage)
+
+REGISTER_GENERATOR(BoxBlurImage)
+
+namespace {
+
+// Number of columns of a plane filtered by one task
+const int ColumnStripeWidth = 256;
+
+// Number of rows of a plane filtered by one task
+const int RowBandHeight = 16;
+
+} // anonymous namespace
+
+SeparableImageFilter::SeparableImageFilter() :
+    m_border(ClampBorder)
+{
+}
+
+SeparableImageFilter::Border SeparableImageFilter::border() const
+{
+    return m_border;
+}
+
+SeparableImageFilter& SeparableImageFilter::setBorder(Border border)
+{
+    m_border = border;
+    return *this;
+}
+
+Camera::Canvas SeparableImageFilter::operator()(const Camera::Canvas& canvas) const
+{
+    const int width = canvas.size()[0];
+    const int height = canvas.size()[1];
+    const int pixelCount = width*height;
+    if (pixelCount == 0)
+        return Camera::Canvas(canvas.size());
+    const int r = radius();
+    auto& pool = WorkerPool::instance();
+
+    // Split canvas into color planes
+    std::vector<float> planes(3*pixelCount);
+    const v3f *pixels = canvas.data().data();
+    pool.run(3*height, [&](int task) {
+        int color = task / height;
+        int y = task % height;
+        float *dst = planes.data() + color*pixelCount + y*width;
+        const v3f *src = pixels + y*width;
+        for (int x=0; x<width; ++x)
+            dst[x] = src[x][color];
+    });
+
+    // Filter rows; the result has r extra rows above and below each plane
+    const int paddedPlaneSize = (height + 2*r)*width;
+    std::vector<float> rowFiltered(3*paddedPlaneSize);
+    const int rowBandCount = (height + RowBandHeight - 1) / RowBandHeight;
+    pool.run(3*rowBandCount, [&](int task) {
+        int color = task / rowBandCount;
+        int y0 = (task % rowBandCount) * RowBandHeight;
+        int y1 = std::min(y0 + RowBandHeight, height);
+        std::vector<float> paddedRow(width + 2*r);
+        for (int y=y0; y<y1; ++y) {
+            const float *src = planes.data() + color*pixelCount + y*width;
+            for (int x=-r; x<width+r; ++x) {
+                int i = borderIndex(x, width);
+                paddedRow[x+r] = i < 0 ?   0.f :   src[i];
+            }
+            filterRow(rowFiltered.data() + color*paddedPlaneSize + (y+r)*width, paddedRow.data(), width);
+        }
+    });
+    for (int color=0; color<3; ++color) {
+        float *plane = rowFiltered.data() + color*paddedPlaneSize;
+        for (int y=-r; y<height+r; ++y) {
+            if (y >= 0   &&   y < height)
+                continue;
+            int i = borderIndex(y, height);
+            float *dst = plane + (y+r)*width;
+            if (i < 0)
+                std::fill(dst, dst + width, 0.f);
+            else {
+                const float *src = plane + (i+r)*width;
+                std::copy(src, src + width, dst);
+            }
+        }
+    }
+
+    // Filter columns
+    const int stripeCount = (width + ColumnStripeWidth - 1) / ColumnStripeWidth;
+    pool.run(3*stripeCount, [&](int task) {
+        int color = task / stripeCount;
+        int x0 = (task % stripeCount) * ColumnStripeWidth;
+        int stripeWidth = std::min(static_cast<int>(ColumnStripeWidth), width - x0);
+        filterColumns(
+                    planes.data() + color*pixelCount + x0,
+                    rowFiltered.data() + color*paddedPlaneSize + x0,
+                    stripeWidth, height, width);
+    });
+
+    // Merge color planes
+    auto result = Camera::Canvas::uninitialized(canvas.size());
+    v3f *dst = result.data().data();
+    pool.run(height, [&](int y) {
+        for (int color=0; color<3; ++color) {
+            const float *src = planes.data() + color*pixelCount + y*width;
+            for (int x=0; x<width; ++x)
+                dst[y*width + x][color] = src[x];
+        }
+    });
+    result.copyFeatureBuffers(canvas);
+    return result;
+}
+
+void SeparableImageFilter::read(const QVariant &v)
+{
+    readOptionalProperty(v, "border", [this](const QVariant& v) {
+        auto border = fromVariant<QString>(v);
+        if (border == "clamp")
+            m_border = ClampBorder;
+        else if (border == "mirror")
+            m_border = MirrorBorder;
+        else if (border == "zero")
+            m_border = ZeroBorder;
+        else
+            throw cxx::exception(std::string("Unknown image filter border mode '") + border.toStdString() + "'");
+    });
+}
+
+int SeparableImageFilter::borderIndex(int i, int n) const
+{
+    if (i >= 0   &&   i < n)
+        return i;
+    switch (m_border) {
+    case ClampBorder:
+        return i < 0 ?   0 :   n - 1;
+    case MirrorBorder:
+        i %= 2*n;
+        if (i < 0)
+            i += 2*n;
+        return i < n ?   i :   2*n - 1 - i;
+    default:
+        return -1;
+    }
+}
+
+
+
+GaussianBlurImage::GaussianBlurImage()
+{
+    setKernel(1.f, -1);
+}
+
+GaussianBlurImage::GaussianBlurImage(float sigma, int radius)
+{
+    setKernel(sigma, radius);
+}
+
+float GaussianBlurImage::sigma() const
+{
+    return m_sigma;
+}
+
+void GaussianBlurImage::read(const QVariant &v)
+{
+    if (v.type() == QVariant::Map) {
+        float sigma = 1.f;
+        int radius = -1;
+        readProperty(sigma, v, "sigma");
+        readOptionalProperty(radius, v, "radius");
+        setKernel(sigma, radius);
+        SeparableImageFilter::read(v);
+    }
+    else
+        setKernel(fromVariant<float>(v), -1);
+}
+
+int GaussianBlurImage::radius() const
+{
+    return m_radius;
+}
+
+void GaussianBlurImage::filterRow(float *dst, const float *src, int count) const
+{
+    std::fill(dst, dst + count, 0.f);
+    for (std::size_t j=0; j<m_kernel.size(); ++j) {
+        const float k = m_kernel[j];
+        const float *s = src + j;
+        for (int x=0; x<count; ++x)
+            dst[x] += k*s[x];
+    }
+}
+
+void GaussianBlurImage::filterColumns(float *dst, const float *src, int width, int height, int stride) const
+{
+    for (int y=0; y<height; ++y) {
+        float *d = dst + y*stride;
+        std::fill(d, d + width, 0.f);
+        for (std::size_t j=0; j<m_kernel.size(); ++j) {
+            const float k = m_kernel[j];
+            const float *s = src + (y+j)*stride;
+            for (int x=0; x<width; ++x)
+                d[x] += k*s[x];
+        }
+    }
+}
+
+void GaussianBlurImage::setKernel(float sigma, int radius)
+{
+    m_sigma = std::max(sigma, 0.f);
+    m_radius = radius >= 0 ?   radius :   static_cast<int>(std::ceil(3.f*m_sigma));
+    m_kernel.resize(2*m_radius + 1);
+    if (m_sigma > 0.f) {
+        float sum = 0.f;
+        for (int j=-m_radius; j<=m_radius; ++j)
+            sum += m_kernel[j+m_radius] = std::exp(-0.5f*j*j/(m_sigma*m_sigma));
+        for (auto& k : m_kernel)
+            k /= sum;
+    }
+    else {
+        std::fill(m_kernel.begin(), m_kernel.end(), 0.f);
+        m_kernel[m_radius] = 1.f;
+    }
+}
+
+
+
+BoxBlurImage::BoxBlurImage() :
+    m_radius(1),
+    m_passes(1)
+{
+}
+
+BoxBlurImage::BoxBlurImage(int radius, int passes) :
+    m_radius(std::max(radius, 0)),
+    m_passes(std::max(passes, 1))
+{
+}
+
+int BoxBlurImage::passes() const
+{
+    return m_passes;
+}
+
+Camera::Canvas BoxBlurImage::operator()(const Camera::Canvas& canvas) const
+{
+    auto result = SeparableImageFilter::operator()(canvas);
+    for (int pass=1; pass<m_passes; ++pass)
+        result = SeparableImageFilter::operator()(result);
+    return result;
+}
+
+void BoxBlurImage::read(const QVariant &v)
+{
+    if (v.type() == QVariant::Map) {
+        readProperty(m_radius, v, "radius");
+        readOptionalProperty(m_passes, v, "passes");
+        SeparableImageFilter::read(v);
+    }
+    else
+        m_radius = fromVariant<int>(v);
+    m_radius = std::max(m_radius, 0);
+    m_passes = std::max(m_passes, 1);
+}
+
+int BoxBlurImage::radius() const
+{
+    return m_radius;
+}
+
+void BoxBlurImage::filterRow(float *dst, const float *src, int count) const
+{
+    // The running sum is kept in double precision, so that rounding errors do not accumulate
+    const int n = 2*m_radius + 1;
+    const double factor = 1. / n;
+    double sum = 0;
+    for (int j=0; j<n; ++j)
+        sum += src[j];
+    for (int x=0; x<count; ++x) {
+        dst[x] = static_cast<float>(sum*factor);
+        if (x+1 < count)
+            sum += src[x+n] - src[x];
+    }
+}
+
+void BoxBlurImage::filterColumns(float *dst, const float *src, int width, int height, int stride) const
+{
+    // Running sums of all columns are updated together, one row at a time
+    const int n = 2*m_radius + 1;
+    const double factor = 1. / n;
+    std::vector<double> sums(width, 0.);
+    double *sum = sums.data();
+    for (int j=0; j<n; ++j) {
+        const float *s = src + j*stride;
+        for (int x=0; x<width; ++x)
+            sum[x] += s[x];
+    }
+    for (int y=0; y<height; ++y) {
+        float *d = dst + y*stride;
+        for (int x=0; x<width; ++x)
+            d[x] = static_cast<float>(sum[x]*factor);
+        if (y+1 < height) {
+            const float *added = src + (y+n)*stride;
+            const float *removed = src + y*stride;
+            for (int x=0; x<width; ++x)
+                sum[x] += added[x] - removed[x];
+        }
+    }
+}
+
+} // end namespace raytracer
@@ -0,0 +1,116 @@
+/// \file
+/// \brief Declaration of separable image filters.
+
+#ifndef IMAGE_FILTER_H
+#define IMAGE_FILTER_H
+
+#include "image_processor.h"
+
+namespace raytracer {
+
+/// \brief Base class for separable image filters.
+///
+/// The canvas is split into color planes; each plane is filtered along rows,
+/// then along columns. The inner loops run over contiguous floats of a plane,
+/// so the compiler can vectorize them. Rows and columns are processed in parallel
+/// (see WorkerPool). Pixels outside the canvas are defined by the border mode.
+///
+/// Properties read from a map (all optional):
+/// - \c border: one of \c 'clamp' (repeat edge pixels, default), \c 'mirror' (reflect at edges),
+///   \c 'zero' (black outside).
+///
+/// The result has no layers but keeps feature buffers.
+class SeparableImageFilter : public ImageProcessor
+{
+public:
+    enum Border { ClampBorder, MirrorBorder, ZeroBorder };
+
+    SeparableImageFilter();
+
+    Border border() const;
+    SeparableImageFilter& setBorder(Border border);
+
+    Camera::Canvas operator()(const Camera::Canvas& canvas) const;
+    void read(const QVariant &v);
+
+protected:
+    /// \brief Returns the number of pixels on each side of a pixel that affect the filtered pixel.
+    virtual int radius() const = 0;
+
+    /// \brief Filters a row of \a count pixels.
+    ///
+    /// \a src contains radius() pixels before and after the row, so that \a src[\a x + radius()]
+    /// corresponds to \a dst[\a x].
+    virtual void filterRow(float *dst, const float *src, int count) const = 0;
+
+    /// \brief Filters \a width columns of \a height pixels, rows being \a stride floats apart.
+    ///
+    /// \a src contains radius() rows above and below the columns, so that row \a y of \a dst
+    /// corresponds to row \a y + radius() of \a src.
+    virtual void filterColumns(float *dst, const float *src, int width, int height, int stride) const = 0;
+
+private:
+    Border m_border;
+
+    // Returns the index of the pixel providing the value at index i in a line of n pixels,
+    // or -1 if the value is zero
+    int borderIndex(int i, int n) const;
+};
+
+/// \brief Gaussian blur.
+///
+/// Reads either the standard deviation (in pixels), or a map with properties
+/// \c sigma, \c radius (default is 3*sigma, rounded up), and \c border
+/// (see SeparableImageFilter).
+class GaussianBlurImage : public SeparableImageFilter
+{
+    DECL_GENERATOR(GaussianBlurImage)
+public:
+    GaussianBlurImage();
+    explicit GaussianBlurImage(float sigma, int radius = -1);
+
+    float sigma() const;
+    void read(const QVariant &v);
+
+protected:
+    int radius() const;
+    void filterRow(float *dst, const float *src, int count) const;
+    void filterColumns(float *dst, const float *src, int width, int height, int stride) const;
+
+private:
+    float m_sigma;
+    int m_radius;
+    std::vector<float> m_kernel;
+
+    void setKernel(float sigma, int radius);
+};
+
+/// \brief Box blur computed with running sums, at a cost per pixel not depending on the radius.
+///
+/// Reads either the radius (in pixels), or a map with properties \c radius,
+/// \c passes (default is 1; three passes closely approximate the Gaussian blur),
+/// and \c border (see SeparableImageFilter).
+class BoxBlurImage : public SeparableImageFilter
+{
+    DECL_GENERATOR(BoxBlurImage)
+public:
+    BoxBlurImage();
+    explicit BoxBlurImage(int radius, int passes = 1);
+
+    int passes() const;
+    Camera::Canvas operator()(const Camera::Canvas& canvas) const;
+    void read(const QVariant &v);
+
+protected:
+    int radius() const;
+    void filterRow(float *dst, const float *src, int count) const;
+    void filterColumns(float *dst, const float *src, int width, int height, int stride) const;
+
+private:
+    int m_radius;
+    int m_passes;
+};
+
+} // end namespace raytracer
+
+#endif // IMAGE_FILTER_H
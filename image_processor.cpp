@@ -1,4 +1,10 @@
 #include "image_processor.h"
+#include "image_filter.h"
+#include "worker_pool.h"
+#include "cxx_exception.h"
+
+#include <algorithm>
+#include <limits>
 
 namespace raytracer {
 
@@ -10,6 +16,177 @@ REGISTER_GENERATOR(ClampImage)
 
 REGISTER_GENERATOR(LogScaleImage)
 
+REGISTER_GENERATOR(RelightImage)
+
+REGISTER_GENERATOR(LimitBouncesImage)
+
 REGISTER_GENERATOR(CombinedImageProcessor)
 
+bool ImageProcessor::needsLayers() const
+{
+    return false;
+}
+
+bool ImageProcessor::keepsLayers() const
+{
+    return false;
+}
+
+Camera::Canvas AverageImage::operator()(const Camera::Canvas& canvas) const
+{
+    return BoxBlurImage(1)(canvas);
+}
+
+bool PixelImageProcessor::needsStatistics() const
+{
+    return false;
+}
+
+Camera::Canvas PixelImageProcessor::operator()(const Camera::Canvas& canvas) const
+{
+    return process(canvas, std::vector<const PixelImageProcessor*>(1, this));
+}
+
+Camera::Canvas PixelImageProcessor::process(
+        const Camera::Canvas& canvas,
+        const std::vector<const PixelImageProcessor*>& processors)
+{
+    auto result = Camera::Canvas::uninitialized(canvas.size());
+    const int pixelCount = result.length();
+    const int tileCount = (pixelCount + TilePixelCount - 1) / TilePixelCount;
+    const v3f *src = canvas.data().data();
+    v3f *dst = result.data().data();
+    bool copied = false;
+    std::vector<ImageStatistics> tileStatistics(tileCount);
+    ImageStatistics statistics;
+
+    // Passes over all tiles; each pass copies the input to the result, if not done yet,
+    // applies functions to each tile, and computes statistics of the output if required
+    auto pass = [&](const std::vector<PixelFunction>& functions, bool computeStatistics) {
+        WorkerPool::instance().run(tileCount, [&](int tile) {
+            int first = tile*TilePixelCount;
+            int count = std::min(static_cast<int>(TilePixelCount), pixelCount - first);
+            v3f *pixels = dst + first;
+            if (!copied)
+                std::copy(src + first, src + first + count, pixels);
+            for (const auto& f : functions)
+                f(pixels, count);
+            if (computeStatistics) {
+                auto& s = tileStatistics[tile];
+                s.minValue = std::numeric_limits<float>::max();
+                s.maxValue = -std::numeric_limits<float>::max();
+                for (int i=0; i<count; ++i)
+                    for (int j=0; j<3; ++j) {
+                        s.minValue = std::min(s.minValue, pixels[i][j]);
+                        s.maxValue = std::max(s.maxValue, pixels[i][j]);
+                    }
+            }
+        });
+        copied = true;
+        if (computeStatistics) {
+            statistics.minValue = statistics.maxValue = 0.f;
+            if (tileCount > 0)
+                statistics = tileStatistics[0];
+            for (const auto& s : tileStatistics) {
+                statistics.minValue = std::min(statistics.minValue, s.minValue);
+                statistics.maxValue = std::max(statistics.maxValue, s.maxValue);
+            }
+        }
+    };
+
+    // Each pass runs processors up to the next one needing statistics, which are computed by the pass
+    std::size_t begin = 0;
+    if (processors.empty()   ||   processors[0]->needsStatistics())
+        pass(std::vector<PixelFunction>(), !processors.empty());
+    while (begin < processors.size()) {
+        std::vector<PixelFunction> functions;
+        std::size_t end = begin;
+        do {
+            auto f = processors[end]->pixelFunction(statistics);
+            if (f)
+                functions.push_back(f);
+            ++end;
+        } while (end < processors.size()   &&   !processors[end]->needsStatistics());
+        bool computeStatistics = end < processors.size();
+        if (!functions.empty()   ||   computeStatistics   ||   !copied)
+            pass(functions, computeStatistics);
+        begin = end;
+    }
+    result.copyFeatureBuffers(canvas);
+    return result;
+}
+
+Camera::Canvas CombinedImageProcessor::operator()(const Camera::Canvas& canvas) const
+{
+    std::vector<const ImageProcessor*> stages;
+    appendStages(stages);
+
+    // Intermediate results go to one canvas; successive pixel processors are fused
+    Camera::Canvas result;
+    const Camera::Canvas *current = &canvas;
+    std::vector<const PixelImageProcessor*> pixelStages;
+    auto processPixels = [&]() {
+        if (pixelStages.empty())
+            return;
+        result = PixelImageProcessor::process(*current, pixelStages);
+        current = &result;
+        pixelStages.clear();
+    };
+    for (auto stage : stages) {
+        if (auto pixelStage = dynamic_cast<const PixelImageProcessor*>(stage))
+            pixelStages.push_back(pixelStage);
+        else {
+            processPixels();
+            result = (*stage)(*current);
+            current = &result;
+        }
+    }
+    processPixels();
+    return current == &canvas ?   canvas :   result;
+}
+
+bool CombinedImageProcessor::needsLayers() const
+{
+    for (const auto& proc : m_imageProcessors)
+        if (proc->needsLayers())
+            return true;
+    return false;
+}
+
+bool CombinedImageProcessor::keepsLayers() const
+{
+    for (const auto& proc : m_imageProcessors)
+        if (!proc->keepsLayers())
+            return false;
+    return true;
+}
+
+void CombinedImageProcessor::read(const QVariant &v)
+{
+    readTypedInstances(m_imageProcessors, v);
+
+    // E.g., RelightImage after ClampImage would silently leave the image as it is
+    QVariantList list = v.toList();
+    QString droppedBy;
+    for (std::size_t i=0; i<m_imageProcessors.size(); ++i) {
+        QString type = list[i].toList()[0].toString();
+        if (m_imageProcessors[i]->needsLayers()   &&   !droppedBy.isEmpty())
+            throw cxx::exception(
+                    QString("Image processor %1 needs canvas layers, which are dropped by %2 preceding it")
+                    .arg(type, droppedBy).toStdString());
+        if (!m_imageProcessors[i]->keepsLayers()   &&   droppedBy.isEmpty())
+            droppedBy = type;
+    }
+}
+
+void CombinedImageProcessor::appendStages(std::vector<const ImageProcessor*>& stages) const
+{
+    for (const auto& proc : m_imageProcessors) {
+        if (auto combined = dynamic_cast<const CombinedImageProcessor*>(proc.get()))
+            combined->appendStages(stages);
+        else
+            stages.push_back(proc.get());
+    }
+}
+
 } // end namespace raytracer
@@ -5,6 +5,9 @@
 #include "factory.h"
 #include "serial.h"
 
+#include <map>
+#include <functional>
+
 namespace raytracer {
 
 class ImageProcessor :
@@ -13,6 +16,57 @@ class ImageProcessor :
 {
 public:
     virtual Camera::Canvas operator()(const Camera::Canvas& canvas) const = 0;
+
+    /// \brief Returns true if the processor works on layers or bounce layers
+    /// of the canvas (false by default).
+    virtual bool needsLayers() const;
+
+    /// \brief Returns true if the result keeps layers and bounce layers of the
+    /// canvas (false by default); feature buffers are kept by all processors.
+    ///
+    /// A processor needing layers has no effect after one not keeping them,
+    /// so CombinedImageProcessor::read() rejects such an order.
+    virtual bool keepsLayers() const;
+};
+
+/// \brief Statistics of all color components of an image.
+struct ImageStatistics
+{
+    float minValue;
+    float maxValue;
+};
+
+/// \brief Image processor transforming each pixel independently of other pixels.
+///
+/// Successive pixel processors of a CombinedImageProcessor are fused: the canvas is
+/// split into tiles small enough to stay in the cache, and all processors are applied
+/// to a tile before proceeding to the next one; tiles are processed in parallel
+/// (see WorkerPool). A processor depending on statistics of its input image starts
+/// a new pass over the tiles; the statistics are computed by the previous pass.
+class PixelImageProcessor : public ImageProcessor
+{
+public:
+    /// \brief Function transforming \a count pixels in place.
+    typedef std::function<void(v3f *pixels, int count)> PixelFunction;
+
+    /// \brief Number of pixels in a tile.
+    enum { TilePixelCount = 8192 };
+
+    /// \brief Returns true if pixelFunction() needs statistics of the input image (false by default).
+    virtual bool needsStatistics() const;
+
+    /// \brief Returns the function transforming pixels, or an empty function if pixels are not changed.
+    /// \param inputStatistics Statistics of the input image; only valid if needsStatistics() returns true.
+    virtual PixelFunction pixelFunction(const ImageStatistics& inputStatistics) const = 0;
+
+    Camera::Canvas operator()(const Camera::Canvas& canvas) const;
+
+    /// \brief Applies \a processors to \a canvas, fusing them as described above.
+    ///
+    /// The result has no layers but keeps feature buffers.
+    static Camera::Canvas process(
+            const Camera::Canvas& canvas,
+            const std::vector<const PixelImageProcessor*>& processors);
 };
 
 class IdentityImageProcessor : public ImageProcessor
@@ -22,48 +76,36 @@ public:
     Camera::Canvas operator()(const Camera::Canvas& canvas) const {
         return canvas;
     }
+    bool keepsLayers() const {
+        return true;
+    }
     void read(const QVariant &) {}
 };
 
+/// \brief Averages each pixel with its eight neighbors; same as BoxBlurImage of radius 1
+/// with the default border mode.
 class AverageImage : public ImageProcessor
 {
     DECL_GENERATOR(AverageImage)
 public:
-    Camera::Canvas operator()(const Camera::Canvas& canvas) const
-    {
-        auto size = canvas.size();
-        Camera::Canvas result(canvas.size());
-
-        // Postprocess image
-        v2i xy;
-        for (xy[1]=1; xy[1]+1<size[1]; ++xy[1])
-            for (xy[0]=1; xy[0]+1<size[0]; ++xy[0])
-            {
-                v3f& dst = result[xy];
-                v2i dxy;
-                for (dxy[1]=-1; dxy[1]<2; ++dxy[1])
-                    for (dxy[0]=-1; dxy[0]<2; ++dxy[0])
-                        dst += canvas[xy+dxy];
-            }
-        return result;
-    }
+    Camera::Canvas operator()(const Camera::Canvas& canvas) const;
     void read(const QVariant &) {}
 };
 
-class ClampImage : public ImageProcessor
+class ClampImage : public PixelImageProcessor
 {
     DECL_GENERATOR(ClampImage)
 public:
     ClampImage() : m_clampValue(1.f) {}
     explicit ClampImage(float clampValue) : m_clampValue(clampValue) {}
-    Camera::Canvas operator()(const Camera::Canvas& canvas) const
+    PixelFunction pixelFunction(const ImageStatistics&) const
     {
-        Camera::Canvas result = canvas;
-        for (v3f& pixel : result)
-            for (int i=0; i<3; ++i)
-                if (pixel[i] > m_clampValue)
-                    pixel[i] = m_clampValue;
-        return result;
+        float clampValue = m_clampValue;
+        return [clampValue](v3f *pixels, int count) {
+            for (int i=0; i<count; ++i)
+                for (int j=0; j<3; ++j)
+                    pixels[i][j] = std::min(pixels[i][j], clampValue);
+        };
     }
     void read(const QVariant &v) {
         m_clampValue = fromVariant<float>(v);
@@ -73,39 +115,105 @@ private:
     float m_clampValue;
 };
 
-class LogScaleImage : public ImageProcessor
+class LogScaleImage : public PixelImageProcessor
 {
     DECL_GENERATOR(LogScaleImage)
 public:
     LogScaleImage() : m_threshold(0.1f) {}
     explicit LogScaleImage(float threshold) : m_threshold(threshold) {}
+    bool needsStatistics() const {
+        return isEnabled();
+    }
+    PixelFunction pixelFunction(const ImageStatistics& inputStatistics) const
+    {
+        if (!isEnabled())
+            return PixelFunction();
+        float scale = inputStatistics.maxValue > 0.f ?   1.f / (inputStatistics.maxValue*m_threshold) :   0.f;
+        return [scale](v3f *pixels, int count) {
+            for (int i=0; i<count; ++i)
+                for (int j=0; j<3; ++j) {
+                    // Values not exceeding the threshold (relative to the maximum) become zero
+                    float v = pixels[i][j]*scale;
+                    pixels[i][j] = v <= 1.f ?   0.f :   std::log(v);
+                }
+        };
+    }
+    void read(const QVariant &v) {
+        m_threshold = fromVariant<float>(v);
+    }
+
+private:
+    float m_threshold;
+
+    bool isEnabled() const {
+        return m_threshold > 0.f   &&   m_threshold <= 1.f;
+    }
+};
+
+/// \brief Recombines canvas layers of light groups with new weights (see Camera::Canvas::relight()).
+///
+/// Weights are specified by group name, either as a number or as a color;
+/// groups not mentioned keep weight one. Canvases without layers are not changed.
+class RelightImage : public ImageProcessor
+{
+    DECL_GENERATOR(RelightImage)
+public:
+    RelightImage& setWeight(const QString& group, const v3f& weight) {
+        m_weights[group] = weight;
+        return *this;
+    }
     Camera::Canvas operator()(const Camera::Canvas& canvas) const
     {
-        if (m_threshold <= 0.f || m_threshold > 1.f)
+        if (canvas.layerCount() == 0)
             return canvas;
-        float maxValue = 0.f;
-        for (const v3f& pixel : canvas)
-            for (int i=0; i<3; ++i)
-                if (maxValue < pixel[i])
-                    maxValue = pixel[i];
-        Camera::Canvas result = canvas;
-        for (v3f& pixel : result)
-            for (int i=0; i<3; ++i) {
-                float& v = pixel[i];
-                v /= maxValue;
-                if (v <= m_threshold)
-                    v = 0.f;
-                else
-                    v = log(v/m_threshold);
+        std::vector<v3f> weights(canvas.layerCount(), mkv3f(1.f, 1.f, 1.f));
+        for (int i=0; i<canvas.layerCount(); ++i) {
+            auto it = m_weights.find(canvas.layerNames()[i]);
+            if (it != m_weights.end())
+                weights[i] = it->second;
+        }
+        return canvas.relight(weights);
+    }
+    bool needsLayers() const {
+        return true;
+    }
+    void read(const QVariant &v) {
+        m_weights.clear();
+        QVariantMap m = safeVariantMap(v);
+        for (auto it=m.begin(); it!=m.end(); ++it) {
+            if (it.value().type() == QVariant::List)
+                m_weights[it.key()] = fromVariant<v3f>(it.value());
+            else {
+                float w = fromVariant<float>(it.value());
+                m_weights[it.key()] = mkv3f(w, w, w);
             }
-        return result;
+        }
+    }
+
+private:
+    std::map<QString, v3f> m_weights;
+};
+
+/// \brief Removes contributions of rays reflected more times than specified
+/// (see Camera::Canvas::limitBounces()).
+class LimitBouncesImage : public ImageProcessor
+{
+    DECL_GENERATOR(LimitBouncesImage)
+public:
+    LimitBouncesImage() : m_maxReflections(0) {}
+    explicit LimitBouncesImage(int maxReflections) : m_maxReflections(maxReflections) {}
+    Camera::Canvas operator()(const Camera::Canvas& canvas) const {
+        return canvas.limitBounces(m_maxReflections);
+    }
+    bool needsLayers() const {
+        return true;
     }
     void read(const QVariant &v) {
-        m_threshold = fromVariant<float>(v);
+        m_maxReflections = fromVariant<int>(v);
     }
 
 private:
-    float m_threshold;
+    int m_maxReflections;
 };
 
 class CombinedImageProcessor : public ImageProcessor
@@ -119,18 +227,23 @@ public:
     CombinedImageProcessor& operator<<(const ImageProcessor::Ptr proc) {
         return addImageProcessor(proc);
     }
-    Camera::Canvas operator()(const Camera::Canvas& canvas) const {
-        Camera::Canvas result = canvas;
-        for (ImageProcessor::Ptr proc : m_imageProcessors)
-            result = (*proc)(result);
-        return result;
-    }
-    void read(const QVariant &v) {
-        readTypedInstances(m_imageProcessors, v);
-    }
+
+    /// \brief Applies all image processors in turn; successive pixel processors are fused
+    /// (see PixelImageProcessor).
+    Camera::Canvas operator()(const Camera::Canvas& canvas) const;
+
+    bool needsLayers() const;
+    bool keepsLayers() const;
+
+    /// \brief Reads image processors; throws an exception if a processor needing layers
+    /// follows one not keeping them (see ImageProcessor::keepsLayers()).
+    void read(const QVariant &v);
 
 private:
     std::vector<ImageProcessor::Ptr> m_imageProcessors;
+
+    // Appends image processors to stages, replacing nested combined processors with their contents
+    void appendStages(std::vector<const ImageProcessor*>& stages) const;
 };
 
 } // end namespace raytracer
@@ -73,6 +73,72 @@ bool LogScaleImageImageAction::isCustomChecked() {
 
 
 
+MaxReflectionsAction::MaxReflectionsAction(QObject *parent) :
+    QWidgetAction(parent)
+{
+    QWidget *widget = new QWidget;
+    auto layout = new QHBoxLayout(widget);
+    layout->addWidget(m_check = new QCheckBox);
+    auto label = new QLabel(tr("&Max reflections"));
+    layout->addWidget(label);
+    layout->addWidget(m_maxReflections = new QSpinBox);
+    label->setBuddy(m_maxReflections);
+    m_maxReflections->setMinimum(0);
+    m_maxReflections->setMaximum(0);
+    setDefaultWidget(widget);
+    setCheckable(true);
+    connect(m_check, SIGNAL(toggled(bool)), SIGNAL(customToggled(bool)));
+    connect(m_maxReflections, SIGNAL(valueChanged(int)), SIGNAL(valueChanged()));
+}
+
+int MaxReflectionsAction::maxReflections() const
+{
+    return m_maxReflections->value();
+}
+
+void MaxReflectionsAction::setMaxReflectionsLimit(int limit)
+{
+    m_maxReflections->setMaximum(limit);
+    m_maxReflections->setValue(limit);
+}
+
+bool MaxReflectionsAction::isCustomChecked() {
+    return m_check->isChecked();
+}
+
+
+
+LightWeightAction::LightWeightAction(const QString& group, QObject *parent) :
+    QWidgetAction(parent),
+    m_group(group)
+{
+    QWidget *widget = new QWidget;
+    auto layout = new QHBoxLayout(widget);
+    auto label = new QLabel(group);
+    layout->addWidget(label);
+    layout->addWidget(m_weight = new QDoubleSpinBox);
+    label->setBuddy(m_weight);
+    m_weight->setMinimum(0);
+    m_weight->setMaximum(1000);
+    m_weight->setSingleStep(0.1);
+    m_weight->setDecimals(3);
+    m_weight->setValue(1);
+    setDefaultWidget(widget);
+    connect(m_weight, SIGNAL(valueChanged(double)), SIGNAL(valueChanged()));
+}
+
+QString LightWeightAction::group() const
+{
+    return m_group;
+}
+
+float LightWeightAction::weight() const
+{
+    return static_cast<float>(m_weight->value());
+}
+
+
+
 ImageProcessorController::ImageProcessorController(QObject *parent) :
     QObject(parent),
     m_sceneImageProcessor(new IdentityImageProcessor),
@@ -94,12 +160,23 @@ ImageProcessorController::ImageProcessorController(QObject *parent) :
     m_actionLogScale = new LogScaleImageImageAction(this);
     m_menu->addAction(m_actionLogScale);
 
+    m_menu->addSeparator();
+
+    m_actionMaxReflections = new MaxReflectionsAction(this);
+    m_menu->addAction(m_actionMaxReflections);
+    m_actionMaxReflections->setEnabled(false);
+
+    m_lightsMenu = m_menu->addMenu(tr("Light &weights"));
+    m_lightsMenu->setEnabled(false);
+
     connect(m_actionSceneImgProc, SIGNAL(toggled(bool)), SLOT(changeImageProcessor()));
     connect(m_actionClampImage, SIGNAL(customToggled(bool)), SLOT(changeImageProcessor()));
     connect(m_actionClampImage, SIGNAL(valueChanged()), SLOT(changeImageProcessor()));
     connect(m_actionAverage, SIGNAL(toggled(bool)), SLOT(changeImageProcessor()));
     connect(m_actionLogScale, SIGNAL(customToggled(bool)), SLOT(changeImageProcessor()));
     connect(m_actionLogScale, SIGNAL(valueChanged()), SLOT(changeImageProcessor()));
+    connect(m_actionMaxReflections, SIGNAL(customToggled(bool)), SLOT(changeImageProcessor()));
+    connect(m_actionMaxReflections, SIGNAL(valueChanged()), SLOT(changeImageProcessor()));
     updateActions();
 }
 
@@ -123,15 +200,36 @@ void ImageProcessorController::setSceneImageProcessor(ImageProcessor::Ptr sceneI
     m_sceneImageProcessor = sceneImageProcessor;
 }
 
+void ImageProcessorController::setLightGroups(const QStringList& groups)
+{
+    for (auto action : m_lightWeightActions)
+        delete action;
+    m_lightWeightActions.clear();
+    foreach (const QString& group, groups) {
+        auto action = new LightWeightAction(group, this);
+        m_lightsMenu->addAction(action);
+        m_lightWeightActions.push_back(action);
+        connect(action, SIGNAL(valueChanged()), SLOT(changeImageProcessor()));
+    }
+    m_lightsMenu->setEnabled(!groups.isEmpty());
+}
+
+void ImageProcessorController::setBounceLayerCount(int count)
+{
+    m_actionMaxReflections->setMaxReflectionsLimit(count);
+    m_actionMaxReflections->setEnabled(count > 0);
+}
+
 void ImageProcessorController::changeImageProcessor()
 {
     updateActions();
+    ImageProcessor::Ptr imageProcessor;
     if (m_actionSceneImgProc->isChecked())
-        m_imageProcessor = m_sceneImageProcessor;
+        imageProcessor = m_sceneImageProcessor;
     else
     {
         auto cip = std::make_shared<CombinedImageProcessor>();
-        m_imageProcessor = cip;
+        imageProcessor = cip;
         if (m_actionClampImage->isCustomChecked())
             *cip << std::make_shared<ClampImage>(static_cast<float>(m_actionClampImage->clampValue()));
         if (m_actionAverage->isChecked())
@@ -139,6 +237,30 @@ void ImageProcessorController::changeImageProcessor()
         if (m_actionLogScale->isCustomChecked())
             *cip << std::make_shared<LogScaleImage>(m_actionLogScale->threshold());
     }
+
+    // Recombine light groups first, if any weight is changed
+    auto relight = std::make_shared<RelightImage>();
+    bool relightNeeded = false;
+    for (auto action : m_lightWeightActions) {
+        float w = action->weight();
+        relight->setWeight(action->group(), mkv3f(w, w, w));
+        if (w != 1.f)
+            relightNeeded = true;
+    }
+    if (relightNeeded) {
+        auto cip = std::make_shared<CombinedImageProcessor>();
+        *cip << relight << imageProcessor;
+        imageProcessor = cip;
+    }
+
+    // Lower the reflection limit before anything else
+    if (m_actionMaxReflections->isEnabled()   &&   m_actionMaxReflections->isCustomChecked()) {
+        auto cip = std::make_shared<CombinedImageProcessor>();
+        *cip << std::make_shared<LimitBouncesImage>(m_actionMaxReflections->maxReflections()) << imageProcessor;
+        imageProcessor = cip;
+    }
+
+    m_imageProcessor = imageProcessor;
     emit imageProcessorChanged(m_imageProcessor);
 }
 
@@ -56,6 +56,44 @@ private:
 
 
 
+class MaxReflectionsAction : public QWidgetAction
+{
+    Q_OBJECT
+public:
+    explicit MaxReflectionsAction(QObject *parent = nullptr);
+    int maxReflections() const;
+    void setMaxReflectionsLimit(int limit);
+    bool isCustomChecked();
+
+signals:
+    void valueChanged();
+    bool customToggled(bool);
+
+private:
+    QCheckBox *m_check;
+    QSpinBox *m_maxReflections;
+};
+
+
+
+class LightWeightAction : public QWidgetAction
+{
+    Q_OBJECT
+public:
+    LightWeightAction(const QString& group, QObject *parent = nullptr);
+    QString group() const;
+    float weight() const;
+
+signals:
+    void valueChanged();
+
+private:
+    QString m_group;
+    QDoubleSpinBox *m_weight;
+};
+
+
+
 class ImageProcessorController : public QObject
 {
     Q_OBJECT
@@ -71,6 +109,18 @@ signals:
 public slots:
     void setSceneImageProcessor(raytracer::ImageProcessor::Ptr sceneImageProcessor);
 
+    /// \brief Creates weight controls for light groups (see RayTracer::lightGroups()).
+    ///
+    /// Weights other than one make the image processor recombine the canvas layers
+    /// of light groups (see RelightImage) before any other processing.
+    void setLightGroups(const QStringList& groups);
+
+    /// \brief Sets the number of bounce layers of canvases (see Camera::Canvas::bounceLayerCount()).
+    ///
+    /// If it is positive, the reflection limit can be lowered for preview (see LimitBouncesImage);
+    /// this is done before any other processing.
+    void setBounceLayerCount(int count);
+
 private slots:
     void changeImageProcessor();
 
@@ -82,6 +132,9 @@ private:
     QAction *m_actionAverage;
     ClampImageAction *m_actionClampImage;
     LogScaleImageImageAction *m_actionLogScale;
+    MaxReflectionsAction *m_actionMaxReflections;
+    QMenu *m_lightsMenu;
+    std::vector<LightWeightAction*> m_lightWeightActions;
 
     void updateActions();
 };
@@ -0,0 +1,202 @@
+/// \file
+/// \brief Implementation of the LensPolynomial class.
+
+#include "lens_polynomial.h"
+#include "lens_prescription.h"
+#include "cxx_exception.h"
+
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+namespace raytracer {
+
+namespace {
+
+// Solves the system with symmetric positive definite n x n matrix a and
+// n x m right hand side b by Cholesky decomposition; the solution overwrites b.
+void solveSpd(std::vector<double>& a, std::vector<double>& b, int n, int m)
+{
+    for (int j=0; j<n; ++j) {
+        double d = a[j*n+j];
+        for (int k=0; k<j; ++k)
+            d -= a[j*n+k]*a[j*n+k];
+        if (d <= 0)
+            throw cxx::exception("Failed to fit lens polynomial: singular system");
+        d = std::sqrt(d);
+        a[j*n+j] = d;
+        for (int i=j+1; i<n; ++i) {
+            double s = a[i*n+j];
+            for (int k=0; k<j; ++k)
+                s -= a[i*n+k]*a[j*n+k];
+            a[i*n+j] = s / d;
+        }
+    }
+    for (int c=0; c<m; ++c) {
+        for (int i=0; i<n; ++i) {
+            double s = b[i*m+c];
+            for (int k=0; k<i; ++k)
+                s -= a[i*n+k]*b[k*m+c];
+            b[i*m+c] = s / a[i*n+i];
+        }
+        for (int i=n-1; i>=0; --i) {
+            double s = b[i*m+c];
+            for (int k=i+1; k<n; ++k)
+                s -= a[k*n+i]*b[k*m+c];
+            b[i*m+c] = s / a[i*n+i];
+        }
+    }
+}
+
+} // anonymous namespace
+
+LensPolynomial::LensPolynomial() :
+    m_degree(0),
+    m_invAperture(0.f),
+    m_invMaxTangent(0.f),
+    m_stopAperture2(0.f),
+    m_sensorError(0),
+    m_maxSensorError(0)
+{
+}
+
+void LensPolynomial::fit(
+        const LensPrescription& lens,
+        double sensorDistance,
+        double maxTangent,
+        int degree,
+        int sampleCount)
+{
+    Q_ASSERT(degree >= 1   &&   degree <= MaxDegree);
+    Q_ASSERT(maxTangent > 0);
+
+    m_degree = degree;
+    m_terms.clear();
+    for (int total=0; total<=degree; ++total)
+        for (int a=total; a>=0; --a)
+            for (int b=total-a; b>=0; --b)
+                for (int c=total-a-b; c>=0; --c) {
+                    Term t = {{
+                        static_cast<unsigned char>(a),
+                        static_cast<unsigned char>(b),
+                        static_cast<unsigned char>(c),
+                        static_cast<unsigned char>(total-a-b-c) }, 0, 0 };
+                    if (total > 0) {
+                        // Find the parent term, having the first nonzero exponent decremented
+                        while (t.exponents[t.input] == 0)
+                            ++t.input;
+                        Term p = t;
+                        --p.exponents[t.input];
+                        auto it = std::find_if(m_terms.begin(), m_terms.end(), [&p](const Term& x) {
+                            return std::equal(x.exponents, x.exponents+4, p.exponents);
+                        });
+                        Q_ASSERT(it != m_terms.end());
+                        t.parent = static_cast<short>(it - m_terms.begin());
+                    }
+                    m_terms.push_back(t);
+                }
+    int n = m_terms.size();
+    Q_ASSERT(n <= MaxTermCount);
+
+    double aperture = lens.entranceAperture();
+    double stopAperture = lens.surfaces()[lens.stopIndex()].aperture;
+    double zSensor = lens.lastVertex() + sensorDistance;
+    m_invAperture = static_cast<float>(1 / aperture);
+    m_invMaxTangent = static_cast<float>(1 / maxTangent);
+    m_stopAperture2 = static_cast<float>(stopAperture*stopAperture);
+
+    // Sample rays uniformly over the input domain (unit disks in normalized position and tangents),
+    // trace them through the lens with enlarged apertures, and accumulate normal equations
+    std::mt19937 gen;
+    std::uniform_real_distribution<double> dis(-1, 1);
+    auto diskPoint = [&](double& x, double& y) {
+        do {
+            x = dis(gen);
+            y = dis(gen);
+        }
+        while (x*x + y*y > 1);
+    };
+    std::vector<double> ata(n*n, 0.), atb(n*4, 0.);
+    std::vector<double> inputs, outputs, m(n);
+    auto monomials = [&](const double *u) {
+        m[0] = 1;
+        for (int k=1; k<n; ++k)
+            m[k] = m[m_terms[k].parent] * u[m_terms[k].input];
+    };
+    for (int isample=0; isample<sampleCount; ++isample) {
+        double u[4];
+        diskPoint(u[0], u[1]);
+        diskPoint(u[2], u[3]);
+        LensPrescription::TraceRay ray;
+        ray.pos[0] = u[0]*aperture;
+        ray.pos[1] = u[1]*aperture;
+        ray.pos[2] = 0;
+        double tx = u[2]*maxTangent, ty = u[3]*maxTangent, l = std::sqrt(1 + tx*tx + ty*ty);
+        ray.dir[0] = tx / l;
+        ray.dir[1] = ty / l;
+        ray.dir[2] = 1 / l;
+        double y[4];
+        if (!lens.trace(ray, FitApertureScale, y+2)   ||   ray.dir[2] <= 0)
+            continue;
+        double t = (zSensor - ray.pos[2]) / ray.dir[2];
+        y[0] = ray.pos[0] + t*ray.dir[0];
+        y[1] = ray.pos[1] + t*ray.dir[1];
+
+        monomials(u);
+        for (int i=0; i<n; ++i) {
+            for (int j=0; j<=i; ++j)
+                ata[i*n+j] += m[i]*m[j];
+            for (int k=0; k<4; ++k)
+                atb[i*4+k] += m[i]*y[k];
+        }
+        inputs.insert(inputs.end(), u, u+4);
+        outputs.insert(outputs.end(), y, y+2);
+    }
+    int fittedCount = outputs.size() / 2;
+    if (fittedCount < 4*n)
+        throw cxx::exception("Failed to fit lens polynomial: too few rays pass the lens");
+    for (int i=0; i<n; ++i)
+        for (int j=0; j<i; ++j)
+            ata[j*n+i] = ata[i*n+j];
+    solveSpd(ata, atb, n, 4);
+    m_coeffs.resize(atb.size());
+    std::transform(atb.begin(), atb.end(), m_coeffs.begin(), [](double x) { return static_cast<float>(x); });
+
+    // Measure fit error
+    double sum2 = 0;
+    m_maxSensorError = 0;
+    for (int isample=0; isample<fittedCount; ++isample) {
+        monomials(&inputs[isample*4]);
+        double r[2] = { 0, 0 };
+        for (int k=0; k<n; ++k)
+            for (int i=0; i<2; ++i)
+                r[i] += m[k]*atb[k*4+i];
+        double dx = r[0] - outputs[isample*2], dy = r[1] - outputs[isample*2+1];
+        double e2 = dx*dx + dy*dy;
+        sum2 += e2;
+        m_maxSensorError = std::max(m_maxSensorError, std::sqrt(e2));
+    }
+    m_sensorError = std::sqrt(sum2 / fittedCount);
+}
+
+int LensPolynomial::degree() const
+{
+    return m_degree;
+}
+
+int LensPolynomial::termCount() const
+{
+    return m_terms.size();
+}
+
+double LensPolynomial::sensorError() const
+{
+    return m_sensorError;
+}
+
+double LensPolynomial::maxSensorError() const
+{
+    return m_maxSensorError;
+}
+
+} // end namespace raytracer
@@ -0,0 +1,104 @@
+/// \file
+/// \brief Declaration of the LensPolynomial class.
+
+#ifndef LENS_POLYNOMIAL_H
+#define LENS_POLYNOMIAL_H
+
+#include "common.h"
+
+#include <vector>
+
+namespace raytracer {
+
+class LensPrescription;
+
+/// \brief Polynomial approximation of the mapping performed by a lens.
+///
+/// Maps ray position (x, y) on the entrance plane (the plane z = 0 of the lens, see LensPrescription)
+/// and ray direction tangents (dx/dz, dy/dz) to ray position on the sensor and at the aperture stop.
+/// Each output is a polynomial of given total degree in the four inputs, fitted by least squares
+/// to rays traced exactly through the lens. Rays are vignetted by the aperture stop only;
+/// the fit uses rays passing all surfaces with apertures enlarged by FitApertureScale,
+/// so that the stop position is also accurate just outside the stop.
+class LensPolynomial
+{
+public:
+    static const int DefaultDegree = 3;
+    static const int MaxDegree = 7;
+    static const int MaxTermCount = 330;   // Number of monomials of degree MaxDegree in 4 variables
+    static const int DefaultSampleCount = 20000;
+    static constexpr double FitApertureScale = 1.25;
+
+    LensPolynomial();
+
+    /// \brief Fits the polynomials.
+    ///
+    /// \param lens The lens.
+    /// \param sensorDistance Distance from the last lens vertex to the sensor.
+    /// \param maxTangent Maximum tangent of the angle between incoming rays and lens axis.
+    /// \param degree Total degree of the polynomials.
+    /// \param sampleCount Number of rays sampled for the fit.
+    void fit(
+            const LensPrescription& lens,
+            double sensorDistance,
+            double maxTangent,
+            int degree = DefaultDegree,
+            int sampleCount = DefaultSampleCount);
+
+    /// \brief Maps ray with position \a x, \a y on the entrance plane and direction tangents
+    /// \a tx, \a ty to the sensor position \a sensorPos.
+    ///
+    /// \return False if the ray is outside the domain of the fit or is blocked by the aperture stop.
+    bool map(float x, float y, float tx, float ty, v2f& sensorPos) const
+    {
+        float u[4] = { x*m_invAperture, y*m_invAperture, tx*m_invMaxTangent, ty*m_invMaxTangent };
+        if (u[0]*u[0] + u[1]*u[1] > 1.f   ||   u[2]*u[2] + u[3]*u[3] > 1.f)
+            return false;
+
+        // Each monomial is its parent monomial times one of the inputs
+        float m[MaxTermCount];
+        m[0] = 1.f;
+        const float *c = m_coeffs.data();
+        float r[4] = { c[0], c[1], c[2], c[3] };
+        for (int k=1, n=m_terms.size(); k<n; ++k) {
+            const Term& t = m_terms[k];
+            m[k] = m[t.parent] * u[t.input];
+            c += 4;
+            for (int i=0; i<4; ++i)
+                r[i] += m[k] * c[i];
+        }
+        if (r[2]*r[2] + r[3]*r[3] > m_stopAperture2)
+            return false;
+        sensorPos = mkv2f(r[0], r[1]);
+        return true;
+    }
+
+    int degree() const;
+    int termCount() const;
+
+    /// \brief Returns root mean square error of the sensor position over the fitted rays.
+    double sensorError() const;
+
+    /// \brief Returns maximum error of the sensor position over the fitted rays.
+    double maxSensorError() const;
+
+private:
+    struct Term {
+        unsigned char exponents[4];
+        short parent;   // Index of the term whose monomial times the input gives this one
+        short input;
+    };
+
+    int m_degree;
+    std::vector<Term> m_terms;
+    std::vector<float> m_coeffs;    // 4 values (sensor x, y, stop x, y) per term
+    float m_invAperture;
+    float m_invMaxTangent;
+    float m_stopAperture2;
+    double m_sensorError;
+    double m_maxSensorError;
+};
+
+} // end namespace raytracer
+
+#endif // LENS_POLYNOMIAL_H
@@ -0,0 +1,181 @@
+/// \file
+/// \brief Implementation of the LensPrescription class.
+
+#include "lens_prescription.h"
+#include "cxx_exception.h"
+
+#include <cmath>
+
+namespace raytracer {
+
+LensPrescription::LensPrescription() :
+    m_stopIndex(-1)
+{
+}
+
+const std::vector<LensPrescription::Surface>& LensPrescription::surfaces() const
+{
+    return m_surfaces;
+}
+
+void LensPrescription::setSurfaces(const std::vector<Surface>& surfaces, int stopIndex)
+{
+    if (surfaces.empty())
+        throw cxx::exception("Lens prescription contains no surfaces");
+    m_surfaces = surfaces;
+    if (stopIndex < 0) {
+        stopIndex = 0;
+        for (int i=1, n=m_surfaces.size(); i<n; ++i)
+            if (m_surfaces[i].aperture < m_surfaces[stopIndex].aperture)
+                stopIndex = i;
+    }
+    Q_ASSERT(stopIndex < static_cast<int>(m_surfaces.size()));
+    m_stopIndex = stopIndex;
+}
+
+int LensPrescription::stopIndex() const
+{
+    return m_stopIndex;
+}
+
+double LensPrescription::entranceAperture() const
+{
+    Q_ASSERT(!m_surfaces.empty());
+    return m_surfaces.front().aperture;
+}
+
+double LensPrescription::backDistance() const
+{
+    Q_ASSERT(!m_surfaces.empty());
+    return m_surfaces.back().thickness;
+}
+
+double LensPrescription::lastVertex() const
+{
+    double z = 0;
+    for (int i=0, n=m_surfaces.size(); i+1<n; ++i)
+        z += m_surfaces[i].thickness;
+    return z;
+}
+
+bool LensPrescription::trace(TraceRay& ray, double apertureScale, double *stopPos) const
+{
+    double *p = ray.pos;
+    double *d = ray.dir;
+    double zVertex = 0;
+    double ior = 1;
+    for (int is=0, ns=m_surfaces.size(); is<ns; ++is) {
+        const Surface& s = m_surfaces[is];
+
+        // Find intersection and the normal facing the incoming light
+        double n[3];
+        if (s.radius == 0) {
+            double t = (zVertex - p[2]) / d[2];
+            for (int i=0; i<3; ++i)
+                p[i] += t*d[i];
+            n[0] = n[1] = 0;
+            n[2] = -1;
+        }
+        else {
+            double oc[3] = { p[0], p[1], p[2] - zVertex - s.radius };
+            double b = oc[0]*d[0] + oc[1]*d[1] + oc[2]*d[2];
+            double c = oc[0]*oc[0] + oc[1]*oc[1] + oc[2]*oc[2] - s.radius*s.radius;
+            double disc = b*b - c;
+            if (disc < 0)
+                return false;
+            double t = s.radius > 0 ?   -b - std::sqrt(disc) :   -b + std::sqrt(disc);
+            for (int i=0; i<3; ++i) {
+                p[i] += t*d[i];
+                n[i] = (oc[i] + t*d[i]) / s.radius;
+            }
+        }
+
+        if (apertureScale > 0) {
+            double a = s.aperture*apertureScale;
+            if (p[0]*p[0] + p[1]*p[1] > a*a)
+                return false;
+        }
+        if (stopPos   &&   is == m_stopIndex) {
+            stopPos[0] = p[0];
+            stopPos[1] = p[1];
+        }
+
+        // Refract (Snell's law in vector form)
+        double eta = ior / s.ior;
+        double cosi = -(n[0]*d[0] + n[1]*d[1] + n[2]*d[2]);
+        if (cosi < 0) {
+            for (int i=0; i<3; ++i)
+                n[i] = -n[i];
+            cosi = -cosi;
+        }
+        double k = 1 - eta*eta*(1 - cosi*cosi);
+        if (k < 0)
+            return false;
+        double f = eta*cosi - std::sqrt(k);
+        for (int i=0; i<3; ++i)
+            d[i] = eta*d[i] + f*n[i];
+
+        ior = s.ior;
+        zVertex += s.thickness;
+    }
+    return true;
+}
+
+bool LensPrescription::paraxialRay(TraceRay& ray, double objectDistance) const
+{
+    double h = 1e-4*entranceAperture();
+    ray.pos[0] = h;
+    ray.pos[1] = ray.pos[2] = 0;
+    double dz = objectDistance > 0 ?   objectDistance :   1;
+    double dx = objectDistance > 0 ?   h :   0;
+    double l = std::sqrt(dx*dx + dz*dz);
+    ray.dir[0] = dx / l;
+    ray.dir[1] = 0;
+    ray.dir[2] = dz / l;
+    return trace(ray, 0);
+}
+
+double LensPrescription::focalLength() const
+{
+    TraceRay ray;
+    if (!paraxialRay(ray, 0)   ||   ray.dir[0] == 0)
+        throw cxx::exception("Failed to compute lens focal length");
+    return -1e-4*entranceAperture()*ray.dir[2]/ray.dir[0];
+}
+
+double LensPrescription::imageDistance(double objectDistance) const
+{
+    TraceRay ray;
+    if (!paraxialRay(ray, objectDistance)   ||   ray.dir[0] == 0)
+        throw cxx::exception("Failed to compute lens image distance");
+    double t = -ray.pos[0] / ray.dir[0];
+    return ray.pos[2] + t*ray.dir[2] - lastVertex();
+}
+
+void LensPrescription::read(const QVariant &v)
+{
+    float scale = 1;
+    readOptionalProperty(scale, v, "scale");
+
+    std::vector<Surface> surfaces;
+    int stopIndex = -1;
+    readProperty(v, "surfaces", [&](const QVariant& v) {
+        Q_ASSERT(v.type() == QVariant::List);
+        for (auto& item : v.toList()) {
+            QVariantMap m = safeVariantMap(item);
+            float radius = 0, thickness, ior = 1, aperture = 1;
+            bool stop = false;
+            readOptionalProperty(radius, m, "radius");
+            readProperty(thickness, m, "thickness");
+            readOptionalProperty(ior, m, "ior");
+            readOptionalProperty(aperture, m, "aperture");
+            readOptionalProperty(stop, m, "stop");
+            if (stop)
+                stopIndex = surfaces.size();
+            surfaces.push_back(Surface(radius*scale, thickness*scale, ior, aperture*scale));
+        }
+    });
+    setSurfaces(surfaces, stopIndex);
+}
+
+} // end namespace raytracer
@@ -0,0 +1,101 @@
+/// \file
+/// \brief Declaration of the LensPrescription class.
+
+#ifndef LENS_PRESCRIPTION_H
+#define LENS_PRESCRIPTION_H
+
+#include "serial.h"
+
+#include <vector>
+
+namespace raytracer {
+
+/// \brief Multi-element rotationally symmetric lens, described by a list of spherical surfaces.
+///
+/// The lens axis is the z axis; light travels in the positive z direction.
+/// The vertex of the first surface is at z = 0, and each surface is followed
+/// by a medium of given thickness and refractive index. The thickness after the last surface
+/// is the default distance to the sensor.
+///
+/// Surface radius is positive when the center of curvature lies after the vertex (i.e., at
+/// greater z); zero radius stands for a plane surface.
+/// Rays are traced sequentially through the surfaces in double precision; this is exact but
+/// slow and is meant for fitting approximations, see LensPolynomial.
+class LensPrescription : public Readable
+{
+public:
+    struct Surface
+    {
+        double radius;      ///< \brief Radius of curvature, zero for a plane.
+        double thickness;   ///< \brief Distance to the vertex of the next surface (or to the sensor).
+        double ior;         ///< \brief Refractive index of the medium after the surface.
+        double aperture;    ///< \brief Semi-diameter of the surface.
+
+        Surface() : radius(0), thickness(0), ior(1), aperture(1) {}
+        Surface(double radius, double thickness, double ior, double aperture) :
+            radius(radius), thickness(thickness), ior(ior), aperture(aperture)
+        {}
+    };
+
+    /// \brief Ray traced through the lens.
+    struct TraceRay
+    {
+        double pos[3];
+        double dir[3];  ///< \brief Unit direction vector.
+    };
+
+    LensPrescription();
+
+    const std::vector<Surface>& surfaces() const;
+    void setSurfaces(const std::vector<Surface>& surfaces, int stopIndex = -1);
+
+    /// \brief Returns index of the aperture stop surface.
+    ///
+    /// Unless specified explicitly, it is the surface of smallest aperture.
+    int stopIndex() const;
+
+    /// \brief Returns semi-diameter of the first surface.
+    double entranceAperture() const;
+
+    /// \brief Returns the thickness after the last surface.
+    double backDistance() const;
+
+    /// \brief Returns z coordinate of the vertex of the last surface.
+    double lastVertex() const;
+
+    /// \brief Traces a ray through all surfaces.
+    ///
+    /// \param ray Ray to be traced; on return, contains the ray after the last surface.
+    /// \param apertureScale Factor applied to surface apertures when checking whether
+    /// the ray passes them; zero disables the checks.
+    /// \param stopPos If not null, receives x and y coordinates of the ray at the stop surface.
+    /// \return True if the ray passes the lens, false if it misses a surface, is totally
+    /// internally reflected, or is rejected by an aperture.
+    bool trace(TraceRay& ray, double apertureScale = 1, double *stopPos = nullptr) const;
+
+    /// \brief Returns effective focal length, computed by tracing a paraxial ray.
+    double focalLength() const;
+
+    /// \brief Returns the distance from the last vertex to the image of an axial point.
+    ///
+    /// \param objectDistance Distance from the first vertex to the object point
+    /// in front of the lens; zero or negative value means infinity.
+    double imageDistance(double objectDistance) const;
+
+    /// \brief Reads surfaces.
+    ///
+    /// The expected format is
+    /// <tt>{ surfaces: [{radius: R, thickness: t, ior: n, aperture: a, stop: true}, ...], scale: s }</tt>;
+    /// only \c thickness is mandatory in a surface. All lengths are multiplied by \c scale (default 1).
+    void read(const QVariant &v);
+
+private:
+    std::vector<Surface> m_surfaces;
+    int m_stopIndex;
+
+    bool paraxialRay(TraceRay& ray, double objectDistance) const;
+};
+
+} // end namespace raytracer
+
+#endif // LENS_PRESCRIPTION_H
@@ -3,6 +3,8 @@
 
 #include "light_source.h"
 #include "transform.h"
+#include "ray_tracer.h"
+#include "ray_batch.h"
 
 namespace raytracer {
 
@@ -11,6 +13,24 @@ LightSource::LightSource() :
 {
 }
 
+void LightSource::emitRays(quint64 count, RayTracer& rayTracer) const
+{
+    RayBatch batch;
+    while (count > 0) {
+        quint64 n = std::min<quint64>(count, RayBatch::DefaultSize);
+        batch.resize(static_cast<int>(n));
+        emitRayBatch(batch);
+        rayTracer.processRayBatch(batch);
+        count -= n;
+    }
+}
+
+bool LightSource::fixedOrigin(v3f& origin) const
+{
+    Q_UNUSED(origin);
+    return false;
+}
+
 const m4f &LightSource::transform() const
 {
     return m_transform;
@@ -21,12 +41,24 @@ void LightSource::setTransform(const m4f& transform)
     m_transform = transform;
 }
 
+QString LightSource::group() const
+{
+    return m_group;
+}
+
+void LightSource::setGroup(const QString& group)
+{
+    m_group = group;
+}
+
 void LightSource::read(const QVariant& v)
 {
     m_transform = fsmx::identity<m4f>();
     Transform::Ptr t;
     if (readOptionalTypedProperty(t, v, "transform"))
         (*t)(m_transform);
+    m_group.clear();
+    readOptionalProperty(m_group, v, "group");
 }
 
 } // end namespace raytracer
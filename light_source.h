@@ -11,6 +11,7 @@
 namespace raytracer {
 
 class RayTracer;
+class RayBatch;
 
 /// \brief The light source interface.
 class LightSource :
@@ -20,19 +21,46 @@ class LightSource :
 public:
     LightSource();
 
-    virtual void emitRays(quint64 count, RayTracer& rayTracer) const = 0;
+    /// \brief Fills all rays of \a batch with rays emitted by this light source.
+    ///
+    /// The method must not modify the state of the light source, so that
+    /// several batches can be filled concurrently.
+    virtual void emitRayBatch(RayBatch& batch) const = 0;
+
+    /// \brief Emits \a count rays and passes them to the ray tracer, batch by batch.
+    void emitRays(quint64 count, RayTracer& rayTracer) const;
+
+    /// \brief Returns true and sets \a origin if all rays of generation zero
+    /// emitted by this light source start at the same point, otherwise returns false.
+    ///
+    /// The default implementation returns false.
+    virtual bool fixedOrigin(v3f& origin) const;
 
     /// \brief Returns primitive transformation matrix.
     const m4f& transform() const;
 
     /// \brief Sets primitive transformation matrix.
-    void setTransform(const m4f &transform);
+    ///
+    /// Light sources keeping transformed objects (e.g., emitting primitives
+    /// of area lights) override this method to update them.
+    virtual void setTransform(const m4f &transform);
+
+    /// \brief Returns the name of the light group (empty by default).
+    ///
+    /// Contributions of lights of one group are accumulated in one canvas layer
+    /// (see RayTracer::Options::lightCanvases); lights having no group form
+    /// a group of their own each.
+    QString group() const;
+
+    /// \brief Sets the name of the light group.
+    void setGroup(const QString& group);
 
-    /// \brief Reads light source transformation.
+    /// \brief Reads light source transformation and group.
     void read(const QVariant& v);
 
 private:
     m4f m_transform;
+    QString m_group;
 };
 
 } // end namespace raytracer
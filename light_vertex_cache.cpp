@@ -0,0 +1,276 @@
+/// \file
+/// \brief Implementation of the LightVertexCache class.
+
+#include "light_vertex_cache.h"
+#include "ray_file_format.h"
+#include "math_util.h"
+#include "rnd.h"
+#include "cxx_exception.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+namespace raytracer {
+
+namespace {
+
+const char HeaderMagic[8] = { 'R', 'A', 'Y', 'V', 'T', 'X', 0, 0 };
+
+static_assert(sizeof(LightVertexCache::Header) == 72, "Unexpected size of vertex cache header");
+static_assert(sizeof(LightVertexCache::Vertex) == 24, "Unexpected size of vertex cache record");
+static_assert(sizeof(LightVertexCache::Block) == 32, "Unexpected size of vertex cache block");
+
+// Spreads the lower 10 bits of x so that there are two zero bits between successive ones
+inline quint32 spreadBits(quint32 x)
+{
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x <<  8)) & 0x0300f00f;
+    x = (x | (x <<  4)) & 0x030c30c3;
+    x = (x | (x <<  2)) & 0x09249249;
+    return x;
+}
+
+inline quint32 mortonCode(const float *pos, const v3f& boxMin, const v3f& scale)
+{
+    quint32 result = 0;
+    for (int i=0; i<3; ++i) {
+        float x = (pos[i] - boxMin[i]) * scale[i];
+        result |= spreadBits(static_cast<quint32>(std::max(0.f, std::min(x, 1023.f)))) << i;
+    }
+    return result;
+}
+
+void boundingBox(float *boxMin, float *boxMax, const LightVertexCache::Vertex *begin, const LightVertexCache::Vertex *end)
+{
+    for (int i=0; i<3; ++i) {
+        boxMin[i] = std::numeric_limits<float>::max();
+        boxMax[i] = -std::numeric_limits<float>::max();
+    }
+    for (auto v=begin; v!=end; ++v)
+        for (int i=0; i<3; ++i) {
+            boxMin[i] = std::min(boxMin[i], v->pos[i]);
+            boxMax[i] = std::max(boxMax[i], v->pos[i]);
+        }
+}
+
+[[noreturn]] void fail(const std::string& message, const QString& fileName)
+{
+    throw cxx::exception(message + " '" + QFileInfo(fileName).absoluteFilePath().toStdString() + "'");
+}
+
+} // anonymous namespace
+
+LightVertexCache::Header::Header()
+{
+    std::memset(this, 0, sizeof(*this));
+    std::memcpy(magic, HeaderMagic, sizeof(magic));
+    version = Version;
+    headerSize = sizeof(*this);
+    blockVertexCount = BlockVertexCount;
+    weight = 1.f;
+}
+
+bool LightVertexCache::Header::isValid() const
+{
+    return std::memcmp(magic, HeaderMagic, sizeof(magic)) == 0;
+}
+
+LightVertexCache::Vertex LightVertexCache::Vertex::encode(
+        const v3f& pos, const v3f& normal, const v3f& color, float translucency, int generation)
+{
+    Vertex result;
+    for (int i=0; i<3; ++i) {
+        result.pos[i] = pos[i];
+        result.color[i] = floatToHalf(color[i]);
+    }
+    RayFileFormat::octEncode(normal, result.normal);
+    result.translucency = static_cast<quint8>(std::max(0.f, std::min(translucency, 1.f))*255.f + 0.5f);
+    result.generation = static_cast<quint8>(std::max(0, std::min(generation, 255)));
+    return result;
+}
+
+v3f LightVertexCache::Vertex::position() const
+{
+    return mkv3f(pos[0], pos[1], pos[2]);
+}
+
+v3f LightVertexCache::Vertex::normalVector() const
+{
+    return RayFileFormat::octDecode(normal);
+}
+
+v3f LightVertexCache::Vertex::colorVector() const
+{
+    return mkv3f(halfToFloat(color[0]), halfToFloat(color[1]), halfToFloat(color[2]));
+}
+
+float LightVertexCache::Vertex::translucencyValue() const
+{
+    return translucency / 255.f;
+}
+
+LightVertexCache::LightVertexCache(quint64 maxVertexCount) :
+    m_maxVertexCount(std::max(maxVertexCount, static_cast<quint64>(2))),
+    m_acceptProbability(1.f)
+{
+}
+
+quint64 LightVertexCache::maxVertexCount() const
+{
+    return m_maxVertexCount;
+}
+
+void LightVertexCache::add(const v3f& pos, const v3f& normal, const v3f& color, float translucency, int generation)
+{
+    Vertex v = Vertex::encode(pos, normal, color, translucency, generation);
+    QMutexLocker lock(&m_mutex);
+    if (m_acceptProbability < 1.f   &&
+            std::uniform_real_distribution<float>(0.f, 1.f)(rnd::gen()) >= m_acceptProbability)
+        return;
+    if (m_vertices.size() >= m_maxVertexCount)
+        thinOut();
+    m_vertices.push_back(v);
+    m_blocks.clear();
+}
+
+void LightVertexCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_vertices.clear();
+    m_blocks.clear();
+    m_acceptProbability = 1.f;
+}
+
+std::size_t LightVertexCache::vertexCount() const
+{
+    return m_vertices.size();
+}
+
+const LightVertexCache::Vertex& LightVertexCache::vertex(std::size_t index) const
+{
+    Q_ASSERT(index < m_vertices.size());
+    return m_vertices[index];
+}
+
+float LightVertexCache::weight() const
+{
+    return 1.f / m_acceptProbability;
+}
+
+void LightVertexCache::sort()
+{
+    QMutexLocker lock(&m_mutex);
+    if (!m_blocks.empty()   ||   m_vertices.empty())
+        return;
+
+    float boxMin[3], boxMax[3];
+    boundingBox(boxMin, boxMax, m_vertices.data(), m_vertices.data() + m_vertices.size());
+    v3f vmin = mkv3f(boxMin[0], boxMin[1], boxMin[2]);
+    v3f scale;
+    for (int i=0; i<3; ++i) {
+        float size = boxMax[i] - boxMin[i];
+        scale[i] = size > 0.f ?   1024.f / size :   0.f;
+    }
+
+    std::vector< std::pair<quint32, quint32> > keys(m_vertices.size());
+    for (std::size_t i=0; i<m_vertices.size(); ++i)
+        keys[i] = std::make_pair(mortonCode(m_vertices[i].pos, vmin, scale), static_cast<quint32>(i));
+    std::sort(keys.begin(), keys.end());
+    std::vector<Vertex> sorted(m_vertices.size());
+    for (std::size_t i=0; i<keys.size(); ++i)
+        sorted[i] = m_vertices[keys[i].second];
+    m_vertices.swap(sorted);
+
+    for (std::size_t first=0; first<m_vertices.size(); first+=BlockVertexCount) {
+        Block b;
+        b.first = static_cast<quint32>(first);
+        b.count = static_cast<quint32>(std::min(m_vertices.size() - first, static_cast<std::size_t>(BlockVertexCount)));
+        boundingBox(b.boxMin, b.boxMax, m_vertices.data() + first, m_vertices.data() + first + b.count);
+        m_blocks.push_back(b);
+    }
+}
+
+int LightVertexCache::blockCount() const
+{
+    return m_blocks.size();
+}
+
+const LightVertexCache::Block& LightVertexCache::block(int index) const
+{
+    Q_ASSERT(index >= 0   &&   index < blockCount());
+    return m_blocks[index];
+}
+
+void LightVertexCache::save(const QString& fileName)
+{
+    sort();
+
+    Header header;
+    header.vertexCount = m_vertices.size();
+    header.blockCount = m_blocks.size();
+    boundingBox(header.boxMin, header.boxMax, m_vertices.data(), m_vertices.data() + m_vertices.size());
+    header.weight = weight();
+    header.seed = rnd::seed();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        fail("Failed to open vertex cache output", fileName);
+    auto write = [&](const void *data, quint64 size) {
+        if (file.write(reinterpret_cast<const char*>(data), size) != static_cast<qint64>(size))
+            fail("Failed to write vertex cache output", fileName);
+    };
+    write(&header, sizeof(header));
+    write(m_blocks.data(), m_blocks.size()*sizeof(Block));
+    write(m_vertices.data(), m_vertices.size()*sizeof(Vertex));
+}
+
+void LightVertexCache::load(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        fail("Failed to open vertex cache input", fileName);
+    auto read = [&](void *data, quint64 size) {
+        if (file.read(reinterpret_cast<char*>(data), size) != static_cast<qint64>(size))
+            fail("Failed to read vertex cache input", fileName);
+    };
+
+    Header header;
+    read(&header, sizeof(header));
+    if (!header.isValid())
+        fail("Invalid vertex cache input", fileName);
+    if (header.version > Version)
+        fail("Unsupported version of vertex cache input", fileName);
+    if (header.headerSize < sizeof(header)   ||   !(header.weight > 0.f)   ||
+            static_cast<quint64>(file.size()) != header.headerSize + header.blockCount*sizeof(Block) + header.vertexCount*sizeof(Vertex))
+        fail("Vertex cache input is corrupt", fileName);
+    if (!file.seek(header.headerSize))
+        fail("Failed to read vertex cache input", fileName);
+
+    QMutexLocker lock(&m_mutex);
+    m_blocks.resize(header.blockCount);
+    m_vertices.resize(header.vertexCount);
+    read(m_blocks.data(), m_blocks.size()*sizeof(Block));
+    read(m_vertices.data(), m_vertices.size()*sizeof(Vertex));
+    for (const auto& b : m_blocks)
+        if (static_cast<quint64>(b.first) + b.count > header.vertexCount)
+            fail("Vertex cache input is corrupt: invalid block", fileName);
+    m_acceptProbability = 1.f / header.weight;
+}
+
+void LightVertexCache::thinOut()
+{
+    // Keep each vertex with probability 1/2
+    std::bernoulli_distribution keep(0.5);
+    auto end = std::remove_if(m_vertices.begin(), m_vertices.end(), [&keep](const Vertex&) {
+        return !keep(rnd::gen());
+    });
+    m_vertices.erase(end, m_vertices.end());
+    m_acceptProbability *= 0.5f;
+}
+
+} // end namespace raytracer
@@ -0,0 +1,132 @@
+/// \file
+/// \brief Declaration of the LightVertexCache class.
+
+#ifndef LIGHT_VERTEX_CACHE_H
+#define LIGHT_VERTEX_CACHE_H
+
+#include "common.h"
+
+#include <QMutex>
+
+#include <vector>
+
+namespace raytracer {
+
+/// \brief Store of light path vertices on diffuse surfaces.
+///
+/// Vertices are collected during light tracing (see RayTracer::Options::vertexOutputFileName)
+/// and then allow to render the scene from a new camera position without tracing light
+/// paths again: each vertex is connected to the camera screen (see Camera::verticesInputFileName()).
+///
+/// A vertex keeps its position, the surface normal on the side the light comes from,
+/// the color of the light leaving the surface, the surface translucency, and
+/// the generation of rays leaving the surface.
+/// The number of vertices is limited: when the limit is reached, a random half of vertices
+/// is dropped, and further vertices are accepted with half the probability; weight()
+/// compensates for that.
+///
+/// The file keeps vertices sorted along a Morton curve in their bounding box,
+/// so that close vertices are stored together; vertices are grouped in blocks
+/// with bounding boxes of their own, allowing to skip blocks not seen by a camera.
+class LightVertexCache
+{
+public:
+    enum { Version = 1 };
+
+    /// \brief Number of vertices in a block.
+    enum { BlockVertexCount = 4096 };
+
+    /// \brief Default maximum number of vertices (96 MB of vertex data).
+    enum : quint64 { DefaultMaxVertexCount = 1 << 22 };
+
+    /// \brief File header.
+    struct Header
+    {
+        char magic[8];
+        quint32 version;
+        quint32 headerSize;
+        quint64 vertexCount;
+        quint32 blockCount;
+        quint32 blockVertexCount;
+        float boxMin[3];
+        float boxMax[3];
+        float weight;
+        quint32 reserved;
+        quint64 seed;
+
+        Header();
+        bool isValid() const;
+    };
+
+    /// \brief Compact vertex representation, same in memory and in the file.
+    struct Vertex
+    {
+        float pos[3];
+        qint16 normal[2];       ///< \brief Octahedral encoding of the unit normal.
+        quint16 color[3];       ///< \brief Half precision color components.
+        quint8 translucency;    ///< \brief Translucency scaled to [0, 255].
+        quint8 generation;      ///< \brief Generation of rays leaving the vertex, up to 255.
+
+        static Vertex encode(const v3f& pos, const v3f& normal, const v3f& color, float translucency, int generation);
+        v3f position() const;
+        v3f normalVector() const;
+        v3f colorVector() const;
+        float translucencyValue() const;
+    };
+
+    /// \brief Range of vertices with their bounding box.
+    struct Block
+    {
+        float boxMin[3];
+        float boxMax[3];
+        quint32 first;
+        quint32 count;
+    };
+
+    explicit LightVertexCache(quint64 maxVertexCount = DefaultMaxVertexCount);
+
+    quint64 maxVertexCount() const;
+
+    /// \brief Adds a vertex; thread-safe.
+    /// \param pos Vertex position.
+    /// \param normal Unit surface normal on the side the light comes from.
+    /// \param color Color of the light leaving the surface.
+    /// \param translucency Probability of transmission through the surface.
+    /// \param generation Generation of rays leaving the surface.
+    void add(const v3f& pos, const v3f& normal, const v3f& color, float translucency, int generation);
+
+    /// \brief Removes all vertices.
+    void clear();
+
+    std::size_t vertexCount() const;
+    const Vertex& vertex(std::size_t index) const;
+
+    /// \brief Returns the factor to apply to vertex colors, compensating for dropped vertices.
+    float weight() const;
+
+    /// \brief Sorts vertices and splits them into blocks; called by save().
+    void sort();
+
+    /// \brief Returns the number of blocks; zero until sort() or load() is called.
+    int blockCount() const;
+    const Block& block(int index) const;
+
+    /// \brief Writes vertices to file \a fileName; throws an exception on failure.
+    void save(const QString& fileName);
+
+    /// \brief Replaces vertices with those read from file \a fileName; throws an exception on failure.
+    void load(const QString& fileName);
+
+private:
+    quint64 m_maxVertexCount;
+    std::vector<Vertex> m_vertices;
+    std::vector<Block> m_blocks;
+    float m_acceptProbability;
+    QMutex m_mutex;
+
+    void thinOut();
+};
+
+} // end namespace raytracer
+
+#endif // LIGHT_VERTEX_CACHE_H
@@ -0,0 +1,87 @@
+/// \file
+/// \brief Implementation of the AreaLight class.
+
+#include "area_light.h"
+#include "ray_batch.h"
+#include "math_util.h"
+
+namespace raytracer {
+
+AreaLight::AreaLight() :
+    m_color(mkv3f(1.f, 1.f, 1.f)),
+    m_twoSided(false)
+{
+}
+
+void AreaLight::emitRayBatch(RayBatch& batch) const
+{
+    int size = batch.size();
+    for (int begin=0; begin<size; begin+=BlockSize)
+        generateBlock(batch, begin, std::min<int>(size - begin, BlockSize));
+}
+
+void AreaLight::generateBlock(RayBatch& batch, int begin, int count) const
+{
+    Q_ASSERT(count > 0   &&   count <= BlockSize);
+    const Primitive& e = emitter();
+    auto& gen = rnd::gen();
+    std::uniform_real_distribution<float> dis(0.f, 1.f);
+
+    // Pair position strata with randomly permuted direction strata
+    int order[BlockSize], dirStrata[BlockSize];
+    for (int i=0; i<BlockSize; ++i)
+        order[i] = dirStrata[i] = i;
+    std::shuffle(order, order+BlockSize, gen);
+    std::shuffle(dirStrata, dirStrata+BlockSize, gen);
+
+    const float strataSize = 1.f / StrataCount;
+    SurfacePoint sp;
+    for (int i=0; i<count; ++i) {
+        int posStratum = order[i];
+        int dirStratum = dirStrata[i];
+        v2f uv = mkv2f(
+            (posStratum % StrataCount + dis(gen)) * strataSize,
+            (posStratum / StrataCount + dis(gen)) * strataSize);
+        e.surfaceSample(sp, uv);
+        v3f n = spnormal(sp);
+        if (m_twoSided   &&   dis(gen) < 0.5f)
+            n = -n;
+        v3f dir = cosineWeightedDirection(
+            n,
+            (dirStratum % StrataCount + dis(gen)) * strataSize,
+            (dirStratum / StrataCount + dis(gen)) * strataSize);
+        batch.setRay(begin+i, sppos(sp), dir, m_color);
+    }
+}
+
+void AreaLight::read(const QVariant& v)
+{
+    LightSource::read(v);
+
+    m_color = mkv3f(1.f, 1.f, 1.f);
+    m_twoSided = false;
+    readOptionalProperty(m_color, v, "color");
+    readOptionalProperty(m_twoSided, v, "two_sided");
+}
+
+v3f AreaLight::color() const
+{
+    return m_color;
+}
+
+void AreaLight::setColor(const v3f& color)
+{
+    m_color = color;
+}
+
+bool AreaLight::isTwoSided() const
+{
+    return m_twoSided;
+}
+
+void AreaLight::setTwoSided(bool twoSided)
+{
+    m_twoSided = twoSided;
+}
+
+} // end namespace raytracer
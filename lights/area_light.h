@@ -0,0 +1,62 @@
+/// \file
+/// \brief Declaration of the AreaLight class.
+
+#ifndef AREA_LIGHT_H
+#define AREA_LIGHT_H
+
+#include "light_source.h"
+#include "primitive.h"
+
+namespace raytracer {
+
+
+/// \brief Base class for light sources emitting from the surface of a primitive.
+///
+/// Ray origins are distributed uniformly by area, ray directions are
+/// cosine-weighted around the surface normal. Samples are generated in blocks
+/// of #BlockSize rays; within a block, both origins and directions are stratified.
+class AreaLight : public LightSource
+{
+public:
+    /// \brief Number of strata along each dimension of the unit square.
+    enum { StrataCount = 16 };
+
+    /// \brief Number of rays in a block of samples.
+    enum { BlockSize = StrataCount*StrataCount };
+
+    AreaLight();
+
+    void emitRayBatch(RayBatch& batch) const;
+
+    /// \brief Reads light source transformation, color and the two-sided emission flag.
+    void read(const QVariant& v);
+
+    /// \brief Returns the color of emitted rays.
+    v3f color() const;
+
+    /// \brief Sets the color of emitted rays.
+    void setColor(const v3f& color);
+
+    /// \brief Returns true if both sides of the surface emit light,
+    /// false if only the side the surface normal points to does.
+    bool isTwoSided() const;
+
+    /// \brief Sets the two-sided emission flag.
+    void setTwoSided(bool twoSided);
+
+protected:
+    /// \brief Returns the primitive whose surface emits light.
+    virtual const Primitive& emitter() const = 0;
+
+    /// \brief Generates a block of \a count rays (not more than #BlockSize)
+    /// emitted by this light, starting at index \a begin of \a batch.
+    void generateBlock(RayBatch& batch, int begin, int count) const;
+
+private:
+    v3f m_color;
+    bool m_twoSided;
+};
+
+} // end namespace raytracer
+
+#endif // AREA_LIGHT_H
@@ -2,8 +2,7 @@
 /// \brief Implementation of the PointLight class.
 
 #include "point_light.h"
-#include "ray_tracer.h"
-#include "ray.h"
+#include "ray_batch.h"
 #include "math_util.h"
 
 namespace raytracer {
@@ -15,18 +14,22 @@ PointLight::PointLight() :
 {
 }
 
-void PointLight::emitRays(quint64 count, RayTracer& rayTracer) const
+void PointLight::emitRayBatch(RayBatch& batch) const
 {
+    int n = batch.size();
 
-    // Obtain light source origin
-    v3f origin = translation(transform());
+    // All rays start at light source origin
+    batch.fillOrigin(0, n, translation(transform()));
+    batch.fillColor(0, n, m_color);
 
-    // Emit count rays in random directions
-    for (quint64 i=0; i<count; ++i)
-    {
-        // Emit ray in random direction
-        rayTracer.processRay(Ray(origin, randomPointOnUnitSphere(), m_color, 0));
-    }
+    // Emit rays in random directions
+    randomPointsOnUnitSphere(batch.dirX(), batch.dirY(), batch.dirZ(), n);
+}
+
+bool PointLight::fixedOrigin(v3f& origin) const
+{
+    origin = translation(transform());
+    return true;
 }
 
 void PointLight::read(const QVariant &v)
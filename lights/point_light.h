@@ -15,7 +15,8 @@ public:
     PointLight();
     PointLight(const v3f& color);
 
-    void emitRays(quint64 count, RayTracer& rayTracer) const;
+    void emitRayBatch(RayBatch& batch) const;
+    bool fixedOrigin(v3f& origin) const;
     void read(const QVariant &v);
 
 private:
@@ -0,0 +1,32 @@
+/// \file
+/// \brief Implementation of the PrimitiveLight class.
+
+#include "primitive_light.h"
+#include "surfprop/emissive_surface.h"
+#include "cxx_exception.h"
+
+namespace raytracer {
+
+PrimitiveLight::PrimitiveLight(const Primitive::Ptr& primitive, const EmissiveSurface& surfaceProperties) :
+    m_primitive(primitive)
+{
+    Q_ASSERT(primitive);
+    if (!(primitive->area() > 0.f))
+        throw cxx::exception(std::string("Primitive '") + primitive->name().toStdString() + "' cannot emit light");
+    setColor(surfaceProperties.color());
+    setTwoSided(surfaceProperties.isTwoSided());
+    setGroup(primitive->name());
+}
+
+void PrimitiveLight::read(const QVariant &v)
+{
+    // Parameters are taken from the primitive and its surface properties
+    Q_UNUSED(v);
+}
+
+const Primitive& PrimitiveLight::emitter() const
+{
+    return *m_primitive;
+}
+
+} // end namespace raytracer
@@ -0,0 +1,34 @@
+/// \file
+/// \brief Declaration of the PrimitiveLight class.
+
+#ifndef PRIMITIVE_LIGHT_H
+#define PRIMITIVE_LIGHT_H
+
+#include "area_light.h"
+
+namespace raytracer {
+
+class EmissiveSurface;
+
+/// \brief Light source emitting from the surface of a scene primitive.
+///
+/// Instances are created by the scene for primitives having EmissiveSurface
+/// surface properties; unlike other light sources, they are not read from the scene file.
+/// The light group is the primitive name.
+class PrimitiveLight : public AreaLight
+{
+public:
+    PrimitiveLight(const Primitive::Ptr& primitive, const EmissiveSurface& surfaceProperties);
+
+    void read(const QVariant &v);
+
+protected:
+    const Primitive& emitter() const;
+
+private:
+    Primitive::Ptr m_primitive;
+};
+
+} // end namespace raytracer
+
+#endif // PRIMITIVE_LIGHT_H
@@ -0,0 +1,44 @@
+/// \file
+/// \brief Implementation of the RectangleLight class.
+
+#include "rectangle_light.h"
+#include "primitives/rectangle.h"
+
+namespace raytracer {
+
+REGISTER_GENERATOR(RectangleLight)
+
+RectangleLight::RectangleLight() :
+    m_primitive(std::make_shared<Rectangle>())
+{
+}
+
+RectangleLight::RectangleLight(float width, float height) :
+    m_primitive(std::make_shared<Rectangle>(width, height))
+{
+}
+
+void RectangleLight::read(const QVariant &v)
+{
+    AreaLight::read(v);
+
+    float width = 1.f;
+    float height = 1.f;
+    readOptionalProperty(width, v, "width");
+    readOptionalProperty(height, v, "height");
+    m_primitive = std::make_shared<Rectangle>(width, height);
+    m_primitive->setTransform(transform());
+}
+
+void RectangleLight::setTransform(const m4f &transform)
+{
+    AreaLight::setTransform(transform);
+    m_primitive->setTransform(transform);
+}
+
+const Primitive& RectangleLight::emitter() const
+{
+    return *m_primitive;
+}
+
+} // end namespace raytracer
@@ -0,0 +1,35 @@
+/// \file
+/// \brief Declaration of the RectangleLight class.
+
+#ifndef RECTANGLE_LIGHT_H
+#define RECTANGLE_LIGHT_H
+
+#include "area_light.h"
+
+namespace raytracer {
+
+/// \brief Rectangular panel light.
+///
+/// The panel lies in the xy plane of the light source coordinate system
+/// and emits in the direction of the z axis (in both directions if two-sided).
+/// The panel itself does not participate in collisions.
+class RectangleLight : public AreaLight
+{
+    DECL_GENERATOR(RectangleLight)
+public:
+    RectangleLight();
+    RectangleLight(float width, float height);
+
+    void setTransform(const m4f &transform);
+    void read(const QVariant &v);
+
+protected:
+    const Primitive& emitter() const;
+
+private:
+    Primitive::Ptr m_primitive;
+};
+
+} // end namespace raytracer
+
+#endif // RECTANGLE_LIGHT_H
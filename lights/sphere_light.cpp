@@ -0,0 +1,42 @@
+/// \file
+/// \brief Implementation of the SphereLight class.
+
+#include "sphere_light.h"
+#include "primitives/sphere.h"
+
+namespace raytracer {
+
+REGISTER_GENERATOR(SphereLight)
+
+SphereLight::SphereLight() :
+    m_primitive(std::make_shared<Sphere>())
+{
+}
+
+SphereLight::SphereLight(float radius) :
+    m_primitive(std::make_shared<Sphere>(radius))
+{
+}
+
+void SphereLight::read(const QVariant &v)
+{
+    AreaLight::read(v);
+
+    float radius = 1.f;
+    readOptionalProperty(radius, v, "radius");
+    m_primitive = std::make_shared<Sphere>(radius);
+    m_primitive->setTransform(transform());
+}
+
+void SphereLight::setTransform(const m4f &transform)
+{
+    AreaLight::setTransform(transform);
+    m_primitive->setTransform(transform);
+}
+
+const Primitive& SphereLight::emitter() const
+{
+    return *m_primitive;
+}
+
+} // end namespace raytracer
@@ -0,0 +1,34 @@
+/// \file
+/// \brief Declaration of the SphereLight class.
+
+#ifndef SPHERE_LIGHT_H
+#define SPHERE_LIGHT_H
+
+#include "area_light.h"
+
+namespace raytracer {
+
+/// \brief Spherical light emitting outwards from its surface.
+///
+/// The sphere is centered at the origin of the light source coordinate system.
+/// The sphere itself does not participate in collisions.
+class SphereLight : public AreaLight
+{
+    DECL_GENERATOR(SphereLight)
+public:
+    SphereLight();
+    explicit SphereLight(float radius);
+
+    void setTransform(const m4f &transform);
+    void read(const QVariant &v);
+
+protected:
+    const Primitive& emitter() const;
+
+private:
+    Primitive::Ptr m_primitive;
+};
+
+} // end namespace raytracer
+
+#endif // SPHERE_LIGHT_H
@@ -1,73 +1,24 @@
 #include "mainwindow.h"
-#include "cxx_exception.h"
-#include "ray_tracer.h"
-#include "camera.h"
+#include "command_line.h"
 
 #include <QApplication>
-#include <QFileInfo>
-#include <QTime>
-#include <iostream>
-#include <iomanip>
 
-#if defined(__MINGW32__) && (__GNUC__ <= 4   ||   (__GNUC__ == 4 && __GNUC_MINOR__ <= 8))
-#define defaultfloat ""
-#endif
-
-int runInBatchMode(QString sceneFileName, QString imageFileName)
+int main(int argc, char *argv[])
 {
-    using namespace std;
-    using namespace raytracer;
-    try {
-        FileReader::Ptr f = FileReader::newInstance("JsonFileReader");
-        RayTracer rayTracer;
-        rayTracer.read(f->read(sceneFileName));
-        if (imageFileName.indexOf(QRegExp("\\.png$|\\.jpe?g$")) == -1)
-            imageFileName += ".png";
-        if (QFileInfo(imageFileName).exists())
-            throw cxx::exception(QString("Output image file %1 already exists").arg(imageFileName).toStdString());
-        Camera::Ptr cam = rayTracer.camera();
-        if (!cam)
-            throw cxx::exception("There is no camera in the scene");
-        cout << "Input scene: " << sceneFileName.toStdString() << endl;
-        cout << "Output image: " << imageFileName.toStdString() << endl;
-        QTime time;
-        quint64 totalRays = rayTracer.options().totalRayLimit;
-        cout << setprecision(3);
-        rayTracer.setProgressCallback([totalRays, &time](float progress, bool, qint64 rays) {
-            cout << "progress: "<< defaultfloat << progress*100 << "%, "
-                 << scientific << static_cast<double>(rays) << " of " << static_cast<double>(totalRays) << " rays, "
-                 << defaultfloat << time.elapsed() / 1000. << " s"
-                 << endl;
-        }, 10000, 1000000);
-        time.start();
-        rayTracer.run();
-        cout << defaultfloat;
-        cout << "Time elapsed (sec): " << time.elapsed() / 1000. << endl;
-        (*rayTracer.imageProcessor())(cam->canvas()).toImage().save(imageFileName);
-        return 0;
+    // Batch commands run without the GUI
+    QStringList args;
+    for (int i=1; i<argc; ++i)
+        args << QString::fromLocal8Bit(argv[i]);
+    raytracer::CommandLine commandLine(args);
+    if (!commandLine.isEmpty()) {
+        QCoreApplication a(argc, argv);
+        return commandLine.run();
     }
-    catch(const std::exception& e) {
-        cerr << e.what() << endl;
-        return 1;
-    }
-}
 
-int main(int argc, char *argv[])
-{
     QApplication a(argc, argv);
     MainWindow w;
-
-    QStringList args = a.arguments();
-    switch (args.size())
-    {
-    case 2:
-        w.openScene(args[1]);
-        break;
-    case 3:
-        return runInBatchMode(args[1], args[2]);
-    default:
-        break;
-    }
+    if (args.size() == 1)
+        w.openScene(args[0]);
 
     w.show();
     return a.exec();
@@ -6,6 +6,7 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QCloseEvent>
+#include <QResizeEvent>
 #include <QMessageBox>
 
 template< class F >
@@ -22,6 +23,10 @@ MainWindow::MainWindow(QWidget *parent) :
     m_rayTracerController(m_rayTracer)
 {
     ui->setupUi(this);
+
+    // Let the window shrink below the size of the image; previews are downsampled to fit the label
+    ui->label->setMinimumSize(1, 1);
+
     connect(ui->actionQuit, SIGNAL(triggered(bool)), SLOT(close()));
     connect(ui->actionOpenScene, SIGNAL(triggered(bool)), SLOT(openScene()));
     connect(ui->actionSaveRaytracerImage, SIGNAL(triggered(bool)), SLOT(saveRayTracerImage()));
@@ -31,7 +36,7 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(&m_rayTracerController, SIGNAL(rayTracerProgress(float,quint64)), SLOT(rayTracerProgress(float,quint64)), Qt::QueuedConnection);
     connect(&m_rayTracerController, SIGNAL(rayTracerFinished(QString)), SLOT(rayTracerFinished(QString)));
 
-    auto ic = new raytracer::ImageProcessorController(this);
+    auto ic = m_imageProcessorController = new raytracer::ImageProcessorController(this);
     ui->menuBar->addMenu(ic->menu());
     connect(ic, SIGNAL(imageProcessorChanged(raytracer::ImageProcessor::Ptr)), SLOT(imageProcessorChanged(raytracer::ImageProcessor::Ptr)));
 }
@@ -56,12 +61,15 @@ void MainWindow::openScene(const QString& fileName)
         m_rayTracerController.stop();
         m_rayTracer = RayTracer();
         m_rayTracer.read(f->read(fileName));
+        m_imageProcessorController->setLightGroups(
+                    m_rayTracer.options().lightCanvases ?   m_rayTracer.lightGroups() :   QStringList());
+        m_imageProcessorController->setBounceLayerCount(
+                    m_rayTracer.options().bounceCanvases ?   m_rayTracer.options().reflectionLimit :   0);
         Camera::Ptr cam = m_rayTracer.camera();
         if (cam) {
             ui->label->setText(QString());
-            auto imgProc = m_rayTracer.imageProcessor();
-            ui->label->setPixmap(QPixmap::fromImage((*imgProc)(cam->canvas()).toImage()));
-            m_rayTracerController.setImageProcessor(imgProc);
+            m_rayTracerController.setImageProcessor(m_rayTracer.imageProcessor());
+            m_rayTracerController.updatePreview();
             m_startTime.start();
             m_rayTracerController.start();
             ui->actionSaveRaytracerImage->setEnabled(true);
@@ -81,8 +89,16 @@ void MainWindow::saveRayTracerImage()
         return;
     if (fileName.indexOf(QRegExp("\\.png$|\\.jpe?g$")) == -1)
         fileName += ".png";
-    Q_ASSERT(ui->label->pixmap());
-    ui->label->pixmap()->save(fileName);
+    auto cam = m_rayTracer.camera();
+    if (m_rayTracerController.isRunning()   ||   !cam) {
+        // The canvas is being changed; save the preview
+        Q_ASSERT(ui->label->pixmap());
+        ui->label->pixmap()->save(fileName);
+    }
+    else {
+        auto imgProc = m_rayTracerController.imageProcessor();
+        (*imgProc)(cam->canvas()).toImage(QImage::Format_RGB888).save(fileName);
+    }
 }
 
 void MainWindow::imageProcessorChanged(raytracer::ImageProcessor::Ptr imgProc)
@@ -98,6 +114,14 @@ void MainWindow::closeEvent(QCloseEvent *event)
     event->accept();
 }
 
+void MainWindow::resizeEvent(QResizeEvent *event)
+{
+    QMainWindow::resizeEvent(event);
+    m_rayTracerController.setPreviewSize(ui->label->size());
+    if (!m_rayTracerController.isRunning())
+        m_rayTracerController.updatePreview();
+}
+
 void MainWindow::rayTracerProgress(float progress, quint64 raysProcessed)
 {
     ui->statusBar->showMessage(
@@ -118,11 +142,8 @@ void MainWindow::rayTracerFinished(QString error)
 
 void MainWindow::reloadImage()
 {
-    auto cam = m_rayTracer.camera();
-    if (cam) {
-        auto imgProc = m_rayTracerController.imageProcessor();
-        ui->label->setPixmap(QPixmap::fromImage((*imgProc)(cam->canvas()).toImage()));
-    }
+    if (m_rayTracer.camera())
+        m_rayTracerController.updatePreview();
     else
         ui->statusBar->showMessage(tr("No camera was found"));
 }
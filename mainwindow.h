@@ -12,6 +12,10 @@ namespace Ui {
 class MainWindow;
 }
 
+namespace raytracer {
+class ImageProcessorController;
+}
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -31,6 +35,7 @@ public slots:
 
 protected:
     void closeEvent(QCloseEvent *event);
+    void resizeEvent(QResizeEvent *event);
 
 private slots:
     void rayTracerProgress(float progress, quint64 raysProcessed);
@@ -39,6 +44,7 @@ private slots:
 private:
     raytracer::RayTracer m_rayTracer;
     raytracer::RayTracerController m_rayTracerController;
+    raytracer::ImageProcessorController *m_imageProcessorController;
     QTime m_startTime;
 
     void reloadImage();
@@ -0,0 +1,185 @@
+/// \file
+/// \brief Implementation of the PolynomialLensCamera class.
+
+#include "polynomial_lens_camera.h"
+#include "primitives/single_sided_rectangle.h"
+#include "transform.h"
+#include "ray_tracer.h"
+#include "ray.h"
+#include "ray_file_writer.h"
+#include "cxx_exception.h"
+
+#include <cmath>
+
+namespace raytracer {
+
+namespace {
+
+class CameraSurfProp : public SurfaceProperties
+{
+public:
+    CameraSurfProp(
+            const PolynomialLensCamera::Geometry& geom,
+            const LensPolynomial& polynomial,
+            const std::shared_ptr<RayFileWriter>& raysWriter,
+            Camera::Canvas& canvas,
+            const m4f& transform) :
+        m_polynomial(polynomial),
+        m_raysWriter(raysWriter),
+        m_canvas(canvas),
+        m_invTransform(transform.inv()),
+        m_pixelScale(mkv2f(-geom.resx/geom.sensorWidth, -geom.resy/geom.sensorHeight())),
+        m_pixelOffset(mkv2f(0.5f*geom.resx, 0.5f*geom.resy))
+    {
+    }
+
+    void processCollision(
+            const Ray& ray,
+            const SurfacePoint& surfacePoint,
+            RayTracer& rayTracer) const
+    {
+        if (m_raysWriter)
+            m_raysWriter->write(ray, surfacePoint);
+
+        auto rEye = m_invTransform*conv<v4f>(v3f(sppos(surfacePoint)));
+        v3f e = affine(m_invTransform)*ray.dir;
+        if (e[2] <= 0.f)
+            return;
+        float invz = 1.f / e[2];
+
+        v2f rSensor;
+        if (!m_polynomial.map(rEye[0], rEye[1], e[0]*invz, e[1]*invz, rSensor))
+            return;
+
+        auto xy = mkv2i(
+            static_cast<int>(rSensor[0]*m_pixelScale[0] + m_pixelOffset[0]),
+            static_cast<int>(rSensor[1]*m_pixelScale[1] + m_pixelOffset[1]));
+        if (!m_canvas.contains(xy))
+            return;
+        Camera::splat(m_canvas, xy, ray, rayTracer);
+    }
+    void read(const QVariant&) {}
+
+private:
+    const LensPolynomial& m_polynomial;
+    std::shared_ptr<RayFileWriter> m_raysWriter;
+    Camera::Canvas& m_canvas;
+    m4f m_invTransform;
+    v2f m_pixelScale;
+    v2f m_pixelOffset;
+};
+
+} // anonymous namespace
+
+REGISTER_GENERATOR(PolynomialLensCamera)
+
+void PolynomialLensCamera::clear()
+{
+    if (m_lens.surfaces().empty())
+        throw cxx::exception("PolynomialLensCamera: lens is not specified");
+
+    // Fit the lens polynomial for the field of view covering the sensor
+    double sensorDistance = m_geometry.focusingDistance > 0 ?
+                m_lens.imageDistance(m_geometry.focusingDistance) :
+                m_lens.backDistance();
+    float sensorHeight = m_geometry.sensorHeight();
+    double halfDiagonal = 0.5*std::sqrt(m_geometry.sensorWidth*m_geometry.sensorWidth + sensorHeight*sensorHeight);
+    double maxTangent = FitFieldMargin * halfDiagonal / std::fabs(m_lens.focalLength());
+    m_polynomial.fit(m_lens, sensorDistance, maxTangent, m_geometry.degree);
+
+    m_canvas = Canvas(mkv2i(m_geometry.resx, m_geometry.resy));
+
+    float entranceSize = static_cast<float>(2*m_lens.entranceAperture());
+    m_primitive = std::make_shared<SingleSidedRectangle>(entranceSize, entranceSize);
+
+    m4f T = transform();
+    Rotate(mkv3f(0.f, 1.f, 0.f), 180.f)(T);
+    m_primitive->setTransform(T);
+
+    m_primitive->setName("camera lens");
+
+    RayFileFormat::Header header;
+    header.setCameraType("PolynomialLensCamera");
+    header.setScreen(T, entranceSize, entranceSize);
+    header.resolution[0] = m_geometry.resx;
+    header.resolution[1] = m_geometry.resy;
+    header.parameters[0] = m_geometry.sensorWidth;
+    header.parameters[1] = m_geometry.focusingDistance;
+    header.parameters[2] = m_geometry.degree;
+    resetRaysWriter(header);
+
+    m_primitive->setSurfaceProperties(std::make_shared<CameraSurfProp>(
+                                          m_geometry, m_polynomial, raysWriter(), m_canvas, transform()));
+}
+
+Primitive::Ptr PolynomialLensCamera::cameraPrimitive() const
+{
+    return m_primitive;
+}
+
+const Camera::Canvas& PolynomialLensCamera::canvas() const {
+    return m_canvas;
+}
+
+Camera::Canvas& PolynomialLensCamera::canvas() {
+    return m_canvas;
+}
+
+SurfaceProperties::Ptr PolynomialLensCamera::makeSurfaceProperties(Canvas& canvas) const
+{
+    return std::make_shared<CameraSurfProp>(
+                m_geometry, m_polynomial, std::shared_ptr<RayFileWriter>(), canvas, transform());
+}
+
+void PolynomialLensCamera::read(const QVariant &v)
+{
+    Camera::read(v);
+
+    m_geometry = Geometry();
+
+    QVariantMap m = safeVariantMap(v);
+    readOptionalProperty(m, "geometry", [this](const QVariant& v) {
+        Geometry g;
+        QVariantMap m = safeVariantMap(v);
+        readOptionalProperty(g.resx, m, "resx");
+        readOptionalProperty(g.resy, m, "resy");
+        readOptionalProperty(g.sensorWidth, m, "sensor_width");
+        readOptionalProperty(g.focusingDistance, m, "focus_dist");
+        readOptionalProperty(g.degree, m, "degree");
+        if (g.degree < 1   ||   g.degree > LensPolynomial::MaxDegree)
+            throw cxx::exception("PolynomialLensCamera: invalid polynomial degree");
+        m_geometry = g;
+    });
+    readProperty(m, "lens", [this](const QVariant& v) {
+        m_lens.read(v);
+    });
+}
+
+const PolynomialLensCamera::Geometry& PolynomialLensCamera::geometry() const
+{
+    return m_geometry;
+}
+
+void PolynomialLensCamera::setGeometry(const Geometry& geometry)
+{
+    m_geometry = geometry;
+    clear();
+}
+
+const LensPrescription& PolynomialLensCamera::lens() const
+{
+    return m_lens;
+}
+
+void PolynomialLensCamera::setLens(const LensPrescription& lens)
+{
+    m_lens = lens;
+    clear();
+}
+
+const LensPolynomial& PolynomialLensCamera::polynomial() const
+{
+    return m_polynomial;
+}
+
+} // end namespace raytracer
@@ -0,0 +1,87 @@
+/// \file
+/// \brief Declaration of the PolynomialLensCamera class.
+
+#ifndef POLYNOMIAL_LENS_CAMERA_H
+#define POLYNOMIAL_LENS_CAMERA_H
+
+#include "camera.h"
+#include "lens_prescription.h"
+#include "lens_polynomial.h"
+
+namespace raytracer {
+
+/// \brief Camera with a multi-element lens.
+///
+/// The lens is specified by its prescription (see LensPrescription); its axis is the
+/// z axis of the camera, and the first lens vertex is at the camera origin. Rays hitting
+/// the entrance plane are mapped to the sensor by a polynomial fitted to the lens
+/// in clear() (see LensPolynomial), so the cost per ray does not depend on the number
+/// of lens elements.
+class PolynomialLensCamera : public Camera
+{
+    DECL_GENERATOR(PolynomialLensCamera)
+public:
+    /// \brief Margin applied to the field of view when fitting the lens polynomial.
+    static constexpr float FitFieldMargin = 1.25f;
+
+    struct Geometry
+    {
+        /// \brief Camera sensor resolution in the x direction.
+        int resx;
+
+        /// \brief Camera sensor resolution in the y direction.
+        int resy;
+
+        /// \brief Sensor width; sensor height is determined by the resolution.
+        float sensorWidth;
+
+        /// \brief Distance to the object plane in focus; zero means infinity.
+        float focusingDistance;
+
+        /// \brief Total degree of the lens polynomial.
+        int degree;
+
+        Geometry() :
+            resx(1600),
+            resy(900),
+            sensorWidth(0.036f),
+            focusingDistance(0.f),
+            degree(LensPolynomial::DefaultDegree)
+        {}
+
+        float sensorHeight() const {
+            return sensorWidth * resy / resx;
+        }
+    };
+
+    void clear();
+
+    Primitive::Ptr cameraPrimitive() const;
+
+    const Canvas& canvas() const;
+    Canvas& canvas();
+
+    SurfaceProperties::Ptr makeSurfaceProperties(Canvas& canvas) const;
+
+    void read(const QVariant &v);
+
+    const Geometry& geometry() const;
+    void setGeometry(const Geometry& geometry);
+
+    const LensPrescription& lens() const;
+    void setLens(const LensPrescription& lens);
+
+    /// \brief Returns the lens polynomial fitted in clear().
+    const LensPolynomial& polynomial() const;
+
+private:
+    Primitive::Ptr m_primitive;
+    Geometry m_geometry;
+    LensPrescription m_lens;
+    LensPolynomial m_polynomial;
+    Canvas m_canvas;
+};
+
+} // end namespace raytracer
+
+#endif // POLYNOMIAL_LENS_CAMERA_H
@@ -0,0 +1,143 @@
+/// \file
+/// \brief Implementation of the PreviewRenderer class.
+
+#include "preview_renderer.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+
+namespace raytracer {
+
+namespace {
+
+// Averages blocks of factor x factor pixels; blocks at the right and bottom edges may be smaller
+Camera::Canvas downsample(const Camera::Canvas& canvas, int factor)
+{
+    const v2i& size = canvas.size();
+    auto resultSize = mkv2i((size[0] + factor - 1) / factor, (size[1] + factor - 1) / factor);
+    auto result = Camera::Canvas::uninitialized(resultSize);
+    WorkerPool::instance().run(resultSize[1], [&](int y) {
+        int y0 = y*factor;
+        int y1 = std::min(y0 + factor, size[1]);
+        for (int x=0; x<resultSize[0]; ++x) {
+            int x0 = x*factor;
+            int x1 = std::min(x0 + factor, size[0]);
+            v3f sum = fsmx::zero<v3f>();
+            for (int sy=y0; sy<y1; ++sy)
+                for (int sx=x0; sx<x1; ++sx)
+                    sum += canvas[mkv2i(sx, sy)];
+            result[mkv2i(x, y)] = sum / static_cast<float>((x1-x0)*(y1-y0));
+        }
+    });
+    return result;
+}
+
+} // anonymous namespace
+
+PreviewRenderer::PreviewRenderer() :
+    m_snapshotEpoch(0),
+    m_imageProcessorChanged(false),
+    m_previewEpoch(0),
+    m_takenPreviewEpoch(0),
+    m_stopRequested(false)
+{
+}
+
+PreviewRenderer::~PreviewRenderer()
+{
+    stop();
+}
+
+void PreviewRenderer::setImageProcessor(const ImageProcessor::Ptr& imageProcessor)
+{
+    QMutexLocker lock(&m_mutex);
+    m_imageProcessor = imageProcessor;
+    m_imageProcessorChanged = true;
+}
+
+void PreviewRenderer::setPreviewSize(const QSize& size)
+{
+    QMutexLocker lock(&m_mutex);
+    m_previewSize = size;
+}
+
+void PreviewRenderer::publish(const Camera::Canvas& canvas)
+{
+    // Copy the canvas without blocking the renderer, then swap buffers
+    QMutexLocker publishLock(&m_publishMutex);
+    m_backBuffer = canvas;
+    QMutexLocker lock(&m_mutex);
+    std::swap(m_backBuffer, m_pendingSnapshot);
+    ++m_snapshotEpoch;
+    m_snapshotPublished.wakeAll();
+}
+
+bool PreviewRenderer::takePreview(QImage& image)
+{
+    QMutexLocker lock(&m_mutex);
+    if (m_previewEpoch == m_takenPreviewEpoch)
+        return false;
+    image = m_preview;
+    m_takenPreviewEpoch = m_previewEpoch;
+    return true;
+}
+
+void PreviewRenderer::stop()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stopRequested = true;
+        m_snapshotPublished.wakeAll();
+    }
+    wait();
+}
+
+void PreviewRenderer::run()
+{
+    Camera::Canvas snapshot;
+    quint64 processedEpoch = 0;
+    CanvasImageConverter converter;
+    forever {
+        ImageProcessor::Ptr imageProcessor;
+        QSize previewSize;
+        {
+            QMutexLocker lock(&m_mutex);
+            while (!m_stopRequested   &&   m_snapshotEpoch == processedEpoch)
+                m_snapshotPublished.wait(&m_mutex);
+            if (m_stopRequested)
+                return;
+            std::swap(snapshot, m_pendingSnapshot);
+            processedEpoch = m_snapshotEpoch;
+            imageProcessor = m_imageProcessor;
+            previewSize = m_previewSize;
+            if (m_imageProcessorChanged) {
+                converter.reset();
+                m_imageProcessorChanged = false;
+            }
+        }
+
+        QImage image;
+        try {
+            auto canvas = imageProcessor ?   (*imageProcessor)(snapshot) :   snapshot;
+            const v2i& size = canvas.size();
+            if (!previewSize.isEmpty()) {
+                int factor = std::max(
+                            (size[0] + previewSize.width() - 1) / previewSize.width(),
+                            (size[1] + previewSize.height() - 1) / previewSize.height());
+                if (factor > 1)
+                    canvas = downsample(canvas, factor);
+            }
+            image = converter.update(canvas);
+        }
+        catch (const std::exception&) {
+            // Skip the snapshot; the image processor is given the next one
+            continue;
+        }
+
+        QMutexLocker lock(&m_mutex);
+        m_preview = image;
+        ++m_previewEpoch;
+    }
+}
+
+} // end namespace raytracer
@@ -0,0 +1,71 @@
+/// \file
+/// \brief Declaration of the PreviewRenderer class.
+
+#ifndef PREVIEW_RENDERER_H
+#define PREVIEW_RENDERER_H
+
+#include "image_processor.h"
+#include "canvas_image_converter.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSize>
+
+namespace raytracer {
+
+/// \brief Thread turning canvas snapshots into preview images.
+///
+/// The ray tracing thread publishes snapshots of the canvas by calling publish(), which only
+/// copies the canvas into a back buffer and swaps it with the pending snapshot. The renderer
+/// thread applies the image processor to the latest snapshot, downsamples the result to fit
+/// the preview size, and converts it to an image incrementally (see CanvasImageConverter).
+/// Snapshots published while the renderer is busy replace each other, so the renderer never
+/// falls behind. The GUI thread takes ready images with takePreview(), e.g., on a timer.
+class PreviewRenderer : public QThread
+{
+public:
+    PreviewRenderer();
+
+    /// \brief Stops the thread.
+    ~PreviewRenderer();
+
+    void setImageProcessor(const ImageProcessor::Ptr& imageProcessor);
+
+    /// \brief Sets the size of preview images; larger canvases are downsampled by an integer
+    /// factor to fit in. An empty size means no downsampling.
+    void setPreviewSize(const QSize& size);
+
+    /// \brief Publishes a snapshot of \a canvas; may be called from any thread.
+    void publish(const Camera::Canvas& canvas);
+
+    /// \brief Sets \a image to the latest preview and returns true, if there is a preview
+    /// newer than the one taken previously; otherwise, returns false.
+    bool takePreview(QImage& image);
+
+    /// \brief Requests the thread to stop and waits for it.
+    void stop();
+
+protected:
+    void run();
+
+private:
+    QMutex m_publishMutex;
+    Camera::Canvas m_backBuffer;
+
+    QMutex m_mutex;
+    QWaitCondition m_snapshotPublished;
+    Camera::Canvas m_pendingSnapshot;
+    quint64 m_snapshotEpoch;
+    ImageProcessor::Ptr m_imageProcessor;
+    bool m_imageProcessorChanged;
+    QSize m_previewSize;
+    QImage m_preview;
+    quint64 m_previewEpoch;
+    quint64 m_takenPreviewEpoch;
+    bool m_stopRequested;
+};
+
+} // end namespace raytracer
+
+#endif // PREVIEW_RENDERER_H
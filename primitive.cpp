@@ -9,10 +9,23 @@
 namespace raytracer {
 
 Primitive::Primitive() :
-    m_transform(fsmx::identity<m4f>())
+    m_transform(fsmx::identity<m4f>()),
+    m_materialId(-1)
 {
 }
 
+float Primitive::area() const
+{
+    return 0.f;
+}
+
+void Primitive::surfaceSample(SurfacePoint& p, const v2f& uv) const
+{
+    Q_UNUSED(p);
+    Q_UNUSED(uv);
+    Q_ASSERT(false);
+}
+
 BoundingSphere Primitive::transformBoundingSphere(const BoundingSphere& bs) const
 {
     Q_ASSERT(!hasShear(affine(m_transform)));
@@ -44,6 +57,7 @@ void Primitive::setTransform(const m4f& transform)
 void Primitive::setSurfaceProperties(const SurfaceProperties::Ptr& surfaceProperties)
 {
     m_surfaceProperties = surfaceProperties;
+    m_materialId = -1;
 }
 
 SurfaceProperties::Ptr Primitive::surfaceProperties() const
@@ -51,6 +65,16 @@ SurfaceProperties::Ptr Primitive::surfaceProperties() const
     return m_surfaceProperties;
 }
 
+int Primitive::materialId() const
+{
+    return m_materialId;
+}
+
+void Primitive::setMaterialId(int materialId)
+{
+    m_materialId = materialId;
+}
+
 void Primitive::read(const QVariant& v)
 {
     using namespace std::placeholders;
@@ -58,6 +82,7 @@ void Primitive::read(const QVariant& v)
     m_name = QString();
     m_transform = fsmx::identity<m4f>();
     m_surfaceProperties.reset();
+    m_materialId = -1;
 
     QVariantMap m = safeVariantMap(v);
 
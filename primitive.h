@@ -40,6 +40,22 @@ public:
     /// transformBoundingSphere().
     virtual BoundingSphere boundingSphere() const = 0;
 
+    /// \brief Returns surface area of this primitive.
+    ///
+    /// \note Current transformation must be taken into account.
+    /// The default implementation returns zero, meaning that
+    /// the primitive does not support surface sampling.
+    virtual float area() const;
+
+    /// \brief Maps a point of the unit square onto the surface of this primitive.
+    ///
+    /// The mapping must preserve area up to a constant factor, so that
+    /// uniformly distributed \a uv produce uniformly distributed surface points.
+    /// Only called if area() returns a positive value.
+    /// \param p Surface point to be computed (position, outward normal, texture coordinates).
+    /// \param uv Point of the unit square [0, 1]x[0, 1].
+    virtual void surfaceSample(SurfacePoint& p, const v2f& uv) const;
+
     /// \brief Helper method to compute bounding sphere for transformed geometry.
     /// \param bs Bounding sphere for untransformed geometry.
     BoundingSphere transformBoundingSphere(const BoundingSphere &bs) const;
@@ -62,6 +78,15 @@ public:
     /// \brief Returns primitive surface properties
     SurfaceProperties::Ptr surfaceProperties() const;
 
+    /// \brief Returns index of primitive surface properties in the material table
+    /// compiled by the ray tracer, or -1 if the primitive has not been compiled.
+    int materialId() const;
+
+    /// \brief Sets index of primitive surface properties in the material table.
+    ///
+    /// \note Called by RayTracer::run().
+    void setMaterialId(int materialId);
+
     /// \brief Reads transformation and surface properties, if any
     void read(const QVariant& v);
 
@@ -69,6 +94,7 @@ private:
     QString m_name;
     m4f m_transform;
     SurfaceProperties::Ptr m_surfaceProperties;
+    int m_materialId;
 };
 
 } // end namespace raytracer
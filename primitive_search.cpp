@@ -1,8 +1,40 @@
 #include "primitive_search.h"
+#include "primitive.h"
+#include "bounding_sphere.h"
 #include "ray.h"
 
+#include <algorithm>
+
 namespace raytracer {
 
+namespace {
+
+// Returns direction corresponding to point (u, v) of the specified cube map face.
+// Face index is 2*axis + (1 if the direction along the axis is negative, 0 otherwise);
+// u and v are coordinates along the two other axes, in the range [-1, 1].
+v3f cubeMapDirection(int face, float u, float v)
+{
+    int axis = face >> 1;
+    v3f result;
+    result[axis] = (face & 1) ?   -1.f :   1.f;
+    result[(axis+1)%3] = u;
+    result[(axis+2)%3] = v;
+    return result / result.norm2();
+}
+
+bool sameOrigin(const v3f& a, const v3f& b)
+{
+    return a[0] == b[0]   &&   a[1] == b[1]   &&   a[2] == b[2];
+}
+
+float angleBetween(const v3f& a, const v3f& b)
+{
+    float c = dot(a, b);
+    return acos(c > 1.f ?   1.f :   c < -1.f ?   -1.f :   c);
+}
+
+} // anonymous namespace
+
 PrimitiveSearch::PrimitiveSearch()
 {
 }
@@ -14,12 +46,115 @@ void PrimitiveSearch::add(const Primitive *primitive)
     m_primitives.push_back(primitive);
 }
 
+void PrimitiveSearch::addOrigin(const v3f& origin, int resolution)
+{
+    Q_ASSERT(resolution > 0);
+    for (const OriginCache& cache : m_originCaches)
+        if (sameOrigin(cache.origin, origin))
+            return;
+    OriginCache cache;
+    cache.origin = origin;
+    cache.resolution = resolution;
+    cache.build(m_primitives);
+    m_originCaches.push_back(cache);
+}
+
+void PrimitiveSearch::replace(const Primitive *primitive, const Primitive *replacement)
+{
+    std::replace(m_primitives.begin(), m_primitives.end(), primitive, replacement);
+    for (OriginCache& cache : m_originCaches)
+        std::replace(cache.primitives.begin(), cache.primitives.end(), primitive, replacement);
+}
+
 PrimitiveSearch::PrimitiveSequenceRange PrimitiveSearch::find(const Ray& ray) const
 {
+    if (ray.generation == 0) {
+        for (const OriginCache& cache : m_originCaches) {
+            if (sameOrigin(cache.origin, ray.origin)) {
+                int texel = cache.texelIndex(ray.dir);
+                auto begin = cache.primitives.begin();
+                return PrimitiveSequenceRange(begin + cache.offsets[texel], begin + cache.offsets[texel+1]);
+            }
+        }
+    }
+
     // TODO
     // Note: This code is a stub
-    Q_UNUSED(ray);
     return PrimitiveSequenceRange(m_primitives.begin(), m_primitives.end());
 }
 
+void PrimitiveSearch::OriginCache::build(const std::vector<const Primitive*>& allPrimitives)
+{
+    // Bounding spheres relative to the origin
+    std::vector<BoundingSphere> spheres;
+    spheres.reserve(allPrimitives.size());
+    for (const Primitive *primitive : allPrimitives) {
+        BoundingSphere bs = primitive->boundingSphere();
+        bs.center -= origin;
+        spheres.push_back(bs);
+    }
+
+    offsets.clear();
+    primitives.clear();
+    offsets.reserve(6*resolution*resolution + 1);
+    offsets.push_back(0);
+    float texelSize = 2.f / resolution;
+    for (int face=0; face<6; ++face) {
+        for (int iv=0; iv<resolution; ++iv) {
+            float v0 = -1.f + iv*texelSize;
+            for (int iu=0; iu<resolution; ++iu) {
+                float u0 = -1.f + iu*texelSize;
+
+                // Cone of directions covered by the texel
+                v3f axis = cubeMapDirection(face, u0 + 0.5f*texelSize, v0 + 0.5f*texelSize);
+                float coneAngle = 0.f;
+                for (int corner=0; corner<4; ++corner)
+                    coneAngle = std::max(coneAngle, angleBetween(axis, cubeMapDirection(
+                        face, u0 + (corner&1)*texelSize, v0 + (corner>>1)*texelSize)));
+
+                // Select primitives whose bounding spheres intersect the cone
+                for (std::vector<BoundingSphere>::size_type i=0; i<spheres.size(); ++i) {
+                    const BoundingSphere& bs = spheres[i];
+                    float dist = bs.center.norm2();
+                    bool hit;
+                    if (dist <= bs.radius)
+                        hit = true;
+                    else {
+                        float sphereAngle = asin(bs.radius / dist);
+                        hit = angleBetween(axis, bs.center/dist) <= coneAngle + sphereAngle;
+                    }
+                    if (hit)
+                        primitives.push_back(allPrimitives[i]);
+                }
+                offsets.push_back(primitives.size());
+            }
+        }
+    }
+}
+
+int PrimitiveSearch::OriginCache::texelIndex(const v3f& dir) const
+{
+    // Find major axis
+    int axis = 0;
+    float a = fabs(dir[0]);
+    for (int i=1; i<3; ++i) {
+        float ai = fabs(dir[i]);
+        if (a < ai) {
+            a = ai;
+            axis = i;
+        }
+    }
+    if (a == 0.f)
+        return 0;
+    int face = (axis << 1) + (dir[axis] < 0.f ?   1 :   0);
+
+    // Project onto the face
+    float scale = 0.5f * resolution / a;
+    int iu = static_cast<int>((dir[(axis+1)%3] + a) * scale);
+    int iv = static_cast<int>((dir[(axis+2)%3] + a) * scale);
+    iu = std::min(std::max(iu, 0), resolution-1);
+    iv = std::min(std::max(iv, 0), resolution-1);
+    return (face*resolution + iv)*resolution + iu;
+}
+
 } // end namespace raytracer
@@ -16,6 +16,9 @@ class Primitive;
 class PrimitiveSearch
 {
 public:
+    /// \brief Default number of cube map texels along each side of a face in an origin cache.
+    enum { DefaultOriginCacheResolution = 32 };
+
     /// \brief Default constructor.
     PrimitiveSearch();
 
@@ -23,6 +26,22 @@ public:
     /// \param primitive Pointer to primitive to add.
     void add(const Primitive *primitive);
 
+    /// \brief Registers a fixed origin shared by all rays of generation zero emitted from it.
+    ///
+    /// A direction-indexed cache is built for the origin: a cube map whose texels
+    /// hold the primitives whose bounding spheres intersect the texel's cone of directions.
+    /// find() then returns just these primitives for rays of generation zero starting at \a origin.
+    /// \note The cache only takes into account primitives added before this call,
+    /// so all primitives must be added first; the search structure has to be re-created
+    /// when the scene changes.
+    /// \param origin Ray origin, e.g., the position of a point light.
+    /// \param resolution Number of texels along each side of a cube map face.
+    void addOrigin(const v3f& origin, int resolution = DefaultOriginCacheResolution);
+
+    /// \brief Replaces \a primitive with \a replacement, keeping the search structure.
+    /// \note \a replacement must have the same bounding sphere as \a primitive.
+    void replace(const Primitive *primitive, const Primitive *replacement);
+
     /// \brief Iterator for a sequence of primitives.
     ///
     /// \todo Redefine if necessary.
@@ -38,6 +57,19 @@ public:
 
 private:
     std::vector<const Primitive*> m_primitives;
+
+    /// \brief Cube map of candidate primitives for rays starting at a fixed origin.
+    struct OriginCache
+    {
+        v3f origin;                                     ///< \brief Origin shared by the rays.
+        int resolution;                                 ///< \brief Texels along each side of a face.
+        std::vector< std::vector<const Primitive*>::size_type > offsets;   ///< \brief Texel ranges in #primitives, 6*resolution^2+1 elements.
+        std::vector<const Primitive*> primitives;       ///< \brief Candidate primitives of all texels.
+
+        void build(const std::vector<const Primitive*>& allPrimitives);
+        int texelIndex(const v3f& dir) const;
+    };
+    std::vector<OriginCache> m_originCaches;
 };
 
 } // end namespace raytracer
@@ -54,6 +54,24 @@ BoundingSphere SingleSidedRectangle::boundingSphere() const
 
 }
 
+float SingleSidedRectangle::area() const
+{
+    float sf = scalingFactor(affine(transform()));
+    return m_width*m_height*sf*sf;
+}
+
+void SingleSidedRectangle::surfaceSample(SurfacePoint& p, const v2f& uv) const
+{
+    auto& T = transform();
+    auto A = affine(T);
+    float tex1 = 2.f*uv[0] - 1.f;
+    float tex2 = 2.f*uv[1] - 1.f;
+    auto n = A.constCol(2);
+    sppos(p) = translation(T) + A.constCol(0)*(0.5f*m_width*tex1) + A.constCol(1)*(0.5f*m_height*tex2);
+    spnormal(p) = n / n.norm2();
+    sptex(p) = mkv2f(tex1, tex2);
+}
+
 void SingleSidedRectangle::read(const QVariant& v)
 {
     Primitive::read(v);
@@ -1,6 +1,7 @@
 #include "sphere.h"
 #include "bounding_sphere.h"
 #include "ray.h"
+#include "math_util.h"
 
 namespace raytracer {
 
@@ -37,7 +38,9 @@ bool Sphere::collisionTest(float& rayParam, SurfacePoint& p, const Ray& ray) con
     sppos(p) = pos;
     auto n = pos - center;
     spnormal(p) = n / n.norm2();
-    sptex(p) = mkv2f(0.f, 0.f);  // TODO
+    // Nothing reads texture coordinates of sphere hits yet; when something does,
+    // compute them lazily from the normal with fastAtan(), as surfaceSample() defines them
+    sptex(p) = mkv2f(0.f, 0.f);
     return true;
 }
 
@@ -47,6 +50,28 @@ BoundingSphere Sphere::boundingSphere() const
             BoundingSphere(m_radius));
 }
 
+float Sphere::area() const
+{
+    float radius = m_radius * scalingFactor(affine(transform()));
+    return static_cast<float>(4*M_PI) * radius*radius;
+}
+
+void Sphere::surfaceSample(SurfacePoint& p, const v2f& uv) const
+{
+    auto& T = transform();
+    auto A = affine(T);
+    float sf = scalingFactor(A);
+    float z = 1.f - 2.f*uv[0];
+    float phi = static_cast<float>(M_PI) * (2.f*uv[1] - 1.f);
+    float r = sqrt(std::max(0.f, 1.f - z*z));
+    float x = r*static_cast<float>(cos(phi));
+    float y = r*static_cast<float>(sin(phi));
+    v3f n = (A.constCol(0)*x + A.constCol(1)*y + A.constCol(2)*z) / sf;
+    sppos(p) = translation(T) + (m_radius*sf)*n;
+    spnormal(p) = n;
+    sptex(p) = mkv2f(acos(std::max(-1.f, std::min(1.f, z))), phi);
+}
+
 void Sphere::read(const QVariant& v)
 {
     Primitive::read(v);
@@ -14,6 +14,8 @@ public:
 
     bool collisionTest(float &rayParam, SurfacePoint& p, const Ray& ray) const;
     BoundingSphere boundingSphere() const;
+    float area() const;
+    void surfaceSample(SurfacePoint& p, const v2f& uv) const;
 
     void read(const QVariant& v);
 
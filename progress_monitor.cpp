@@ -0,0 +1,61 @@
+/// \file
+/// \brief Implementation of the ProgressMonitor class.
+
+#include "progress_monitor.h"
+
+namespace raytracer {
+
+ProgressMonitor::ProgressMonitor(int msecInterval) :
+    m_msecInterval(msecInterval),
+    m_reportRequested(false),
+    m_stopRequested(false)
+{
+}
+
+ProgressMonitor::~ProgressMonitor()
+{
+    stop();
+}
+
+ProgressMonitor::Counter& ProgressMonitor::addCounter()
+{
+    Q_ASSERT(!isRunning());
+    m_counters.emplace_back();
+    return m_counters.back();
+}
+
+quint64 ProgressMonitor::total() const
+{
+    quint64 result = 0;
+    for (const auto& counter : m_counters)
+        result += counter.value();
+    return result;
+}
+
+void ProgressMonitor::stop()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stopRequested = true;
+        m_stopRequestedCondition.wakeAll();
+    }
+    wait();
+}
+
+void ProgressMonitor::run()
+{
+    quint64 lastTotal = total();
+    QMutexLocker lock(&m_mutex);
+    forever {
+        m_stopRequestedCondition.wait(&m_mutex, m_msecInterval);
+        if (m_stopRequested)
+            return;
+        quint64 currentTotal = total();
+        if (currentTotal != lastTotal) {
+            lastTotal = currentTotal;
+            m_reportRequested.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+} // end namespace raytracer
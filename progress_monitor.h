@@ -0,0 +1,83 @@
+/// \file
+/// \brief Declaration of the ProgressMonitor class.
+
+#ifndef PROGRESS_MONITOR_H
+#define PROGRESS_MONITOR_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <deque>
+
+namespace raytracer {
+
+/// \brief Thread deciding when progress of worker threads is to be reported.
+///
+/// Each worker thread counts processed items (e.g., rays) in a counter of its own
+/// (see addCounter()) that only it writes; a relaxed atomic store costs as much as
+/// an ordinary one, and counters of different threads do not share cache lines.
+/// The monitor thread wakes up once per interval, sums the counters, and, if the total
+/// has changed, raises the report request flag. Workers check the flag between batches
+/// of items with a relaxed load (see takeReportRequest()) and report progress themselves,
+/// when their data is consistent.
+class ProgressMonitor : public QThread
+{
+public:
+    /// \brief Counter of items processed by one worker thread.
+    ///
+    /// Counters take a cache line each. Allocators of C++11 may ignore the alignment,
+    /// but values of adjacent counters are still 64 bytes apart and never share a line.
+    class alignas(64) Counter
+    {
+    public:
+        Counter() : m_value(0) {}
+        void set(quint64 value) {
+            m_value.store(value, std::memory_order_relaxed);
+        }
+        quint64 value() const {
+            return m_value.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<quint64> m_value;
+    };
+
+    explicit ProgressMonitor(int msecInterval);
+
+    /// \brief Stops the thread.
+    ~ProgressMonitor();
+
+    /// \brief Adds a counter; must be called before the thread is started.
+    Counter& addCounter();
+
+    /// \brief Returns the sum of all counters.
+    quint64 total() const;
+
+    /// \brief Returns true if progress is to be reported, and clears the request.
+    ///
+    /// When several threads call it, only one of them gets true for each request.
+    bool takeReportRequest() {
+        return m_reportRequested.load(std::memory_order_relaxed)   &&
+               m_reportRequested.exchange(false, std::memory_order_relaxed);
+    }
+
+    /// \brief Requests the thread to stop and waits for it.
+    void stop();
+
+protected:
+    void run();
+
+private:
+    int m_msecInterval;
+    std::deque<Counter> m_counters;
+    std::atomic<bool> m_reportRequested;
+    QMutex m_mutex;
+    QWaitCondition m_stopRequestedCondition;
+    bool m_stopRequested;
+};
+
+} // end namespace raytracer
+
+#endif // PROGRESS_MONITOR_H
@@ -35,6 +35,14 @@ struct Ray
     {}
 };
 
+/// \brief Properties of the surface a ray leaves, recorded by cameras to guide the denoiser
+/// (see RayTracer::Options::featureCanvases).
+struct SurfaceFeatures
+{
+    v3f normal;         ///< \brief Unit normal on the side the ray leaves.
+    v3f albedo;         ///< \brief Surface color.
+};
+
 } // end namespace raytracer
 
 #endif // RAY_H
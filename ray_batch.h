@@ -0,0 +1,94 @@
+#ifndef RAY_BATCH_H
+#define RAY_BATCH_H
+
+/// \file
+/// \brief Definition of the RayBatch data structure.
+
+#include "ray.h"
+#include <vector>
+
+namespace raytracer {
+
+/// \brief Structure-of-arrays buffer of rays emitted by a light source.
+///
+/// Light sources fill the buffer in LightSource::emitRayBatch(); the ray tracer
+/// consumes it in RayTracer::processRayBatch(). Each ray component is stored in
+/// its own contiguous array, so that sampling loops can be vectorized.
+/// All rays in a batch are of generation zero.
+class RayBatch
+{
+public:
+    /// \brief Default number of rays in a batch.
+    enum { DefaultSize = 4096 };
+
+    /// \brief Constructor.
+    /// \param size Initial number of rays in the batch.
+    explicit RayBatch(int size = 0) : m_size(0) {
+        resize(size);
+    }
+
+    /// \brief Returns the number of rays in the batch.
+    int size() const { return m_size; }
+
+    /// \brief Sets the number of rays in the batch; existing ray data are not preserved.
+    void resize(int size) {
+        Q_ASSERT(size >= 0);
+        m_size = size;
+        for (auto& a : m_data)
+            a.resize(size);
+    }
+
+    float *originX() { return m_data[0].data(); }   ///< \brief Array of ray origin x coordinates.
+    float *originY() { return m_data[1].data(); }   ///< \brief Array of ray origin y coordinates.
+    float *originZ() { return m_data[2].data(); }   ///< \brief Array of ray origin z coordinates.
+    float *dirX() { return m_data[3].data(); }      ///< \brief Array of ray direction x coordinates.
+    float *dirY() { return m_data[4].data(); }      ///< \brief Array of ray direction y coordinates.
+    float *dirZ() { return m_data[5].data(); }      ///< \brief Array of ray direction z coordinates.
+    float *red() { return m_data[6].data(); }       ///< \brief Array of ray color red components.
+    float *green() { return m_data[7].data(); }     ///< \brief Array of ray color green components.
+    float *blue() { return m_data[8].data(); }      ///< \brief Array of ray color blue components.
+
+    /// \brief Sets origins of rays in the range [\a begin, \a end) to \a origin.
+    void fillOrigin(int begin, int end, const v3f& origin) {
+        fill(0, begin, end, origin);
+    }
+
+    /// \brief Sets colors of rays in the range [\a begin, \a end) to \a color.
+    void fillColor(int begin, int end, const v3f& color) {
+        fill(6, begin, end, color);
+    }
+
+    /// \brief Sets ray with index \a index.
+    void setRay(int index, const v3f& origin, const v3f& dir, const v3f& color) {
+        Q_ASSERT(index >= 0   &&   index < m_size);
+        for (int i=0; i<3; ++i) {
+            m_data[i][index] = origin[i];
+            m_data[3+i][index] = dir[i];
+            m_data[6+i][index] = color[i];
+        }
+    }
+
+    /// \brief Returns ray with index \a index.
+    Ray ray(int index) const {
+        Q_ASSERT(index >= 0   &&   index < m_size);
+        return Ray(
+            mkv3f(m_data[0][index], m_data[1][index], m_data[2][index]),
+            mkv3f(m_data[3][index], m_data[4][index], m_data[5][index]),
+            mkv3f(m_data[6][index], m_data[7][index], m_data[8][index]),
+            0);
+    }
+
+private:
+    int m_size;
+    std::vector<float> m_data[9];
+
+    void fill(int firstArray, int begin, int end, const v3f& v) {
+        Q_ASSERT(begin >= 0   &&   begin <= end   &&   end <= m_size);
+        for (int i=0; i<3; ++i)
+            std::fill(m_data[firstArray+i].begin()+begin, m_data[firstArray+i].begin()+end, v[i]);
+    }
+};
+
+} // end namespace raytracer
+
+#endif // RAY_BATCH_H
@@ -0,0 +1,164 @@
+/// \file
+/// \brief Implementation of the RayDataWriter class.
+
+#include "ray_data_writer.h"
+#include "cxx_exception.h"
+
+#include <QFileInfo>
+#include <QThread>
+
+#include <cstring>
+
+namespace raytracer {
+
+class RayDataWriter::WriterThread : public QThread
+{
+public:
+    explicit WriterThread(RayDataWriter& writer) : m_writer(writer) {}
+
+protected:
+    void run()
+    {
+        RayDataWriter& w = m_writer;
+        forever {
+            int block;
+            {
+                QMutexLocker lock(&w.m_mutex);
+                while (w.m_filledBlocks.empty()   &&   !w.m_closing)
+                    w.m_blockFilled.wait(&w.m_mutex);
+                if (w.m_filledBlocks.empty())
+                    // Closing, and all data is written
+                    return;
+                block = w.m_filledBlocks.front();
+                w.m_filledBlocks.pop_front();
+            }
+
+            // Write the block without holding the mutex; after an error,
+            // blocks are only recycled
+            qint64 size = w.m_blockSizes[block];
+            bool ok = w.m_error.isEmpty()   &&
+                    w.m_file.write(w.m_blocks[block].data(), size) == size;
+
+            {
+                QMutexLocker lock(&w.m_mutex);
+                if (!ok   &&   w.m_error.isEmpty())
+                    w.m_error = QString("Failed to write rays output '%1'").arg(QFileInfo(w.m_fileName).absoluteFilePath());
+                w.m_blockSizes[block] = 0;
+                w.m_freeBlocks.push_back(block);
+                w.m_blockFreed.wakeAll();
+            }
+        }
+    }
+
+private:
+    RayDataWriter& m_writer;
+};
+
+
+
+RayDataWriter::RayDataWriter(const QString& fileName, int blockSize, int blockCount) :
+    m_fileName(fileName),
+    m_blockSize(blockSize),
+    m_blocks(blockCount, std::vector<char>(blockSize)),
+    m_blockSizes(blockCount, 0),
+    m_currentBlock(-1),
+    m_closing(false)
+{
+    Q_ASSERT(blockSize > 0   &&   blockCount > 1);
+    QFileInfo fi(fileName);
+    if (fi.exists())
+        throw cxx::exception(std::string("Rays output file '") + fi.absoluteFilePath().toStdString() + "' already exists");
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        throw cxx::exception(std::string("Failed to open rays output '") + fi.absoluteFilePath().toStdString() + "'");
+    for (int i=blockCount-1; i>=0; --i)
+        m_freeBlocks.push_back(i);
+    m_thread.reset(new WriterThread(*this));
+    m_thread->start();
+}
+
+RayDataWriter::~RayDataWriter()
+{
+    try {
+        close();
+    }
+    catch (const std::exception&) {
+    }
+}
+
+void RayDataWriter::write(const char *data, int size)
+{
+    Q_ASSERT(size <= m_blockSize);
+    QMutexLocker lock(&m_mutex);
+    checkError();
+    checkNotClosed();
+
+    // Data of one call is never split between blocks, so that data written
+    // concurrently by other threads can not get in between
+    if (m_currentBlock >= 0   &&   m_blockSizes[m_currentBlock] + size > m_blockSize)
+        submitCurrentBlock();
+    while (m_currentBlock < 0) {
+        if (m_freeBlocks.empty()) {
+            // Wait for the background thread to release a block (back-pressure);
+            // another caller may have taken the block meanwhile, so check again
+            m_blockFreed.wait(&m_mutex);
+            checkNotClosed();
+            if (m_currentBlock >= 0   &&   m_blockSizes[m_currentBlock] + size > m_blockSize)
+                submitCurrentBlock();
+            continue;
+        }
+        m_currentBlock = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+    }
+    int& used = m_blockSizes[m_currentBlock];
+    std::memcpy(m_blocks[m_currentBlock].data() + used, data, size);
+    used += size;
+    if (used == m_blockSize)
+        submitCurrentBlock();
+}
+
+void RayDataWriter::close()
+{
+    if (!m_thread)
+        return;
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_currentBlock >= 0   &&   m_blockSizes[m_currentBlock] > 0)
+            submitCurrentBlock();
+        m_closing = true;
+        m_blockFilled.wakeAll();
+    }
+    m_thread->wait();
+    m_thread.reset();
+    m_file.close();
+
+    QMutexLocker lock(&m_mutex);
+    checkError();
+}
+
+QString RayDataWriter::fileName() const
+{
+    return m_fileName;
+}
+
+void RayDataWriter::submitCurrentBlock()
+{
+    m_filledBlocks.push_back(m_currentBlock);
+    m_currentBlock = -1;
+    m_blockFilled.wakeOne();
+}
+
+void RayDataWriter::checkError() const
+{
+    if (!m_error.isEmpty())
+        throw cxx::exception(m_error.toStdString());
+}
+
+void RayDataWriter::checkNotClosed() const
+{
+    // The background thread exits once closing, so data written now would be lost
+    if (m_closing)
+        throw cxx::exception(std::string("Rays output '") + QFileInfo(m_fileName).absoluteFilePath().toStdString() + "' is written after it is closed");
+}
+
+} // end namespace raytracer
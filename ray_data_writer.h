@@ -0,0 +1,85 @@
+/// \file
+/// \brief Declaration of the RayDataWriter class.
+
+#ifndef RAY_DATA_WRITER_H
+#define RAY_DATA_WRITER_H
+
+#include <QString>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <memory>
+#include <deque>
+#include <vector>
+
+namespace raytracer {
+
+/// \brief Writes a stream of data to a file asynchronously.
+///
+/// Data passed to write() is copied to large memory blocks; filled blocks are
+/// written to the file by a background thread. The number of blocks is fixed,
+/// so when the file can not be written as fast as data comes, write()
+/// waits until the background thread releases a block (back-pressure).
+/// All methods are thread-safe.
+class RayDataWriter
+{
+public:
+    static const int DefaultBlockSize = 4 << 20;
+    static const int DefaultBlockCount = 3;
+
+    /// \brief Creates file \a fileName and starts the background thread.
+    ///
+    /// Throws an exception if the file already exists or can not be opened.
+    explicit RayDataWriter(
+            const QString& fileName,
+            int blockSize = DefaultBlockSize,
+            int blockCount = DefaultBlockCount);
+
+    /// \brief Calls close(); errors are ignored.
+    ~RayDataWriter();
+
+    /// \brief Appends \a size bytes at \a data to the file.
+    ///
+    /// Data written by one call is never interleaved with data written by other threads;
+    /// \a size must not exceed the block size.
+    /// Throws an exception if the background thread has failed to write data,
+    /// or if the writer is closed.
+    void write(const char *data, int size);
+
+    /// \brief Writes all pending data, stops the background thread, and closes the file.
+    ///
+    /// Throws an exception if the background thread has failed to write data.
+    void close();
+
+    QString fileName() const;
+
+private:
+    class WriterThread;
+    friend class WriterThread;
+
+    QString m_fileName;
+    QFile m_file;
+    int m_blockSize;
+
+    std::vector< std::vector<char> > m_blocks;
+    std::vector<int> m_blockSizes;
+    std::vector<int> m_freeBlocks;
+    std::deque<int> m_filledBlocks;
+    int m_currentBlock;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_blockFreed;
+    QWaitCondition m_blockFilled;
+    bool m_closing;
+    QString m_error;
+    std::unique_ptr<WriterThread> m_thread;
+
+    void submitCurrentBlock();
+    void checkError() const;
+    void checkNotClosed() const;
+};
+
+} // end namespace raytracer
+
+#endif // RAY_DATA_WRITER_H
@@ -0,0 +1,297 @@
+/// \file
+/// \brief Implementation of the RayFileFormat structure.
+
+#include "ray_file_format.h"
+#include "math_util.h"
+#include "cxx_exception.h"
+
+#include <QByteArray>
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace raytracer {
+
+namespace {
+
+const char HeaderMagic[8] = { 'R', 'A', 'Y', 'D', 'U', 'M', 'P', 0 };
+const char ChunkMagic[4] = { 'R', 'C', 'H', 'K' };
+const char FooterMagic[8] = { 'R', 'A', 'Y', 'I', 'N', 'D', 'E', 'X' };
+
+const int ChunkCompressionLevel = 1;
+
+void copyString(char *dst, int size, const QString& s)
+{
+    std::string bytes = s.toStdString();
+    std::memset(dst, 0, size);
+    std::memcpy(dst, bytes.data(), std::min(static_cast<int>(bytes.size()), size-1));
+}
+
+void copyVector(float *dst, const v3f& v)
+{
+    for (int i=0; i<3; ++i)
+        dst[i] = v[i];
+}
+
+// Appends column of values obtained by getter for each record to the payload
+template< class T, class Getter >
+inline char *writeColumn(char *dst, const RayFileFormat::EncodedRecord *records, int count, Getter get)
+{
+    for (int i=0; i<count; ++i, dst+=sizeof(T)) {
+        T x = get(records[i]);
+        std::memcpy(dst, &x, sizeof(T));
+    }
+    return dst;
+}
+
+template< class T, class Setter >
+inline const char *readColumn(const char *src, RayFileFormat::EncodedRecord *records, int count, Setter set)
+{
+    for (int i=0; i<count; ++i, src+=sizeof(T)) {
+        T x;
+        std::memcpy(&x, src, sizeof(T));
+        set(records[i], x);
+    }
+    return src;
+}
+
+inline float signNotZero(float x) {
+    return x >= 0.f ?   1.f :   -1.f;
+}
+
+} // anonymous namespace
+
+static_assert(sizeof(RayFileFormat::Header) == 280, "Unexpected size of RayFileFormat::Header");
+static_assert(sizeof(RayFileFormat::ChunkHeader) == 16, "Unexpected size of RayFileFormat::ChunkHeader");
+static_assert(sizeof(RayFileFormat::IndexEntry) == 16, "Unexpected size of RayFileFormat::IndexEntry");
+static_assert(sizeof(RayFileFormat::Footer) == 32, "Unexpected size of RayFileFormat::Footer");
+
+RayFileFormat::Header::Header()
+{
+    std::memset(this, 0, sizeof(*this));
+    std::memcpy(magic, HeaderMagic, sizeof(magic));
+    version = Version;
+    headerSize = sizeof(Header);
+    chunkRecordCount = DefaultChunkRecordCount;
+    setCameraTransform(fsmx::identity<m4f>());
+    screenNormal[2] = 1.f;
+}
+
+bool RayFileFormat::Header::isValid() const
+{
+    return std::memcmp(magic, HeaderMagic, sizeof(magic)) == 0;
+}
+
+void RayFileFormat::Header::setCameraType(const QString& type)
+{
+    copyString(cameraType, sizeof(cameraType), type);
+}
+
+void RayFileFormat::Header::setCameraName(const QString& name)
+{
+    copyString(cameraName, sizeof(cameraName), name);
+}
+
+void RayFileFormat::Header::setCameraTransform(const m4f& transform)
+{
+    std::copy(transform.data().data(), transform.data().data()+16, cameraTransform);
+}
+
+m4f RayFileFormat::Header::cameraTransformMatrix() const
+{
+    m4f result;
+    std::copy(cameraTransform, cameraTransform+16, result.data().data());
+    return result;
+}
+
+void RayFileFormat::Header::setScreen(const m4f& rectangleTransform, float width, float height)
+{
+    m3f A = affine(rectangleTransform);
+    v3f n = A.col(2);
+    n /= n.norm2();
+    copyVector(screenOrigin, translation(rectangleTransform));
+    copyVector(screenAxisX, A.col(0) * (0.5f*width));
+    copyVector(screenAxisY, A.col(1) * (0.5f*height));
+    copyVector(screenNormal, n);
+}
+
+
+
+RayFileFormat::ChunkHeader::ChunkHeader() :
+    recordCount(0),
+    flags(0),
+    payloadSize(0)
+{
+    std::memcpy(magic, ChunkMagic, sizeof(magic));
+}
+
+bool RayFileFormat::ChunkHeader::isValid() const
+{
+    return std::memcmp(magic, ChunkMagic, sizeof(magic)) == 0;
+}
+
+
+
+RayFileFormat::Footer::Footer() :
+    indexOffset(0),
+    recordCount(0),
+    chunkCount(0),
+    reserved(0)
+{
+    std::memcpy(magic, FooterMagic, sizeof(magic));
+}
+
+bool RayFileFormat::Footer::isValid() const
+{
+    return std::memcmp(magic, FooterMagic, sizeof(magic)) == 0;
+}
+
+
+
+RayFileFormat::EncodedRecord RayFileFormat::encode(const Ray& ray, const SurfacePoint& surfacePoint)
+{
+    EncodedRecord result;
+    auto tex = sptex(surfacePoint);
+    for (int i=0; i<2; ++i) {
+        float t = std::max(0.f, std::min(1.f, 0.5f*(tex[i] + 1.f)));
+        result.tex[i] = static_cast<quint16>(t*65535.f + 0.5f);
+    }
+    octEncode(ray.dir, result.dir);
+    result.dist = dot(v3f(sppos(surfacePoint)) - ray.origin, ray.dir);
+    for (int i=0; i<3; ++i)
+        result.color[i] = floatToHalf(ray.color[i]);
+    result.generation = static_cast<quint8>(std::max(0, std::min(255, ray.generation)));
+    return result;
+}
+
+RayFileFormat::Record RayFileFormat::decode(const Header& header, const EncodedRecord& record)
+{
+    Record result;
+    float u = record.tex[0]*(2.f/65535.f) - 1.f;
+    float v = record.tex[1]*(2.f/65535.f) - 1.f;
+    v3f pos;
+    for (int i=0; i<3; ++i)
+        pos[i] = header.screenOrigin[i] + u*header.screenAxisX[i] + v*header.screenAxisY[i];
+    result.surfacePoint = surfacePoint(
+                pos[0], pos[1], pos[2],
+                header.screenNormal[0], header.screenNormal[1], header.screenNormal[2],
+                u, v);
+    Ray& ray = result.ray;
+    ray.dir = octDecode(record.dir);
+    ray.origin = pos - record.dist*ray.dir;
+    for (int i=0; i<3; ++i)
+        ray.color[i] = halfToFloat(record.color[i]);
+    ray.generation = record.generation;
+    return result;
+}
+
+void RayFileFormat::octEncode(const v3f& v, qint16 *e)
+{
+    float invL1 = 1.f / (std::fabs(v[0]) + std::fabs(v[1]) + std::fabs(v[2]));
+    float x = v[0]*invL1, y = v[1]*invL1;
+    if (v[2] < 0.f) {
+        float x1 = (1.f - std::fabs(y)) * signNotZero(x);
+        y = (1.f - std::fabs(x)) * signNotZero(y);
+        x = x1;
+    }
+    e[0] = static_cast<qint16>(std::round(std::max(-1.f, std::min(1.f, x)) * 32767.f));
+    e[1] = static_cast<qint16>(std::round(std::max(-1.f, std::min(1.f, y)) * 32767.f));
+}
+
+v3f RayFileFormat::octDecode(const qint16 *e)
+{
+    // Unfold the lower hemisphere without branches, as the sign of z is unpredictable
+    float x = e[0] * (1.f/32767.f), y = e[1] * (1.f/32767.f);
+    float z = 1.f - std::fabs(x) - std::fabs(y);
+    float t = std::max(-z, 0.f);
+    x -= std::copysign(t, x);
+    y -= std::copysign(t, y);
+    float invLength = 1.f / std::sqrt(x*x + y*y + z*z);
+    return mkv3f(x*invLength, y*invLength, z*invLength);
+}
+
+void RayFileFormat::encodeChunk(
+        const EncodedRecord *records,
+        int count,
+        bool compress,
+        std::vector<char>& chunk)
+{
+    typedef EncodedRecord R;
+    const int payloadSize = count*RecordSize;
+    chunk.resize(sizeof(ChunkHeader) + payloadSize);
+    char *d = chunk.data() + sizeof(ChunkHeader);
+    for (int i=0; i<2; ++i)
+        d = writeColumn<quint16>(d, records, count, [i](const R& r) { return r.tex[i]; });
+    for (int i=0; i<2; ++i)
+        d = writeColumn<qint16>(d, records, count, [i](const R& r) { return r.dir[i]; });
+    d = writeColumn<float>(d, records, count, [](const R& r) { return r.dist; });
+    for (int i=0; i<3; ++i)
+        d = writeColumn<quint16>(d, records, count, [i](const R& r) { return r.color[i]; });
+    d = writeColumn<quint8>(d, records, count, [](const R& r) { return r.generation; });
+    Q_ASSERT(d == chunk.data() + chunk.size());
+
+    ChunkHeader h;
+    h.recordCount = count;
+    h.payloadSize = payloadSize;
+    if (compress) {
+        QByteArray compressed = qCompress(
+                    reinterpret_cast<const uchar*>(chunk.data() + sizeof(ChunkHeader)),
+                    payloadSize, ChunkCompressionLevel);
+        if (compressed.size() < payloadSize) {
+            h.flags |= Compressed;
+            h.payloadSize = compressed.size();
+            chunk.resize(sizeof(ChunkHeader) + compressed.size());
+            std::memcpy(chunk.data() + sizeof(ChunkHeader), compressed.constData(), compressed.size());
+        }
+    }
+    std::memcpy(chunk.data(), &h, sizeof(h));
+}
+
+void RayFileFormat::decodeChunk(
+        const Header& header,
+        const char *chunk,
+        quint64 size,
+        std::vector<Record>& records)
+{
+    ChunkHeader h;
+    if (size < sizeof(h))
+        throw cxx::exception("Rays input is corrupt: truncated chunk");
+    std::memcpy(&h, chunk, sizeof(h));
+    if (!h.isValid()   ||   sizeof(h) + h.payloadSize > size   ||   h.recordCount > header.chunkRecordCount)
+        throw cxx::exception("Rays input is corrupt: invalid chunk header");
+    const int count = h.recordCount;
+    const char *payload = chunk + sizeof(h);
+    QByteArray uncompressed;
+    if (h.flags & Compressed) {
+        // qCompress() prepends the uncompressed size, big-endian; check it before allocating
+        const uchar *p = reinterpret_cast<const uchar*>(payload);
+        if (h.payloadSize < 4   ||
+                (static_cast<quint32>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3]) != static_cast<quint32>(count*RecordSize))
+            throw cxx::exception("Rays input is corrupt: invalid chunk size");
+        uncompressed = qUncompress(reinterpret_cast<const uchar*>(payload), h.payloadSize);
+        payload = uncompressed.constData();
+        if (uncompressed.size() != count*RecordSize)
+            throw cxx::exception("Rays input is corrupt: failed to uncompress chunk");
+    }
+    else if (h.payloadSize != static_cast<quint32>(count*RecordSize))
+        throw cxx::exception("Rays input is corrupt: invalid chunk size");
+
+    typedef EncodedRecord R;
+    std::vector<R> encoded(count);
+    const char *s = payload;
+    for (int i=0; i<2; ++i)
+        s = readColumn<quint16>(s, encoded.data(), count, [i](R& r, quint16 x) { r.tex[i] = x; });
+    for (int i=0; i<2; ++i)
+        s = readColumn<qint16>(s, encoded.data(), count, [i](R& r, qint16 x) { r.dir[i] = x; });
+    s = readColumn<float>(s, encoded.data(), count, [](R& r, float x) { r.dist = x; });
+    for (int i=0; i<3; ++i)
+        s = readColumn<quint16>(s, encoded.data(), count, [i](R& r, quint16 x) { r.color[i] = x; });
+    readColumn<quint8>(s, encoded.data(), count, [](R& r, quint8 x) { r.generation = x; });
+
+    records.reserve(records.size() + count);
+    for (const auto& r : encoded)
+        records.push_back(decode(header, r));
+}
+
+} // end namespace raytracer
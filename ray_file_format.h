@@ -0,0 +1,171 @@
+/// \file
+/// \brief Declaration of the RayFileFormat structure.
+
+#ifndef RAY_FILE_FORMAT_H
+#define RAY_FILE_FORMAT_H
+
+#include "ray.h"
+#include "surface_point.h"
+
+#include <QString>
+
+#include <vector>
+
+namespace raytracer {
+
+/// \brief Layout of files with rays collected by a camera (.rays files).
+///
+/// A file consists of Header, followed by chunks, followed by the chunk index
+/// (an array of IndexEntry) and Footer. Each chunk starts with ChunkHeader, followed
+/// by the payload holding ChunkHeader::recordCount records, optionally compressed.
+/// Records are stored column by column, each record taking RecordSize bytes:
+/// - screen texture coordinates (two unsigned 16-bit numbers per record);
+/// - ray direction, octahedral encoding (two signed 16-bit numbers);
+/// - distance from ray origin to the screen (float);
+/// - ray color (three half precision numbers);
+/// - ray generation, clamped to 255 (unsigned 8-bit number).
+/// .
+/// Collision position on the screen is restored from texture coordinates and screen
+/// frame specified in the header. All numbers are little-endian.
+///
+/// Chunks are independent, so ranges of chunks can be processed in parallel;
+/// a file without index (e.g., not closed properly) is still readable,
+/// because chunks can be found by scanning chunk headers.
+struct RayFileFormat
+{
+    static const quint32 Version = 1;
+    static const int DefaultChunkRecordCount = 1 << 16;
+    /// \brief Maximum number of records in a chunk accepted by readers, so that chunk sizes fit in 32 bits.
+    static const quint32 MaxChunkRecordCount = 1 << 24;
+    static const int RecordSize = 19;
+
+    enum HeaderFlags {
+        /// \brief Rays were captured on a virtual plane rather than on a camera screen.
+        ///
+        /// When replaying such a file, rays are intersected with the screen of the camera
+        /// they are replayed into (see RayReplay).
+        VirtualPlane = 1
+    };
+
+    enum ChunkFlags {
+        /// \brief Chunk payload is compressed by qCompress().
+        Compressed = 1
+    };
+
+    struct Header
+    {
+        char magic[8];              ///< \brief "RAYDUMP" followed by zero byte.
+        quint32 version;            ///< \brief Format version.
+        quint32 headerSize;         ///< \brief Size of the header, in bytes.
+        char cameraType[32];        ///< \brief Camera type name, zero-terminated.
+        char cameraName[64];        ///< \brief Camera name, zero-terminated.
+        float cameraTransform[16];  ///< \brief Camera transformation matrix.
+        float screenOrigin[3];      ///< \brief Screen center.
+        float screenAxisX[3];       ///< \brief Screen half-width vector (texture coordinate 1 from -1 to 1).
+        float screenAxisY[3];       ///< \brief Screen half-height vector (texture coordinate 2 from -1 to 1).
+        float screenNormal[3];      ///< \brief Screen normal.
+        qint32 resolution[2];       ///< \brief Camera resolution, in pixels.
+        float parameters[8];        ///< \brief Camera-specific parameters.
+        quint64 seed;               ///< \brief Random number generator seed.
+        quint32 chunkRecordCount;   ///< \brief Maximum number of records in a chunk.
+        quint32 flags;              ///< \brief Combination of HeaderFlags.
+
+        /// \brief Initializes magic, version, and size; all other fields are zero.
+        Header();
+
+        /// \brief Returns true if magic is correct.
+        bool isValid() const;
+
+        void setCameraType(const QString& type);
+        void setCameraName(const QString& name);
+        void setCameraTransform(const m4f& transform);
+        m4f cameraTransformMatrix() const;
+
+        /// \brief Sets screen frame from the transformation of a rectangle primitive.
+        ///
+        /// The rectangle has the size \a width by \a height and is centered at the
+        /// origin of the local coordinate system; its normal is the z axis.
+        void setScreen(const m4f& rectangleTransform, float width, float height);
+    };
+
+    struct ChunkHeader
+    {
+        char magic[4];          ///< \brief "RCHK".
+        quint32 recordCount;    ///< \brief Number of records in the chunk.
+        quint32 flags;          ///< \brief Combination of ChunkFlags.
+        quint32 payloadSize;    ///< \brief Size of the payload following the header, in bytes.
+
+        ChunkHeader();
+        bool isValid() const;
+    };
+
+    struct IndexEntry
+    {
+        quint64 offset;         ///< \brief Chunk offset from the beginning of the file.
+        quint32 recordCount;    ///< \brief Number of records in the chunk.
+        quint32 size;           ///< \brief Chunk size, including chunk header.
+    };
+
+    struct Footer
+    {
+        quint64 indexOffset;    ///< \brief Offset of the first IndexEntry.
+        quint64 recordCount;    ///< \brief Total number of records.
+        quint32 chunkCount;     ///< \brief Number of chunks (and index entries).
+        quint32 reserved;
+        char magic[8];          ///< \brief "RAYINDEX".
+
+        Footer();
+        bool isValid() const;
+    };
+
+    /// \brief Record in the form it is stored in, before transposition into columns.
+    struct EncodedRecord
+    {
+        quint16 tex[2];
+        qint16 dir[2];
+        float dist;
+        quint16 color[3];
+        quint8 generation;
+    };
+
+    /// \brief Decoded record.
+    struct Record
+    {
+        Ray ray;
+        SurfacePoint surfacePoint;
+    };
+
+    /// \brief Quantizes ray hitting the camera screen at \a surfacePoint.
+    static EncodedRecord encode(const Ray& ray, const SurfacePoint& surfacePoint);
+
+    /// \brief Restores ray and surface point from \a record.
+    static Record decode(const Header& header, const EncodedRecord& record);
+
+    /// \brief Computes octahedral encoding \a e of unit vector \a v.
+    static void octEncode(const v3f& v, qint16 *e);
+
+    /// \brief Returns unit vector by its octahedral encoding \a e.
+    static v3f octDecode(const qint16 *e);
+
+    /// \brief Encodes \a count records into chunk \a chunk (chunk header followed by payload).
+    ///
+    /// If \a compress is true and compression reduces the size, the payload is compressed.
+    static void encodeChunk(
+            const EncodedRecord *records,
+            int count,
+            bool compress,
+            std::vector<char>& chunk);
+
+    /// \brief Decodes chunk of \a size bytes at \a chunk (chunk header followed by payload).
+    ///
+    /// Decoded records are appended to \a records. Throws an exception if the chunk is corrupt.
+    static void decodeChunk(
+            const Header& header,
+            const char *chunk,
+            quint64 size,
+            std::vector<Record>& records);
+};
+
+} // end namespace raytracer
+
+#endif // RAY_FILE_FORMAT_H
@@ -0,0 +1,178 @@
+/// \file
+/// \brief Implementation of the RayFileReader class.
+
+#include "ray_file_reader.h"
+#include "camera.h"
+#include "cxx_exception.h"
+
+#include <QFileInfo>
+
+#include <cstring>
+#include <algorithm>
+
+namespace raytracer {
+
+RayFileReader::RayFileReader(const QString& fileName) :
+    m_fileName(fileName),
+    m_file(fileName),
+    m_legacy(false),
+    m_recordCount(0)
+{
+    if (!m_file.open(QIODevice::ReadOnly))
+        fail("Failed to open rays input");
+    quint64 fileSize = m_file.size();
+
+    // Only files not starting with the magic are legacy ones; others must have a valid header
+    RayFileFormat::Header h;
+    if (fileSize >= sizeof(h.magic)) {
+        read(0, h.magic, sizeof(h.magic));
+        m_legacy = !h.isValid();
+    }
+    else
+        m_legacy = true;
+
+    if (m_legacy) {
+        makeLegacyIndex(fileSize);
+        return;
+    }
+    if (fileSize < sizeof(h))
+        fail("Rays input is corrupt: truncated header");
+    read(0, reinterpret_cast<char*>(&h), sizeof(h));
+    if (h.version > RayFileFormat::Version)
+        fail("Unsupported version of rays input");
+    if (h.headerSize < sizeof(h)   ||   h.headerSize > fileSize   ||
+            h.chunkRecordCount == 0   ||   h.chunkRecordCount > RayFileFormat::MaxChunkRecordCount)
+        fail("Rays input is corrupt: invalid header");
+    m_header = h;
+    if (!readIndex(fileSize))
+        scanChunks(fileSize);
+    for (const auto& entry : m_index)
+        m_recordCount += entry.recordCount;
+}
+
+QString RayFileReader::fileName() const
+{
+    return m_fileName;
+}
+
+bool RayFileReader::isLegacy() const
+{
+    return m_legacy;
+}
+
+const RayFileFormat::Header& RayFileReader::header() const
+{
+    return m_header;
+}
+
+int RayFileReader::chunkCount() const
+{
+    return m_index.size();
+}
+
+quint64 RayFileReader::recordCount() const
+{
+    return m_recordCount;
+}
+
+const RayFileFormat::IndexEntry& RayFileReader::chunk(int index) const
+{
+    Q_ASSERT(index >= 0   &&   index < chunkCount());
+    return m_index[index];
+}
+
+void RayFileReader::readChunk(int index, std::vector<RayFileFormat::Record>& records)
+{
+    const auto& entry = chunk(index);
+    m_buffer.resize(entry.size);
+    read(entry.offset, m_buffer.data(), entry.size);
+    decodeChunk(index, m_buffer.data(), records);
+}
+
+void RayFileReader::decodeChunk(int index, const char *data, std::vector<RayFileFormat::Record>& records) const
+{
+    const auto& entry = chunk(index);
+    if (!m_legacy) {
+        RayFileFormat::decodeChunk(m_header, data, entry.size, records);
+        return;
+    }
+
+    records.reserve(records.size() + entry.recordCount);
+    for (quint32 i=0; i<entry.recordCount; ++i, data+=sizeof(Camera::RayData)) {
+        Camera::RayData rd;
+        std::memcpy(reinterpret_cast<char*>(&rd), data, sizeof(rd));
+        RayFileFormat::Record r;
+        r.ray = rd.ray;
+        r.surfacePoint = fsmx::zero<SurfacePoint>();
+        sppos(r.surfacePoint) = rd.collisionPos;
+        records.push_back(r);
+    }
+}
+
+bool RayFileReader::readIndex(quint64 fileSize)
+{
+    RayFileFormat::Footer footer;
+    if (fileSize < m_header.headerSize + sizeof(footer))
+        return false;
+    quint64 footerOffset = fileSize - sizeof(footer);
+    read(footerOffset, reinterpret_cast<char*>(&footer), sizeof(footer));
+    if (!footer.isValid()   ||
+            footer.indexOffset < m_header.headerSize   ||
+            footer.indexOffset + footer.chunkCount*sizeof(RayFileFormat::IndexEntry) != footerOffset)
+        return false;
+    m_index.resize(footer.chunkCount);
+    read(footer.indexOffset, reinterpret_cast<char*>(m_index.data()), footer.chunkCount*sizeof(RayFileFormat::IndexEntry));
+    for (const auto& entry : m_index)
+        if (entry.offset < m_header.headerSize   ||   entry.offset + entry.size > footer.indexOffset   ||
+                entry.recordCount > m_header.chunkRecordCount)
+            fail("Rays input is corrupt: invalid chunk index");
+    return true;
+}
+
+void RayFileReader::scanChunks(quint64 fileSize)
+{
+    // The file has not been closed properly; take all complete chunks
+    m_index.clear();
+    quint64 offset = m_header.headerSize;
+    RayFileFormat::ChunkHeader h;
+    while (offset + sizeof(h) <= fileSize) {
+        read(offset, reinterpret_cast<char*>(&h), sizeof(h));
+        quint64 size = sizeof(h) + h.payloadSize;
+        if (!h.isValid()   ||   offset + size > fileSize   ||   h.recordCount > m_header.chunkRecordCount)
+            break;
+        RayFileFormat::IndexEntry entry;
+        entry.offset = offset;
+        entry.recordCount = h.recordCount;
+        entry.size = static_cast<quint32>(size);
+        m_index.push_back(entry);
+        offset += size;
+    }
+}
+
+void RayFileReader::makeLegacyIndex(quint64 fileSize)
+{
+    const quint64 recordSize = sizeof(Camera::RayData);
+    m_recordCount = fileSize / recordSize;
+    for (quint64 first=0; first<m_recordCount; first+=RayFileFormat::DefaultChunkRecordCount) {
+        RayFileFormat::IndexEntry entry;
+        entry.offset = first*recordSize;
+        entry.recordCount = static_cast<quint32>(std::min(
+                    m_recordCount - first,
+                    static_cast<quint64>(RayFileFormat::DefaultChunkRecordCount)));
+        entry.size = static_cast<quint32>(entry.recordCount*recordSize);
+        m_index.push_back(entry);
+    }
+}
+
+void RayFileReader::read(quint64 offset, char *data, quint64 size)
+{
+    if (!m_file.seek(offset)   ||   m_file.read(data, size) != static_cast<qint64>(size))
+        fail("Failed to read rays input");
+}
+
+void RayFileReader::fail(const std::string& message) const
+{
+    throw cxx::exception(message + " '" + QFileInfo(m_fileName).absoluteFilePath().toStdString() + "'");
+}
+
+} // end namespace raytracer
@@ -0,0 +1,68 @@
+/// \file
+/// \brief Declaration of the RayFileReader class.
+
+#ifndef RAY_FILE_READER_H
+#define RAY_FILE_READER_H
+
+#include "ray_file_format.h"
+
+#include <QFile>
+
+namespace raytracer {
+
+/// \brief Reads rays from a file written by RayFileWriter.
+///
+/// The chunk index is read from the end of the file; if the file has no index,
+/// it is rebuilt by scanning chunk headers. Files not starting with the header magic
+/// are taken to have the legacy format (raw Camera::RayData records); they are split into
+/// chunks of RayFileFormat::DefaultChunkRecordCount records, and decoded surface
+/// points only have the position set.
+class RayFileReader
+{
+public:
+    /// \brief Opens file \a fileName and reads its header and chunk index.
+    ///
+    /// Throws an exception if the file can not be opened or is corrupt.
+    explicit RayFileReader(const QString& fileName);
+
+    QString fileName() const;
+
+    /// \brief Returns true if the file has the legacy format.
+    bool isLegacy() const;
+
+    /// \brief Returns file header (default one for legacy files).
+    const RayFileFormat::Header& header() const;
+
+    int chunkCount() const;
+    quint64 recordCount() const;
+    const RayFileFormat::IndexEntry& chunk(int index) const;
+
+    /// \brief Reads and decodes chunk with the specified index; records are appended to \a records.
+    ///
+    /// \note Not thread-safe; use decodeChunk() on memory-mapped file data to process chunks in parallel.
+    void readChunk(int index, std::vector<RayFileFormat::Record>& records);
+
+    /// \brief Decodes chunk with the specified index, located at \a data; records are appended to \a records.
+    ///
+    /// Thread-safe.
+    void decodeChunk(int index, const char *data, std::vector<RayFileFormat::Record>& records) const;
+
+private:
+    QString m_fileName;
+    QFile m_file;
+    bool m_legacy;
+    RayFileFormat::Header m_header;
+    std::vector<RayFileFormat::IndexEntry> m_index;
+    quint64 m_recordCount;
+    std::vector<char> m_buffer;
+
+    bool readIndex(quint64 fileSize);
+    void scanChunks(quint64 fileSize);
+    void makeLegacyIndex(quint64 fileSize);
+    void read(quint64 offset, char *data, quint64 size);
+    [[noreturn]] void fail(const std::string& message) const;
+};
+
+} // end namespace raytracer
+
+#endif // RAY_FILE_READER_H
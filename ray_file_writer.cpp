@@ -0,0 +1,116 @@
+/// \file
+/// \brief Implementation of the RayFileWriter class.
+
+#include "ray_file_writer.h"
+
+#include <algorithm>
+
+namespace raytracer {
+
+RayFileWriter::RayFileWriter(
+        const QString& fileName,
+        const RayFileFormat::Header& header,
+        bool compress) :
+    m_header(header),
+    m_compress(compress),
+    m_writer(fileName),
+    m_offset(0),
+    m_recordCount(0),
+    m_closed(false)
+{
+    Q_ASSERT(header.chunkRecordCount > 0   &&
+             sizeof(RayFileFormat::ChunkHeader) + header.chunkRecordCount*RayFileFormat::RecordSize <=
+                static_cast<quint64>(RayDataWriter::DefaultBlockSize));
+    m_chunk.reserve(m_header.chunkRecordCount);
+    writeData(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+}
+
+RayFileWriter::~RayFileWriter()
+{
+    try {
+        close();
+    }
+    catch (const std::exception&) {
+    }
+}
+
+void RayFileWriter::write(const Ray& ray, const SurfacePoint& surfacePoint)
+{
+    auto record = RayFileFormat::encode(ray, surfacePoint);
+    std::vector<RayFileFormat::EncodedRecord> fullChunk;
+    {
+        QMutexLocker lock(&m_chunkMutex);
+        m_chunk.push_back(record);
+        if (m_chunk.size() < m_header.chunkRecordCount)
+            return;
+        fullChunk.reserve(m_header.chunkRecordCount);
+        fullChunk.swap(m_chunk);
+    }
+    writeChunk(fullChunk);
+}
+
+void RayFileWriter::close()
+{
+    std::vector<RayFileFormat::EncodedRecord> lastChunk;
+    {
+        QMutexLocker lock(&m_chunkMutex);
+        lastChunk.swap(m_chunk);
+    }
+    if (!lastChunk.empty())
+        writeChunk(lastChunk);
+
+    {
+        QMutexLocker lock(&m_indexMutex);
+        if (m_closed)
+            return;
+        m_closed = true;
+        RayFileFormat::Footer footer;
+        footer.indexOffset = m_offset;
+        footer.chunkCount = m_index.size();
+        footer.recordCount = m_recordCount;
+        writeData(reinterpret_cast<const char*>(m_index.data()), m_index.size()*sizeof(RayFileFormat::IndexEntry));
+        writeData(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    }
+    m_writer.close();
+}
+
+QString RayFileWriter::fileName() const
+{
+    return m_writer.fileName();
+}
+
+const RayFileFormat::Header& RayFileWriter::header() const
+{
+    return m_header;
+}
+
+void RayFileWriter::writeChunk(const std::vector<RayFileFormat::EncodedRecord>& records)
+{
+    std::vector<char> chunk;
+    RayFileFormat::encodeChunk(records.data(), records.size(), m_compress, chunk);
+
+    // Chunks are passed to the data writer in the order of their index entries
+    QMutexLocker lock(&m_indexMutex);
+    Q_ASSERT(!m_closed);
+    RayFileFormat::IndexEntry entry;
+    entry.offset = m_offset;
+    entry.recordCount = records.size();
+    entry.size = chunk.size();
+    m_index.push_back(entry);
+    m_recordCount += records.size();
+    writeData(chunk.data(), chunk.size());
+}
+
+void RayFileWriter::writeData(const char *data, quint64 size)
+{
+    // Not thread-safe; called for the header in the constructor, otherwise with the index mutex locked
+    m_offset += size;
+    while (size > 0) {
+        int n = static_cast<int>(std::min(size, static_cast<quint64>(RayDataWriter::DefaultBlockSize)));
+        m_writer.write(data, n);
+        data += n;
+        size -= n;
+    }
+}
+
+} // end namespace raytracer
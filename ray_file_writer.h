@@ -0,0 +1,64 @@
+/// \file
+/// \brief Declaration of the RayFileWriter class.
+
+#ifndef RAY_FILE_WRITER_H
+#define RAY_FILE_WRITER_H
+
+#include "ray_file_format.h"
+#include "ray_data_writer.h"
+
+#include <QMutex>
+
+namespace raytracer {
+
+/// \brief Writes rays collected by a camera to a file in the format described by RayFileFormat.
+///
+/// Records are accumulated in a chunk; full chunks are encoded (and optionally
+/// compressed) by the thread that filled them, outside the lock, and then passed
+/// to RayDataWriter, which writes them to the file in the background.
+/// All methods are thread-safe.
+class RayFileWriter
+{
+public:
+    /// \brief Creates file \a fileName and writes \a header to it.
+    ///
+    /// Throws an exception if the file already exists or can not be opened.
+    RayFileWriter(
+            const QString& fileName,
+            const RayFileFormat::Header& header,
+            bool compress);
+
+    /// \brief Calls close(); errors are ignored.
+    ~RayFileWriter();
+
+    /// \brief Appends ray hitting the camera screen at \a surfacePoint.
+    void write(const Ray& ray, const SurfacePoint& surfacePoint);
+
+    /// \brief Writes the last chunk, the chunk index, and the footer, and closes the file.
+    void close();
+
+    QString fileName() const;
+
+    const RayFileFormat::Header& header() const;
+
+private:
+    RayFileFormat::Header m_header;
+    bool m_compress;
+    RayDataWriter m_writer;
+
+    QMutex m_chunkMutex;
+    std::vector<RayFileFormat::EncodedRecord> m_chunk;
+
+    QMutex m_indexMutex;
+    std::vector<RayFileFormat::IndexEntry> m_index;
+    quint64 m_offset;
+    quint64 m_recordCount;
+    bool m_closed;
+
+    void writeChunk(const std::vector<RayFileFormat::EncodedRecord>& records);
+    void writeData(const char *data, quint64 size);
+};
+
+} // end namespace raytracer
+
+#endif // RAY_FILE_WRITER_H
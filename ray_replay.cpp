@@ -0,0 +1,188 @@
+/// \file
+/// \brief Implementation of the RayReplay class.
+
+#include "ray_replay.h"
+#include "camera.h"
+#include "ray_tracer.h"
+#include "cxx_exception.h"
+
+#include <QFileInfo>
+#include <QMutex>
+#include <QThread>
+
+#include <algorithm>
+
+namespace raytracer {
+
+namespace {
+
+// State shared by replay threads
+struct ReplayState
+{
+    const uchar *mappedFile;
+    QMutex mutex;
+    int nextChunk;
+    QString error;
+};
+
+} // anonymous namespace
+
+class RayReplay::ReplayThread : public QThread
+{
+public:
+    ReplayThread(
+            const RayFileReader& reader,
+            const std::vector<Camera*>& cameras,
+            ReplayState& state) :
+        m_reader(reader),
+        m_cameras(cameras),
+        m_state(state)
+    {
+        for (auto camera : cameras) {
+            m_canvases.push_back(Camera::Canvas(camera->canvas().size()));
+            m_canvases.back().setBounceLayerCount(camera->canvas().bounceLayerCount());
+            m_canvases.back().setFeatureBuffers(camera->canvas().hasFeatureBuffers());
+        }
+    }
+
+    /// \brief Adds thread canvases to camera canvases.
+    void merge() const
+    {
+        for (std::size_t i=0; i<m_cameras.size(); ++i)
+            m_cameras[i]->canvas() += m_canvases[i];
+    }
+
+    void process()
+    {
+        try {
+            std::vector<SurfaceProperties::Ptr> surfProps;
+            std::vector<const Primitive*> primitives;
+            for (std::size_t i=0; i<m_cameras.size(); ++i) {
+                surfProps.push_back(m_cameras[i]->makeSurfaceProperties(m_canvases[i]));
+                primitives.push_back(m_cameras[i]->cameraPrimitive().get());
+            }
+            bool reproject = (m_reader.header().flags & RayFileFormat::VirtualPlane) != 0;
+
+            QFile file;
+            if (!m_state.mappedFile) {
+                file.setFileName(m_reader.fileName());
+                if (!file.open(QIODevice::ReadOnly))
+                    throw cxx::exception(std::string("Failed to open rays input '") + QFileInfo(m_reader.fileName()).absoluteFilePath().toStdString() + "'");
+            }
+
+            std::vector<char> buffer;
+            std::vector<RayFileFormat::Record> records;
+            // Camera surface properties ask the tracer for the light group and the source
+            // features of the ray; replayed rays have neither, as an idle tracer reports
+            RayTracer context;
+            forever {
+                int chunk;
+                {
+                    QMutexLocker lock(&m_state.mutex);
+                    if (m_state.nextChunk == m_reader.chunkCount()   ||   !m_state.error.isEmpty())
+                        return;
+                    chunk = m_state.nextChunk++;
+                }
+                const auto& entry = m_reader.chunk(chunk);
+                const char *data;
+                if (m_state.mappedFile)
+                    data = reinterpret_cast<const char*>(m_state.mappedFile) + entry.offset;
+                else {
+                    buffer.resize(entry.size);
+                    if (!file.seek(entry.offset)   ||   file.read(buffer.data(), entry.size) != entry.size)
+                        throw cxx::exception(std::string("Failed to read rays input '") + QFileInfo(m_reader.fileName()).absoluteFilePath().toStdString() + "'");
+                    data = buffer.data();
+                }
+                records.clear();
+                m_reader.decodeChunk(chunk, data, records);
+                if (reproject) {
+                    // Rays were captured on a virtual plane; find where they hit camera screens
+                    SurfacePoint sp;
+                    float rayParam;
+                    for (const auto& r : records)
+                        for (std::size_t i=0; i<surfProps.size(); ++i)
+                            if (primitives[i]->collisionTest(rayParam, sp, r.ray))
+                                surfProps[i]->processCollision(r.ray, sp, context);
+                }
+                else
+                    for (const auto& r : records)
+                        for (const auto& surfProp : surfProps)
+                            surfProp->processCollision(r.ray, r.surfacePoint, context);
+            }
+        }
+        catch (const std::exception& e) {
+            QMutexLocker lock(&m_state.mutex);
+            if (m_state.error.isEmpty())
+                m_state.error = QString::fromStdString(e.what());
+        }
+    }
+
+protected:
+    void run()
+    {
+        process();
+    }
+
+private:
+    const RayFileReader& m_reader;
+    const std::vector<Camera*>& m_cameras;
+    ReplayState& m_state;
+    std::vector<Camera::Canvas> m_canvases;
+};
+
+
+
+RayReplay::RayReplay(const QString& fileName) :
+    m_reader(fileName),
+    m_threadCount(std::max(1, QThread::idealThreadCount()))
+{
+}
+
+const RayFileReader& RayReplay::reader() const
+{
+    return m_reader;
+}
+
+int RayReplay::threadCount() const
+{
+    return m_threadCount;
+}
+
+void RayReplay::setThreadCount(int threadCount)
+{
+    Q_ASSERT(threadCount > 0);
+    m_threadCount = threadCount;
+}
+
+void RayReplay::run(const std::vector<Camera*>& cameras)
+{
+    if (cameras.empty()   ||   m_reader.chunkCount() == 0)
+        return;
+
+    // Map the whole file; if mapping fails, each thread reads chunks by itself
+    QFile file(m_reader.fileName());
+    ReplayState state;
+    state.mappedFile = nullptr;
+    state.nextChunk = 0;
+    if (file.open(QIODevice::ReadOnly))
+        state.mappedFile = file.map(0, file.size());
+
+    int threadCount = std::min(m_threadCount, m_reader.chunkCount());
+    std::vector< std::unique_ptr<ReplayThread> > threads;
+    for (int i=0; i<threadCount; ++i)
+        threads.emplace_back(new ReplayThread(m_reader, cameras, state));
+    for (int i=1; i<threadCount; ++i)
+        threads[i]->start();
+    threads[0]->process();
+    for (int i=1; i<threadCount; ++i)
+        threads[i]->wait();
+
+    if (state.mappedFile)
+        file.unmap(const_cast<uchar*>(state.mappedFile));
+    if (!state.error.isEmpty())
+        throw cxx::exception(state.error.toStdString());
+    for (const auto& thread : threads)
+        thread->merge();
+}
+
+} // end namespace raytracer
@@ -0,0 +1,54 @@
+/// \file
+/// \brief Declaration of the RayReplay class.
+
+#ifndef RAY_REPLAY_H
+#define RAY_REPLAY_H
+
+#include "ray_file_reader.h"
+
+namespace raytracer {
+
+class Camera;
+
+/// \brief Replays rays from a file (see RayFileFormat) into one or more cameras.
+///
+/// The file is memory-mapped, and its chunks are distributed among threads;
+/// each thread decodes a chunk once and passes each ray to all cameras, accumulating
+/// the images in canvases of its own (see Camera::makeSurfaceProperties()).
+/// When all rays are processed, thread canvases are added to camera canvases.
+/// Cameras can differ in any parameters (e.g., a sweep of focusing distances),
+/// but must have the same screen as the camera that has written the file, unless
+/// the file has been written by CapturePlane: in that case, rays are intersected
+/// with camera screens, so cameras of any type can be placed behind the plane.
+class RayReplay
+{
+public:
+    /// \brief Opens file \a fileName and reads its chunk index.
+    ///
+    /// Throws an exception if the file can not be opened or is corrupt.
+    explicit RayReplay(const QString& fileName);
+
+    const RayFileReader& reader() const;
+
+    /// \brief Returns the number of threads (QThread::idealThreadCount() by default).
+    int threadCount() const;
+
+    /// \brief Sets the number of threads.
+    void setThreadCount(int threadCount);
+
+    /// \brief Processes all rays of the file by all \a cameras.
+    ///
+    /// Camera canvases are not cleared. Throws an exception if the file can not be read.
+    void run(const std::vector<Camera*>& cameras);
+
+private:
+    class ReplayThread;
+    friend class ReplayThread;
+
+    RayFileReader m_reader;
+    int m_threadCount;
+};
+
+} // end namespace raytracer
+
+#endif // RAY_REPLAY_H
@@ -3,7 +3,14 @@
 
 #include "ray_tracer.h"
 #include "surface_properties.h"
+#include "ray_batch.h"
+#include "ray_replay.h"
 #include "cxx_exception.h"
+#include "math_util.h"
+#include "bounding_sphere.h"
+
+#include <limits>
+#include <map>
 
 #ifdef DEBUG_RAY_BOUNCES
 #include <QDebug>
@@ -11,26 +18,6 @@
 
 namespace raytracer {
 
-class RayTracer::ScopedCallbackCaller
-{
-public:
-    ScopedCallbackCaller(RayTracer& rt) : m_rt(rt) {}
-    ~ScopedCallbackCaller() {
-        if (m_rt.m_cbMsecInterval > 0   &&
-                m_rt.m_lastRayNumber % m_rt.m_cbRaysGranularity == 0) {
-            if (m_rt.m_cbLastTime.elapsed() >= m_rt.m_cbMsecInterval)  {
-                float progress = static_cast<float>(m_rt.m_lastRayNumber) / m_rt.m_options.totalRayLimit;
-                m_rt.m_cb(progress, false, m_rt.m_lastRayNumber);
-                m_rt.m_cbLastTime.restart();
-            }
-        }
-    }
-private:
-    RayTracer& m_rt;
-};
-
-
-
 CTM_DECL_EXCEPTION(RayTracerTerminationException, cxx::exception)
 
 
@@ -38,16 +25,20 @@ CTM_DECL_EXCEPTION(RayTracerTerminationException, cxx::exception)
 RayTracer::RayTracer() :
     m_imageProcessor(IdentityImageProcessor::newInstance()),
     m_collisionDataBufferSize(0),
+    m_currentLightGroup(-1),
+    m_raySourceFeatures(nullptr),
     m_lastRayNumber(0),
     m_cbMsecInterval(0),
-    m_cbRaysGranularity(100000),
-    m_terminationRequested(false)
+    m_progressCounter(nullptr),
+    m_terminationRequested(false),
+    m_prepared(false)
 {
 }
 
 RayTracer& RayTracer::setScene(const Scene& scene)
 {
     m_scene = scene;
+    m_prepared = false;
     return *this;
 }
 
@@ -58,13 +49,28 @@ Scene RayTracer::scene() const
 
 RayTracer& RayTracer::setCamera(const Camera::Ptr &camera)
 {
-    m_camera = camera;
+    m_cameras.clear();
+    if (camera)
+        m_cameras.push_back(camera);
+    m_prepared = false;
     return *this;
 }
 
 Camera::Ptr RayTracer::camera() const
 {
-    return m_camera;
+    return m_cameras.empty() ?   Camera::Ptr() :   m_cameras.front();
+}
+
+RayTracer& RayTracer::setCameras(const std::vector<Camera::Ptr>& cameras)
+{
+    m_cameras = cameras;
+    m_prepared = false;
+    return *this;
+}
+
+const std::vector<Camera::Ptr>& RayTracer::cameras() const
+{
+    return m_cameras;
 }
 
 RayTracer& RayTracer::setOptions(const Options& options) {
@@ -77,15 +83,67 @@ RayTracer::Options RayTracer::options() const {
 }
 
 void RayTracer::processRay(const Ray& ray)
+{
+    if (m_lastRayNumber < m_options.totalRayLimit)
+        traceRay(ray);
+}
+
+void RayTracer::processRayBatch(const RayBatch& batch)
 {
     if (m_terminationRequested)
         throw RayTracerTerminationException();
 
-    if (m_lastRayNumber >= m_options.totalRayLimit)
-        return;
+    for (int i=0, n=batch.size(); i<n; ++i) {
+        if (m_lastRayNumber >= m_options.totalRayLimit)
+            break;
+        traceRay(batch.ray(i));
+    }
+
+    if (m_progressCounter) {
+        // Publish the number of rays and report progress if the monitor asks for it
+        m_progressCounter->set(m_lastRayNumber);
+        if (m_progressMonitor->takeReportRequest()) {
+            quint64 rays = m_progressMonitor->total();
+            m_cb(static_cast<float>(rays) / m_options.totalRayLimit, false, rays);
+        }
+    }
+}
+
+LightVertexCache *RayTracer::vertexCache() const
+{
+    return m_vertexCache.get();
+}
 
+QStringList RayTracer::lightGroups() const
+{
+    QStringList result;
+    for (int i=0, n=m_scene.lightSources().size(); i<n; ++i) {
+        QString group = lightGroup(i);
+        if (!result.contains(group))
+            result << group;
+    }
+    return result;
+}
+
+int RayTracer::currentLightGroup() const
+{
+    return m_currentLightGroup;
+}
+
+const SurfaceFeatures *RayTracer::raySourceFeatures() const
+{
+    return m_raySourceFeatures;
+}
+
+QString RayTracer::lightGroup(int lightIndex) const
+{
+    QString group = m_scene.lightSources()[lightIndex]->group();
+    return group.isEmpty() ?   QString("light %1").arg(lightIndex+1) :   group;
+}
+
+void RayTracer::traceRay(const Ray& ray)
+{
     ++m_lastRayNumber;
-    ScopedCallbackCaller scc(*this);
 
     if (ray.generation > m_options.reflectionLimit) {
         // No collisions occurred
@@ -126,10 +184,98 @@ void RayTracer::processRay(const Ray& ray)
         return;
     }
 
-    // Process nearest collision
-    const CollisionData& cd0 = *std::min_element(cdbuf.begin(), cdbuf.end());
-    ADD_RAY_BOUNCE_INFO(ray, cd0)
-    cd0.primitive->surfaceProperties()->processCollision(ray, cd0.surfacePoint, *this);
+    // Process nearest collision; camera screens are transparent,
+    // so a ray hitting one proceeds to the next nearest collision
+    forever {
+        CollisionData& cd0 = *std::min_element(cdbuf.begin(), cdbuf.end());
+        if (cd0.rayParam == std::numeric_limits<float>::infinity()) {
+            // No more collisions
+            FINISH_RAY_BOUNCE_CHAIN(ray, RayBounceChainGoneAway);
+            return;
+        }
+        ADD_RAY_BOUNCE_INFO(ray, cd0)
+        int materialId = cd0.primitive->materialId();
+        Q_ASSERT(materialId >= 0   &&   materialId < static_cast<int>(m_materialTable.size()));
+        m_materialTable[materialId]->processCollision(ray, cd0.surfacePoint, *this);
+        if (!m_cameraMaterials[materialId])
+            break;
+        cd0.rayParam = std::numeric_limits<float>::infinity();
+    }
+}
+
+bool RayTracer::isOccluded(const Ray& ray, float distance) const
+{
+    SurfacePoint surfacePoint;
+    float rayParam;
+    auto r = m_psearch.find(ray);
+    for (auto it=r.begin; it!=r.end; ++it) {
+        const Primitive *primitive = *it;
+        if (m_cameraMaterials[primitive->materialId()])
+            continue;
+        if (primitive->collisionTest(rayParam, surfacePoint, ray)   &&
+                rayParam >= m_options.rayParamThreshold   &&   rayParam < distance)
+            return true;
+    }
+    return false;
+}
+
+void RayTracer::renderVertices(const LightVertexCache& cache, Camera& camera)
+{
+    const Primitive *screen = camera.cameraPrimitive().get();
+    float area = screen->area();
+    if (!(area > 0.f))
+        return;
+    // Rays synthesized from vertices are not written to the rays file of the camera
+    SurfaceProperties::Ptr surfProp = camera.makeSurfaceProperties(camera.canvas());
+
+    // Camera screens are planar; blocks entirely behind the screen plane are not seen
+    SurfacePoint sp;
+    screen->surfaceSample(sp, mkv2f(0.5f, 0.5f));
+    v3f screenCenter = sppos(sp);
+    v3f screenNormal = spnormal(sp);
+    auto isBlockVisible = [&](const LightVertexCache::Block& b) {
+        for (int corner=0; corner<8; ++corner) {
+            auto p = mkv3f(
+                        (corner & 1) ?   b.boxMax[0] :   b.boxMin[0],
+                        (corner & 2) ?   b.boxMax[1] :   b.boxMin[1],
+                        (corner & 4) ?   b.boxMax[2] :   b.boxMin[2]);
+            if (dot(p - screenCenter, screenNormal) > 0.f)
+                return true;
+        }
+        return false;
+    };
+
+    // Each vertex is connected to one random point of the screen. Diffuse surfaces
+    // scatter light uniformly over the hemisphere, so the light reaching the screen
+    // element dA is color * P(side) / (2 pi) * cos(screen angle) dA / distance^2.
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    const float weight = cache.weight() * area / static_cast<float>(2*M_PI);
+    for (int iblock=0, nblocks=cache.blockCount(); iblock<nblocks; ++iblock) {
+        const auto& b = cache.block(iblock);
+        if (!isBlockVisible(b))
+            continue;
+        for (quint32 i=b.first, end=b.first+b.count; i<end; ++i) {
+            const auto& vertex = cache.vertex(i);
+            v3f pos = vertex.position();
+            screen->surfaceSample(sp, mkv2f(uniform(rnd::gen()), uniform(rnd::gen())));
+            v3f dir = sppos(sp) - pos;
+            float distance = dir.norm2();
+            if (!(distance > 0.f))
+                continue;
+            dir /= distance;
+            float cosScreen = -dot(dir, spnormal(sp));
+            if (cosScreen <= 0.f)
+                continue;
+            float translucency = vertex.translucencyValue();
+            float sideProbability = dot(dir, vertex.normalVector()) > 0.f ?   1.f - translucency :   translucency;
+            if (sideProbability <= 0.f)
+                continue;
+            Ray ray(pos, dir, vertex.colorVector()*(sideProbability*weight*cosScreen/(distance*distance)), vertex.generation);
+            if (isOccluded(ray, distance))
+                continue;
+            surfProp->processCollision(ray, sp, *this);
+        }
+    }
 }
 
 #ifdef DEBUG_RAY_BOUNCES
@@ -202,37 +348,165 @@ void RayTracer::addRayBounceInfo(const RayBounceInfo& rbi)
 void RayTracer::read(const QVariant& v)
 {
     m_options = Options();
+    m_prepared = false;
 
     QVariantMap m = safeVariantMap(v);
     m_scene.read(readProperty(m, "scene"));
-    readTypedProperty(m_camera, m, "camera");
+    m_cameras.clear();
+    readOptionalProperty(m, "camera", [this](const QVariant& v) {
+        m_cameras.push_back(readTypedInstance<Camera>(v));
+    });
+    readOptionalProperty(m, "cameras", [this](const QVariant& v) {
+        std::vector<Camera::Ptr> cameras;
+        readTypedInstances(cameras, v);
+        m_cameras.insert(m_cameras.end(), cameras.begin(), cameras.end());
+    });
     readOptionalTypedProperty(m_imageProcessor, m, "imgproc");
     readOptionalProperty(m, "options", [this](const QVariant& v) {
-        QVariantMap m = safeVariantMap(v);
-        readOptionalProperty(m_options.totalRayLimit, m, "max_rays");
-        readOptionalProperty(m_options.reflectionLimit, m, "max_reflections");
-        readOptionalProperty(m_options.intensityThreshold, m, "intensity_threshold");
-        readOptionalProperty(m_options.rayParamThreshold, m, "ray_param_threshold");
+        readOptions(v);
     });
 }
 
+void RayTracer::readOptions(const QVariant& v)
+{
+    QVariantMap m = safeVariantMap(v);
+    readOptionalProperty(m_options.totalRayLimit, m, "max_rays");
+    readOptionalProperty(m_options.reflectionLimit, m, "max_reflections");
+    readOptionalProperty(m_options.intensityThreshold, m, "intensity_threshold");
+    readOptionalProperty(m_options.rayParamThreshold, m, "ray_param_threshold");
+    readOptionalProperty(m_options.vertexOutputFileName, m, "write_vertices");
+    readOptionalProperty(m_options.maxVertexCount, m, "max_vertices");
+    readOptionalProperty(m_options.lightCanvases, m, "light_canvases");
+    readOptionalProperty(m_options.bounceCanvases, m, "bounce_canvases");
+    readOptionalProperty(m_options.featureCanvases, m, "feature_canvases");
+    readOptionalProperty(m_options.traceLight, m, "trace_light");
+}
+
+void RayTracer::prepare()
+{
+    if (m_prepared)
+        return;
+
+    // Collect primitives to trace
+    std::vector<Primitive*> primitives;
+    for (const Primitive::Ptr& p : m_scene.primitives())
+        primitives.push_back(p.get());
+    std::vector<Primitive*>::size_type cameraPrimitivesBegin = primitives.size();
+    for (const Camera::Ptr& camera : m_cameras)
+        primitives.push_back(camera->cameraPrimitive().get());
+
+    // Compile material table
+    compileMaterials(primitives);
+    m_cameraMaterials.assign(m_materialTable.size(), false);
+    for (auto i=cameraPrimitivesBegin; i<primitives.size(); ++i)
+        m_cameraMaterials[primitives[i]->materialId()] = true;
+
+    // Prepare the search structure
+    m_psearch = PrimitiveSearch();
+    for (const Primitive *p : primitives)
+        m_psearch.add(p);
+
+    // Cache first-hit candidates for light sources emitting all rays from one point
+    foreach (const LightSource::Ptr& light, m_scene.lightSources()) {
+        v3f origin;
+        if (light->fixedOrigin(origin))
+            m_psearch.addOrigin(origin);
+    }
+
+    m_preparedCameraPrimitives.clear();
+    for (const Camera::Ptr& camera : m_cameras)
+        m_preparedCameraPrimitives.push_back(camera->cameraPrimitive());
+    m_prepared = true;
+}
+
+bool RayTracer::updateCameraPrimitives()
+{
+    // Camera::clear() re-creates camera primitives and their surface properties;
+    // put the new ones in place of the prepared ones, unless their bounding spheres differ
+    if (m_preparedCameraPrimitives.size() != m_cameras.size())
+        return false;
+    for (std::size_t i=0; i<m_cameras.size(); ++i) {
+        Primitive::Ptr prepared = m_preparedCameraPrimitives[i];
+        Primitive::Ptr current = m_cameras[i]->cameraPrimitive();
+        if (current == prepared)
+            continue;
+        BoundingSphere a = prepared->boundingSphere();
+        BoundingSphere b = current->boundingSphere();
+        if (!(a.center[0] == b.center[0]   &&   a.center[1] == b.center[1]   &&   a.center[2] == b.center[2]   &&
+              a.radius == b.radius))
+            return false;
+        int materialId = prepared->materialId();
+        current->setMaterialId(materialId);
+        m_materials[materialId] = current->surfaceProperties();
+        m_materialTable[materialId] = m_materials[materialId].get();
+        m_psearch.replace(prepared.get(), current.get());
+        m_preparedCameraPrimitives[i] = current;
+    }
+    return true;
+}
+
 void RayTracer::run()
 {
+    // Vertices already hold the diffuse light, traced light would add it once again
+    if (m_options.traceLight)
+        for (const Camera::Ptr& camera : m_cameras)
+            if (!camera->verticesInputFileName().isEmpty())
+                throw cxx::exception("Cameras reading light path vertices require trace_light: false");
+
     // Reset ray counter
     m_lastRayNumber = 0;
 
-    // Prepare the search structure
-    m_psearch = PrimitiveSearch();
-    for (Primitive::Ptr p : m_scene.primitives())
-        m_psearch.add(p.get());
-    if (m_camera)
-    {
-        m_camera->clear();
-        m_psearch.add(m_camera->cameraPrimitive().get());
+    QStringList lightGroups = this->lightGroups();
+    for (const Camera::Ptr& camera : m_cameras) {
+        camera->clear();
+        if (m_options.lightCanvases)
+            camera->canvas().setLayers(lightGroups);
+        if (m_options.bounceCanvases)
+            camera->canvas().setBounceLayerCount(m_options.reflectionLimit);
+        if (m_options.featureCanvases)
+            camera->canvas().setFeatureBuffers(true);
     }
 
-    auto lights = m_scene.lightSources();
+    // Replay rays from files; cameras reading the same file share one pass over it
+    std::map< QString, std::vector<Camera*> > replayCameras;
+    for (const Camera::Ptr& camera : m_cameras)
+        if (!camera->raysInputFileName().isEmpty())
+            replayCameras[camera->raysInputFileName()].push_back(camera.get());
+    for (const auto& item : replayCameras)
+        RayReplay(item.first).run(item.second);
+
+    // Prepare the search structure, unless it is kept from the previous run
+    if (m_prepared   &&   !updateCameraPrimitives())
+        m_prepared = false;
+    prepare();
+
+    // Render light path vertices collected by previous runs; cameras reading
+    // the same file share one copy of the vertices
+    std::map< QString, std::vector<Camera*> > vertexCameras;
+    for (const Camera::Ptr& camera : m_cameras)
+        if (!camera->verticesInputFileName().isEmpty())
+            vertexCameras[camera->verticesInputFileName()].push_back(camera.get());
+    for (const auto& item : vertexCameras) {
+        LightVertexCache cache;
+        cache.load(item.first);
+        for (Camera *camera : item.second)
+            renderVertices(cache, *camera);
+    }
+
+    if (m_options.traceLight)
+        emitLight(lightGroups);
+
+    for (const Camera::Ptr& camera : m_cameras)
+        camera->finish();
+
+    if (m_cbMsecInterval > 0)
+        // Invoke the progress callback last time
+        m_cb(1.0f, true, m_lastRayNumber);
+}
 
+void RayTracer::emitLight(const QStringList& lightGroups)
+{
+    auto lights = m_scene.lightSources();
     if (lights.empty())
         // No light sources, nothing to do
         return;
@@ -244,25 +518,59 @@ void RayTracer::run()
         // Zero rays per light, nothing to do
         return;
 
-    // Start counting the time
-    m_cbLastTime.start();
+    // Start monitoring the progress (the monitor may be left by a run interrupted by an exception)
+    m_progressCounter = nullptr;
+    m_progressMonitor.reset();
+    if (m_cbMsecInterval > 0) {
+        m_progressMonitor.reset(new ProgressMonitor(m_cbMsecInterval));
+        m_progressCounter = &m_progressMonitor->addCounter();
+        m_progressMonitor->start();
+    }
 
     // Clear termination request flag
     m_terminationRequested = false;
 
+    // Collect light path vertices if requested
+    m_vertexCache.reset();
+    if (!m_options.vertexOutputFileName.isEmpty())
+        m_vertexCache.reset(new LightVertexCache(m_options.maxVertexCount));
+
     try {
         // Emit rays from light sources
-        foreach (const LightSource::Ptr& light, lights) {
-            light->emitRays(raysPerLight, *this);
+        for (std::size_t i=0; i<lights.size(); ++i) {
+            m_currentLightGroup = m_options.lightCanvases ?   lightGroups.indexOf(lightGroup(i)) :   -1;
+            lights[i]->emitRays(raysPerLight, *this);
         }
     }
     catch (const RayTracerTerminationException&)
     {
     }
+    m_currentLightGroup = -1;
+    m_progressCounter = nullptr;
+    m_progressMonitor.reset();
 
-    if (m_cbMsecInterval > 0)
-        // Invoke the progress callback last time
-        m_cb(1.0f, true, m_lastRayNumber);
+    if (m_vertexCache) {
+        m_vertexCache->save(m_options.vertexOutputFileName);
+        m_vertexCache.reset();
+    }
+}
+
+void RayTracer::compileMaterials(const std::vector<Primitive*>& primitives)
+{
+    m_materials.clear();
+    m_materialTable.clear();
+    std::map<const SurfaceProperties*, int> ids;
+    for (Primitive *p : primitives) {
+        SurfaceProperties::Ptr surfProp = p->surfaceProperties();
+        Q_ASSERT(surfProp);
+        auto it = ids.find(surfProp.get());
+        if (it == ids.end()) {
+            it = ids.insert(std::make_pair(surfProp.get(), static_cast<int>(m_materials.size()))).first;
+            m_materials.push_back(surfProp);
+            m_materialTable.push_back(surfProp.get());
+        }
+        p->setMaterialId(it->second);
+    }
 }
 
 void RayTracer::requestTermination()
@@ -270,12 +578,11 @@ void RayTracer::requestTermination()
     m_terminationRequested = true;
 }
 
-void RayTracer::setProgressCallback(ProgressCallback cb, int msecInterval, quint64 raysGranularity)
+void RayTracer::setProgressCallback(ProgressCallback cb, int msecInterval)
 {
     Q_ASSERT(cb);
     m_cb = cb;
     m_cbMsecInterval = msecInterval;
-    m_cbRaysGranularity = raysGranularity;
 }
 
 void RayTracer::setImageProcessor(const ImageProcessor::Ptr& imageProcessor)
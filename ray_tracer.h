@@ -10,14 +10,16 @@
 #include "serial.h"
 #include "ray.h"
 #include "image_processor.h"
-
-#include <QTime>
+#include "light_vertex_cache.h"
+#include "progress_monitor.h"
 
 // deBUG, TODO: Comment out
 // #define DEBUG_RAY_BOUNCES
 
 namespace raytracer {
 
+class RayBatch;
+
 /// @brief Class responsible for the ray tracing algorithm in general.
 class RayTracer :
         public Readable
@@ -37,11 +39,56 @@ public:
         /// \brief Minimum ray parameter threshold for accepted collision.
         float rayParamThreshold;
 
+        /// \brief Name of the file to write light path vertices on diffuse surfaces to
+        /// (empty by default, meaning that vertices are not collected).
+        ///
+        /// See LightVertexCache.
+        QString vertexOutputFileName;
+
+        /// \brief Maximum number of light path vertices to keep.
+        quint64 maxVertexCount;
+
+        /// \brief Whether to accumulate contributions of each light group in a
+        /// separate camera canvas layer (false by default).
+        ///
+        /// See LightSource::group() and Camera::Canvas::relight().
+        bool lightCanvases;
+
+        /// \brief Whether to accumulate contributions of each ray generation
+        /// (i.e., number of reflections) in a separate camera canvas bounce layer
+        /// (false by default).
+        ///
+        /// Allows to preview images for any reflection limit up to #reflectionLimit
+        /// after rendering (see Camera::Canvas::limitBounces()). There are #reflectionLimit
+        /// bounce layers; the last generation is only kept in the canvas.
+        /// \note The preview is made of the same light paths; a render with a lower
+        /// limit would trace more paths within the same #totalRayLimit.
+        bool bounceCanvases;
+
+        /// \brief Whether camera canvases keep per-pixel sample statistics and features
+        /// of surfaces seen (false by default).
+        ///
+        /// See Camera::Canvas::setFeatureBuffers() and DenoiseImage.
+        bool featureCanvases;
+
+        /// \brief Whether to emit and trace rays from light sources (true by default).
+        ///
+        /// False means that cameras only render light path vertices collected by earlier
+        /// runs (see Camera::verticesInputFileName()) and replay rays from files; this is
+        /// required if any camera reads vertices, because traced light would add the
+        /// diffuse light of the vertices once again.
+        bool traceLight;
+
         Options() :
             totalRayLimit(100000),
             reflectionLimit(10),
             intensityThreshold(0.1f),
-            rayParamThreshold(1e-5f)
+            rayParamThreshold(1e-5f),
+            maxVertexCount(LightVertexCache::DefaultMaxVertexCount),
+            lightCanvases(false),
+            bounceCanvases(false),
+            featureCanvases(false),
+            traceLight(true)
         {
         }
 
@@ -61,6 +108,30 @@ public:
             rayParamThreshold = x;
             return *this;
         }
+        Options& setVertexOutputFileName(const QString& x) {
+            vertexOutputFileName = x;
+            return *this;
+        }
+        Options& setMaxVertexCount(quint64 x) {
+            maxVertexCount = x;
+            return *this;
+        }
+        Options& setLightCanvases(bool x) {
+            lightCanvases = x;
+            return *this;
+        }
+        Options& setBounceCanvases(bool x) {
+            bounceCanvases = x;
+            return *this;
+        }
+        Options& setFeatureCanvases(bool x) {
+            featureCanvases = x;
+            return *this;
+        }
+        Options& setTraceLight(bool x) {
+            traceLight = x;
+            return *this;
+        }
     };
     typedef std::function<void(float, bool, quint64)> ProgressCallback;
 
@@ -72,12 +143,20 @@ public:
     /// \brief Returns scene being visualized.
     Scene scene() const;
 
-    /// \brief Sets camera and returns *this.
+    /// \brief Sets the only camera and returns *this.
     RayTracer& setCamera(const Camera::Ptr& camera);
 
-    /// \brief Returns camera.
+    /// \brief Returns the first camera, or null if there are no cameras.
     Camera::Ptr camera() const;
 
+    /// \brief Sets cameras and returns *this.
+    ///
+    /// All cameras receive rays from the same light tracing pass.
+    RayTracer& setCameras(const std::vector<Camera::Ptr>& cameras);
+
+    /// \brief Returns all cameras.
+    const std::vector<Camera::Ptr>& cameras() const;
+
     /// \brief Sets options and returns *this.
     RayTracer& setOptions(const Options& options);
 
@@ -85,11 +164,80 @@ public:
     Options options() const;
 
     /// \brief Processes the ray specified.
+    ///
+    /// This method is called by surface properties to process secondary rays;
+    /// it only checks the total ray limit.
     void processRay(const Ray& ray);
 
-    /// \brief Reads scene and camera from variant
+    /// \brief Processes all rays of a batch emitted by a light source.
+    ///
+    /// Termination requests and the progress callback are checked once per batch.
+    void processRayBatch(const RayBatch& batch);
+
+    /// \brief Returns the store of light path vertices being collected, or null.
+    ///
+    /// The store exists during run() if Options::vertexOutputFileName is specified;
+    /// diffuse surfaces add vertices to it.
+    LightVertexCache *vertexCache() const;
+
+    /// \brief Returns names of light groups of the scene, in the order of canvas layers.
+    ///
+    /// A light having no group (see LightSource::group()) is given
+    /// the name "light N", where N is its number in the scene, starting from one.
+    QStringList lightGroups() const;
+
+    /// \brief Returns the index of the group of the light whose rays are being traced,
+    /// if Options::lightCanvases is set, and -1 otherwise.
+    ///
+    /// Camera surface properties pass it to Camera::Canvas::add().
+    int currentLightGroup() const;
+
+    /// \brief Returns features of the surface the ray being traced comes from,
+    /// or null if they are not known (e.g., for rays emitted by light sources).
+    ///
+    /// Camera surface properties pass it to Camera::Canvas::add().
+    const SurfaceFeatures *raySourceFeatures() const;
+
+    /// \brief Sets features of the surface secondary rays come from,
+    /// for the lifetime of the object.
+    ///
+    /// Surface properties scattering light diffusely create it before calling processRay().
+    class RaySourceScope
+    {
+    public:
+        RaySourceScope(RayTracer& rayTracer, const SurfaceFeatures& features) :
+            m_rayTracer(rayTracer),
+            m_previous(rayTracer.m_raySourceFeatures)
+        {
+            rayTracer.m_raySourceFeatures = &features;
+        }
+        ~RaySourceScope() {
+            m_rayTracer.m_raySourceFeatures = m_previous;
+        }
+
+    private:
+        RayTracer& m_rayTracer;
+        const SurfaceFeatures *m_previous;
+    };
+
+    /// \brief Reads scene and cameras from variant
+    ///
+    /// Cameras are specified by the \c camera property, the \c cameras list, or both.
     void read(const QVariant& v);
 
+    /// \brief Reads options specified by \a v (the \c options property of the scene file);
+    /// options not specified keep their values.
+    void readOptions(const QVariant& v);
+
+    /// \brief Builds the primitive search structure and the material table for
+    /// the scene and cameras, unless they are built already.
+    ///
+    /// run() calls it; the structures are kept until the scene or cameras are set or read
+    /// again, so runs with different options (e.g., by the render server) skip this step.
+    /// Scene primitives must not be changed after the structures are built; camera primitives
+    /// re-created by Camera::clear() are replaced in the structures, as long as they stay in place.
+    void prepare();
+
     /// \brief Starts ray tracing.
     void run();
 
@@ -103,10 +251,10 @@ public:
     ///   - flag indicating the final call of the callback when the ray tracing finishes;
     ///   - total number of rays emitted.
     ///   .
-    /// \param msecInterval Interval, in milliseconds, between successive callback call;
-    /// \param raysGranularity Number of rays processed between successive time measurements.
-    /// Low values can have an impact on the performance!
-    void setProgressCallback(ProgressCallback cb, int msecInterval = 1000, quint64 raysGranularity = 100000);
+    /// \param msecInterval Interval, in milliseconds, between successive callback calls.
+    /// The interval is measured by a separate thread (see ProgressMonitor), and the callback
+    /// is called by the ray tracing thread between ray batches, so the canvas is consistent.
+    void setProgressCallback(ProgressCallback cb, int msecInterval = 1000);
 
     /// \brief Sets image processor
     void setImageProcessor(const ImageProcessor::Ptr& imageProcessor);
@@ -116,11 +264,23 @@ public:
 
 private:
     Scene m_scene;
-    Camera::Ptr m_camera;
+    std::vector<Camera::Ptr> m_cameras;
     ImageProcessor::Ptr m_imageProcessor;
     Options m_options;
 
     PrimitiveSearch m_psearch;
+
+    // Material table: surface properties of all primitives being traced,
+    // indexed by Primitive::materialId(). m_materials keeps the objects alive,
+    // m_materialTable gives direct access to them without reference counting.
+    std::vector<SurfaceProperties::Ptr> m_materials;
+    std::vector<const SurfaceProperties*> m_materialTable;
+    // Flags of camera screen materials; camera screens are transparent for rays
+    std::vector<bool> m_cameraMaterials;
+    void compileMaterials(const std::vector<Primitive*>& primitives);
+    // Camera primitives the search structure and the material table are prepared for
+    std::vector<Primitive::Ptr> m_preparedCameraPrimitives;
+    bool updateCameraPrimitives();
     struct CollisionData
     {
         const Primitive *primitive;
@@ -176,14 +336,23 @@ private:
         return ScopedBuf< CollisionData >(m_collisionDataBuffer, m_collisionDataBufferSize);
     }
 
+    void traceRay(const Ray& ray);
+
+    std::unique_ptr<LightVertexCache> m_vertexCache;
+    int m_currentLightGroup;
+    const SurfaceFeatures *m_raySourceFeatures;
+    QString lightGroup(int lightIndex) const;
+    bool isOccluded(const Ray& ray, float distance) const;
+    void renderVertices(const LightVertexCache& cache, Camera& camera);
+    void emitLight(const QStringList& lightGroups);
+
     quint64 m_lastRayNumber;
     ProgressCallback m_cb;
     int m_cbMsecInterval;
-    quint64 m_cbRaysGranularity;
-    QTime m_cbLastTime;
-    class ScopedCallbackCaller;
-    friend class ScopedCallbackCaller;
+    std::unique_ptr<ProgressMonitor> m_progressMonitor;
+    ProgressMonitor::Counter *m_progressCounter;
     bool m_terminationRequested;
+    bool m_prepared;
 
 #ifdef DEBUG_RAY_BOUNCES
     enum { DebugMaxRayBounceChains = 1000 };
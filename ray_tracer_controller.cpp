@@ -4,6 +4,8 @@
 
 #include <QPixmap>
 
+#include <algorithm>
+
 namespace raytracer {
 
 RayTracerThread::RayTracerThread(RayTracer& rt) :
@@ -34,6 +36,11 @@ RayTracerController::RayTracerController(RayTracer &rt, QObject *parent) :
     m_imageProcessor(rt.imageProcessor())
 {
     connect(&m_rtThread, SIGNAL(finished()), SLOT(rayTracerThreadFinished()));
+    m_previewRenderer.setImageProcessor(m_imageProcessor);
+    m_previewRenderer.start();
+    connect(&m_previewTimer, SIGNAL(timeout()), SLOT(previewTimerTimeout()));
+    setMaxFrameRate(10);
+    m_previewTimer.start();
 }
 
 void RayTracerController::start()
@@ -44,8 +51,7 @@ void RayTracerController::start()
     if (!camera)
         throw cxx::exception("There is no camera in the raytracer scene");
     m_rt.setProgressCallback([camera, this](float progress, bool, quint64 raysProcessed) {
-        QMutexLocker mtlk(&m_mutex);
-        emit rayTracerImageUpdated(QPixmap::fromImage((*m_imageProcessor)(camera->canvas()).toImage()));
+        m_previewRenderer.publish(camera->canvas());
         emit rayTracerProgress(progress, raysProcessed);
     });
     m_rtThread.start();
@@ -68,6 +74,7 @@ void RayTracerController::setImageProcessor(const ImageProcessor::Ptr& imageProc
 {
     QMutexLocker mtlk(&m_mutex);
     m_imageProcessor = imageProcessor;
+    m_previewRenderer.setImageProcessor(imageProcessor);
 }
 
 ImageProcessor::Ptr RayTracerController::imageProcessor() const
@@ -82,7 +89,33 @@ RayTracer& RayTracerController::rayTracer() const {
 }
 
 void RayTracerController::rayTracerThreadFinished() {
+    // The signal comes right before the thread finishes; make sure it is not running
+    m_rtThread.wait();
     emit rayTracerFinished(m_rtThread.error());
 }
 
+void RayTracerController::setMaxFrameRate(int framesPerSecond)
+{
+    m_previewTimer.setInterval(1000 / std::max(framesPerSecond, 1));
+}
+
+void RayTracerController::setPreviewSize(const QSize& size)
+{
+    m_previewRenderer.setPreviewSize(size);
+}
+
+void RayTracerController::updatePreview()
+{
+    Q_ASSERT(!isRunning());
+    if (Camera::Ptr camera = m_rt.camera())
+        m_previewRenderer.publish(camera->canvas());
+}
+
+void RayTracerController::previewTimerTimeout()
+{
+    QImage image;
+    if (m_previewRenderer.takePreview(image))
+        emit rayTracerImageUpdated(QPixmap::fromImage(image));
+}
+
 } // end namespace raytracer
@@ -4,7 +4,9 @@
 #include <QObject>
 #include <QThread>
 #include <QMutex>
+#include <QTimer>
 #include "image_processor.h"
+#include "preview_renderer.h"
 
 namespace raytracer {
 
@@ -41,6 +43,16 @@ public:
 
     RayTracer& rayTracer() const;
 
+    /// \brief Sets the maximum number of preview images shown per second (10 by default).
+    void setMaxFrameRate(int framesPerSecond);
+
+    /// \brief Sets the size of preview images (see PreviewRenderer::setPreviewSize()).
+    void setPreviewSize(const QSize& size);
+
+    /// \brief Makes a preview image of the current camera canvas; must only be called
+    /// when the ray tracer is not running.
+    void updatePreview();
+
 signals:
     void rayTracerImageUpdated(const QPixmap& pixmap);
     void rayTracerProgress(float progress, quint64 raysProcessed);
@@ -48,12 +60,18 @@ signals:
 
 private slots:
     void rayTracerThreadFinished();
+    void previewTimerTimeout();
 
 private:
     mutable QMutex m_mutex;
     RayTracer& m_rt;
     RayTracerThread m_rtThread;
     ImageProcessor::Ptr m_imageProcessor;
+
+    // The ray tracing thread publishes canvas snapshots to the renderer;
+    // the timer takes preview images from it at a limited rate
+    PreviewRenderer m_previewRenderer;
+    QTimer m_previewTimer;
 };
 
 } // end namespace raytracer
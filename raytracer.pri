@@ -0,0 +1,14 @@
+# Settings shared by the core library and the applications
+
+CONFIG += c++11
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+# TODO: Fix the code and get this warning back
+gcc:QMAKE_CXXFLAGS += -Wno-deprecated-declarations
+
+gcc:QMAKE_CXXFLAGS += -Wno-unused-local-typedefs
+
+# Image filter loops rely on auto-vectorization, which is not enabled by -O2 in older gcc
+gcc:QMAKE_CXXFLAGS_RELEASE += -ftree-vectorize
@@ -0,0 +1,89 @@
+/// \file
+/// \brief Implementation of the RenderClient class.
+
+#include "render_client.h"
+#include "render_message.h"
+#include "cxx_exception.h"
+
+#include <QLocalSocket>
+
+namespace raytracer {
+
+namespace {
+
+// Time to wait for the connection, in milliseconds
+const int ConnectTimeout = 10000;
+
+void connect(QLocalSocket& socket, const QString& serverName)
+{
+    socket.connectToServer(serverName);
+    if (!socket.waitForConnected(ConnectTimeout))
+        throw cxx::exception("Failed to connect to render server '" + serverName.toStdString() + "': " +
+                             socket.errorString().toStdString());
+}
+
+void throwIfError(const QVariantMap& reply)
+{
+    if (reply.value("type").toString() == "error")
+        throw cxx::exception("Render server error: " + reply.value("message").toString().toStdString());
+}
+
+} // anonymous namespace
+
+RenderClient::Result::Result() :
+    cached(false),
+    seconds(0)
+{
+}
+
+RenderClient::RenderClient(const QString& serverName) :
+    m_serverName(serverName)
+{
+}
+
+RenderClient::Result RenderClient::render(const QVariantMap& request, const ProgressCallback& progressCallback)
+{
+    QLocalSocket socket;
+    connect(socket, m_serverName);
+    QVariantMap message = request;
+    message["type"] = "render";
+    if (!progressCallback)
+        message["progress_interval"] = 0;
+    RenderMessage::send(socket, message);
+
+    Result result;
+    forever {
+        QVariantMap reply = RenderMessage::receive(socket);
+        throwIfError(reply);
+        QString type = reply.value("type").toString();
+        if (type == "progress") {
+            if (progressCallback)
+                progressCallback(reply.value("progress").toFloat(), reply.value("rays").toULongLong());
+        }
+        else if (type == "canvas") {
+            Output output;
+            output.camera = reply.value("camera").toString();
+            output.canvas = RenderMessage::readCanvas(reply, &output.info);
+            result.outputs.push_back(output);
+        }
+        else if (type == "done") {
+            result.cached = reply.value("cached").toBool();
+            result.seconds = reply.value("seconds").toDouble();
+            return result;
+        }
+        else
+            throw cxx::exception("Unexpected render server reply '" + type.toStdString() + "'");
+    }
+}
+
+void RenderClient::quit()
+{
+    QLocalSocket socket;
+    connect(socket, m_serverName);
+    QVariantMap message;
+    message["type"] = "quit";
+    RenderMessage::send(socket, message);
+    throwIfError(RenderMessage::receive(socket));
+}
+
+} // end namespace raytracer
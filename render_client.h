@@ -0,0 +1,63 @@
+/// \file
+/// \brief Declaration of the RenderClient class.
+
+#ifndef RENDER_CLIENT_H
+#define RENDER_CLIENT_H
+
+#include "canvas_file.h"
+
+#include <QVariantMap>
+
+#include <functional>
+#include <vector>
+
+namespace raytracer {
+
+/// \brief Client of the render server (see RenderServer).
+class RenderClient
+{
+public:
+    /// \brief Canvas of one camera rendered by the server.
+    struct Output
+    {
+        QString camera;
+        Camera::Canvas canvas;
+        CanvasFile::RenderInfo info;
+    };
+
+    /// \brief Reply to the render request.
+    struct Result
+    {
+        /// \brief Outputs of all cameras of the scene, in the order of cameras.
+        std::vector<Output> outputs;
+
+        /// \brief Whether the server had the scene prepared by an earlier job.
+        bool cached;
+
+        /// \brief Time spent by the server on the job, in seconds.
+        double seconds;
+
+        Result();
+    };
+
+    /// \brief Progress callback; parameters are the progress (from 0 to 1) and the number of rays traced.
+    typedef std::function<void(float, quint64)> ProgressCallback;
+
+    /// \brief Creates client of the server listening on local socket \a serverName.
+    explicit RenderClient(const QString& serverName);
+
+    /// \brief Sends the render \a request (see RenderServer for its properties) and waits for the result.
+    ///
+    /// Throws an exception if the connection fails or the server replies with an error.
+    Result render(const QVariantMap& request, const ProgressCallback& progressCallback = ProgressCallback());
+
+    /// \brief Makes the server quit.
+    void quit();
+
+private:
+    QString m_serverName;
+};
+
+} // end namespace raytracer
+
+#endif // RENDER_CLIENT_H
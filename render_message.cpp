@@ -0,0 +1,108 @@
+/// \file
+/// \brief Implementation of the RenderMessage class.
+
+#include "render_message.h"
+#include "cxx_exception.h"
+
+#include <QDataStream>
+
+#include <cstring>
+
+namespace raytracer {
+
+namespace {
+
+void failConnection(const QLocalSocket& socket)
+{
+    throw cxx::exception("Render server connection failed: " + socket.errorString().toStdString());
+}
+
+} // anonymous namespace
+
+void RenderMessage::send(QLocalSocket& socket, const QVariantMap& message)
+{
+    QByteArray payload;
+    {
+        QDataStream s(&payload, QIODevice::WriteOnly);
+        s.setVersion(QDataStream::Qt_5_0);
+        s << message;
+    }
+    if (static_cast<quint64>(payload.size()) > MaxSize)
+        throw cxx::exception("Render server message is too large");
+
+    // QDataStream writes byte arrays preceded by their size
+    QByteArray data;
+    QDataStream s(&data, QIODevice::WriteOnly);
+    s << payload;
+    if (socket.write(data) != data.size())
+        failConnection(socket);
+    while (socket.bytesToWrite() > 0)
+        if (!socket.waitForBytesWritten(-1))
+            failConnection(socket);
+}
+
+QVariantMap RenderMessage::receive(QLocalSocket& socket, int msecs)
+{
+    auto waitForData = [&](qint64 size) {
+        while (socket.bytesAvailable() < size)
+            if (!socket.waitForReadyRead(msecs))
+                failConnection(socket);
+    };
+
+    waitForData(sizeof(quint32));
+    quint32 size;
+    {
+        QDataStream s(socket.peek(sizeof(quint32)));
+        s >> size;
+    }
+    if (size > MaxSize)
+        throw cxx::exception("Invalid render server message");
+    waitForData(sizeof(quint32) + size);
+    socket.read(sizeof(quint32));
+    QByteArray payload = socket.read(size);
+
+    QVariantMap result;
+    QDataStream s(payload);
+    s.setVersion(QDataStream::Qt_5_0);
+    s >> result;
+    if (s.status() != QDataStream::Ok   ||   !result.contains("type"))
+        throw cxx::exception("Invalid render server message");
+    return result;
+}
+
+void RenderMessage::writeCanvas(QVariantMap& message, const Camera::Canvas& canvas, const CanvasFile::RenderInfo& info)
+{
+    message["width"] = canvas.size()[0];
+    message["height"] = canvas.size()[1];
+    message["pixels"] = canvas.empty() ?
+                QByteArray() :
+                QByteArray(reinterpret_cast<const char*>(&canvas[0][0]), canvas.length()*sizeof(v3f));
+    message["shard_index"] = info.shardIndex;
+    message["shard_count"] = info.shardCount;
+    message["ray_limit"] = info.rayLimit;
+    message["total_ray_limit"] = info.totalRayLimit;
+    message["seed"] = info.seed;
+}
+
+Camera::Canvas RenderMessage::readCanvas(const QVariantMap& message, CanvasFile::RenderInfo *info)
+{
+    int width = message.value("width").toInt();
+    int height = message.value("height").toInt();
+    QByteArray pixels = message.value("pixels").toByteArray();
+    if (width < 0   ||   height < 0   ||
+            static_cast<quint64>(pixels.size()) != static_cast<quint64>(width)*height*sizeof(v3f))
+        throw cxx::exception("Invalid canvas in render server message");
+    auto result = Camera::Canvas::uninitialized(mkv2i(width, height));
+    if (!result.empty())
+        std::memcpy(&result[0][0], pixels.constData(), pixels.size());
+    if (info) {
+        info->shardIndex = message.value("shard_index").toInt();
+        info->shardCount = message.value("shard_count").toInt();
+        info->rayLimit = message.value("ray_limit").toULongLong();
+        info->totalRayLimit = message.value("total_ray_limit").toULongLong();
+        info->seed = message.value("seed").toUInt();
+    }
+    return result;
+}
+
+} // end namespace raytracer
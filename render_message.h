@@ -0,0 +1,46 @@
+/// \file
+/// \brief Declaration of the RenderMessage class.
+
+#ifndef RENDER_MESSAGE_H
+#define RENDER_MESSAGE_H
+
+#include "canvas_file.h"
+
+#include <QLocalSocket>
+#include <QVariantMap>
+
+namespace raytracer {
+
+/// \brief Messages exchanged by the render server and its clients (see RenderServer).
+///
+/// A message is a QVariantMap serialized by QDataStream, preceded by its size;
+/// its \c type property identifies the message. Canvases are sent as raw floats.
+class RenderMessage
+{
+public:
+    /// \brief Maximum message size, in bytes.
+    static const quint32 MaxSize = 1u << 30;
+
+    /// \brief Sends \a message and waits until it is written.
+    ///
+    /// Throws an exception if the connection fails.
+    static void send(QLocalSocket& socket, const QVariantMap& message);
+
+    /// \brief Waits for the next message and returns it.
+    ///
+    /// Throws an exception if the connection fails, the message is invalid, or no message
+    /// arrives within \a msecs milliseconds (-1 means no time limit).
+    static QVariantMap receive(QLocalSocket& socket, int msecs = -1);
+
+    /// \brief Stores \a canvas and \a info in \a message.
+    static void writeCanvas(QVariantMap& message, const Camera::Canvas& canvas, const CanvasFile::RenderInfo& info);
+
+    /// \brief Restores canvas written by writeCanvas() from \a message.
+    ///
+    /// Throws an exception if the message has no valid canvas.
+    static Camera::Canvas readCanvas(const QVariantMap& message, CanvasFile::RenderInfo *info = nullptr);
+};
+
+} // end namespace raytracer
+
+#endif // RENDER_MESSAGE_H
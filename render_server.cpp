@@ -0,0 +1,190 @@
+/// \file
+/// \brief Implementation of the RenderServer class.
+
+#include "render_server.h"
+#include "render_message.h"
+#include "render_shard.h"
+#include "json_parser.h"
+#include "cxx_exception.h"
+
+#include <QLocalServer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QTime>
+
+namespace raytracer {
+
+namespace {
+
+// Time to wait for the request of a connected client, in milliseconds
+const int RequestTimeout = 10000;
+
+} // anonymous namespace
+
+RenderServer::RenderServer(const QString& name) :
+    m_name(name)
+{
+}
+
+void RenderServer::run()
+{
+    // Remove the socket left by a server that crashed
+    QLocalServer::removeServer(m_name);
+
+    QLocalServer server;
+    if (!server.listen(m_name))
+        throw cxx::exception("Render server failed to listen on '" + m_name.toStdString() + "': " +
+                             server.errorString().toStdString());
+    forever {
+        if (!server.waitForNewConnection(-1))
+            throw cxx::exception("Render server failed: " + server.errorString().toStdString());
+        std::unique_ptr<QLocalSocket> socket(server.nextPendingConnection());
+        if (!socket)
+            continue;
+        bool quitRequested = !serve(*socket);
+        socket->disconnectFromServer();
+        if (socket->state() != QLocalSocket::UnconnectedState)
+            socket->waitForDisconnected(RequestTimeout);
+        if (quitRequested)
+            return;
+    }
+}
+
+bool RenderServer::serve(QLocalSocket& socket)
+{
+    bool result = true;
+    try {
+        QVariantMap request = RenderMessage::receive(socket, RequestTimeout);
+        QString type = request.value("type").toString();
+        if (type == "render")
+            render(socket, request);
+        else if (type == "quit") {
+            QVariantMap reply;
+            reply["type"] = "done";
+            RenderMessage::send(socket, reply);
+            result = false;
+        }
+        else
+            throw cxx::exception("Unknown render server request '" + type.toStdString() + "'");
+    }
+    catch (const std::exception& e) {
+        QVariantMap reply;
+        reply["type"] = "error";
+        reply["message"] = QString::fromUtf8(e.what());
+        try {
+            RenderMessage::send(socket, reply);
+        }
+        catch (const std::exception&) {
+            // The client is gone
+        }
+    }
+    return result;
+}
+
+void RenderServer::render(QLocalSocket& socket, const QVariantMap& request)
+{
+    QTime time;
+    time.start();
+
+    QString dir = request.value("dir").toString();
+    if (!dir.isEmpty()   &&   !QDir::setCurrent(dir))
+        throw cxx::exception("Failed to change working directory to '" + dir.toStdString() + "'");
+
+    QVariantMap overrides = request.value("overrides").toMap();
+    QVariant optionOverrides = overrides.take("options");
+    RenderShard shard;
+    if (request.contains("shard"))
+        shard = RenderShard::parse(request.value("shard").toString());
+    bool cached;
+    CachedScene& entry = scene(request.value("scene").toString(), overrides, cached);
+    RayTracer& rayTracer = *entry.rayTracer;
+
+    // Options of the scene file, replaced by overrides, with the ray limit of the shard
+    rayTracer.setOptions(entry.options);
+    if (optionOverrides.isValid())
+        rayTracer.readOptions(optionOverrides);
+    auto options = rayTracer.options();
+    quint64 totalRayLimit = options.totalRayLimit;
+    options.totalRayLimit = shard.rayLimit(totalRayLimit);
+    rayTracer.setOptions(options);
+
+    // Keep the random number sequence going, unless the seed is specified
+    rnd::Seed baseSeed = rnd::seed();
+    if (request.contains("seed")   ||   shard.count() > 1) {
+        baseSeed = request.value("seed", 0).toUInt();
+        rnd::setSeed(shard.seed(baseSeed));
+    }
+
+    rayTracer.setProgressCallback([&](float progress, bool, quint64 rays) {
+        QVariantMap message;
+        message["type"] = "progress";
+        message["progress"] = progress;
+        message["rays"] = rays;
+        try {
+            RenderMessage::send(socket, message);
+        }
+        catch (const std::exception&) {
+            // The client is gone
+            rayTracer.requestTermination();
+        }
+    }, request.value("progress_interval", 1000).toInt());
+    rayTracer.run();
+
+    auto info = shard.renderInfo(totalRayLimit, baseSeed);
+    bool processed = request.value("processed").toBool();
+    for (const Camera::Ptr& camera : rayTracer.cameras()) {
+        QVariantMap message;
+        message["type"] = "canvas";
+        message["camera"] = camera->name();
+        RenderMessage::writeCanvas(
+                    message,
+                    processed ?   (*rayTracer.imageProcessor())(camera->canvas()) :   camera->canvas(),
+                    info);
+        RenderMessage::send(socket, message);
+    }
+
+    QVariantMap reply;
+    reply["type"] = "done";
+    reply["cached"] = cached;
+    reply["seconds"] = time.elapsed() / 1000.;
+    RenderMessage::send(socket, reply);
+}
+
+RenderServer::CachedScene& RenderServer::scene(const QString& fileName, const QVariantMap& overrides, bool& cached)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        throw cxx::exception("Unable to open input file '" + fileName.toStdString() + "'");
+    QByteArray contents = file.readAll();
+
+    QByteArray keyData;
+    {
+        QDataStream s(&keyData, QIODevice::WriteOnly);
+        s.setVersion(QDataStream::Qt_5_0);
+        s << contents << QDir::currentPath() << overrides;
+    }
+    QByteArray key = QCryptographicHash::hash(keyData, QCryptographicHash::Sha1);
+
+    for (auto it=m_cache.begin(); it!=m_cache.end(); ++it)
+        if (it->key == key) {
+            m_cache.splice(m_cache.begin(), m_cache, it);
+            cached = true;
+            return m_cache.front();
+        }
+
+    CachedScene entry;
+    entry.key = key;
+    entry.rayTracer = std::make_shared<RayTracer>();
+    entry.rayTracer->read(overrideProperties(parseJson(QString::fromUtf8(contents)), overrides));
+    entry.rayTracer->prepare();
+    entry.options = entry.rayTracer->options();
+    m_cache.push_front(entry);
+    if (m_cache.size() > MaxCachedScenes)
+        m_cache.pop_back();
+    cached = false;
+    return m_cache.front();
+}
+
+} // end namespace raytracer
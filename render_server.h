@@ -0,0 +1,72 @@
+/// \file
+/// \brief Declaration of the RenderServer class.
+
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include "ray_tracer.h"
+
+#include <QLocalSocket>
+
+#include <list>
+#include <memory>
+
+namespace raytracer {
+
+/// \brief Server rendering scenes on requests of clients connected to a local socket.
+///
+/// The server keeps recently used scenes read and prepared for tracing (see RayTracer::prepare()),
+/// keyed by the hash of scene file contents, working directory and overrides of properties
+/// other than options, so that subsequent jobs with the same scene only trace rays.
+/// Files referenced by the scene file are not hashed; a changed file is only
+/// read again when the scene leaves the cache.
+///
+/// Jobs are processed one at a time, in the order clients connect; all of them share
+/// the worker pool (see WorkerPool). Messages (see RenderMessage) are
+/// - client request \c render, with properties
+///   - \c scene, scene file name;
+///   - \c dir, working directory to resolve relative file names in;
+///   - \c overrides (optional), map of properties replacing those of the scene file
+///     (see overrideProperties()); overrides of \c options do not invalidate the cache;
+///   - \c shard (optional), shard specification (see RenderShard::parse());
+///   - \c seed (optional), base random number seed;
+///   - \c processed (optional), whether to apply the image processor of the scene to canvases;
+///   - \c progress_interval (optional), interval between \c progress replies, in milliseconds;
+///   .
+///   replied with \c progress messages (\c progress, \c rays), a \c canvas message for each camera
+///   (\c camera, canvas and render information, see RenderMessage::writeCanvas()), and a final
+///   \c done message (\c cached, \c seconds), or an \c error message (\c message);
+/// - client request \c quit, which makes run() return after replying \c done.
+class RenderServer
+{
+public:
+    /// \brief Maximum number of scenes kept.
+    enum { MaxCachedScenes = 8 };
+
+    /// \brief Creates server listening on local socket \a name.
+    explicit RenderServer(const QString& name);
+
+    /// \brief Serves clients until one of them sends the \c quit request.
+    ///
+    /// Throws an exception if the server fails to listen on the socket.
+    void run();
+
+private:
+    struct CachedScene
+    {
+        QByteArray key;
+        std::shared_ptr<RayTracer> rayTracer;
+        RayTracer::Options options;
+    };
+
+    QString m_name;
+    std::list<CachedScene> m_cache;     // Most recently used first
+
+    bool serve(QLocalSocket& socket);
+    void render(QLocalSocket& socket, const QVariantMap& request);
+    CachedScene& scene(const QString& fileName, const QVariantMap& overrides, bool& cached);
+};
+
+} // end namespace raytracer
+
+#endif // RENDER_SERVER_H
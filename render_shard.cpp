@@ -0,0 +1,135 @@
+/// \file
+/// \brief Implementation of the RenderShard class.
+
+#include "render_shard.h"
+#include "cxx_exception.h"
+
+#include <QFileInfo>
+
+#include <vector>
+
+namespace raytracer {
+
+namespace {
+
+void fail(const std::string& message, const QString& fileName)
+{
+    throw cxx::exception(message + " '" + QFileInfo(fileName).absoluteFilePath().toStdString() + "'");
+}
+
+} // anonymous namespace
+
+RenderShard::RenderShard() :
+    m_index(0),
+    m_count(1)
+{
+}
+
+RenderShard::RenderShard(int index, int count) :
+    m_index(index),
+    m_count(count)
+{
+    Q_ASSERT(count > 0   &&   index >= 0   &&   index < count);
+}
+
+RenderShard RenderShard::parse(const QString& spec)
+{
+    QStringList parts = spec.split('/');
+    bool indexOk = false;
+    bool countOk = false;
+    int index = parts.size() == 2 ?   parts[0].toInt(&indexOk) :   0;
+    int count = parts.size() == 2 ?   parts[1].toInt(&countOk) :   0;
+    if (!(indexOk   &&   countOk   &&   count > 0   &&   index >= 1   &&   index <= count))
+        throw cxx::exception("Invalid shard '" + spec.toStdString() + "', expected i/n with 1 <= i <= n");
+    return RenderShard(index-1, count);
+}
+
+int RenderShard::index() const {
+    return m_index;
+}
+
+int RenderShard::count() const {
+    return m_count;
+}
+
+quint64 RenderShard::rayLimit(quint64 totalRayLimit) const
+{
+    quint64 result = totalRayLimit / m_count;
+    if (static_cast<quint64>(m_index) < totalRayLimit % m_count)
+        ++result;
+    return result;
+}
+
+rnd::Seed RenderShard::seed(rnd::Seed baseSeed) const
+{
+    // Mix the shard index into the seed, so that shards of renders with adjacent
+    // base seeds do not share random number sequences
+    if (m_count == 1)
+        return baseSeed;
+    std::seed_seq seq { static_cast<quint32>(baseSeed), static_cast<quint32>(m_index), static_cast<quint32>(m_count) };
+    quint32 result;
+    seq.generate(&result, &result + 1);
+    return result;
+}
+
+CanvasFile::RenderInfo RenderShard::renderInfo(quint64 totalRayLimit, rnd::Seed baseSeed) const
+{
+    CanvasFile::RenderInfo result;
+    result.shardIndex = m_index;
+    result.shardCount = m_count;
+    result.rayLimit = rayLimit(totalRayLimit);
+    result.totalRayLimit = totalRayLimit;
+    result.seed = seed(baseSeed);
+    return result;
+}
+
+Camera::Canvas RenderShard::merge(const QStringList& fileNames, CanvasFile::RenderInfo *info)
+{
+    if (fileNames.isEmpty())
+        throw cxx::exception("No shards to merge");
+
+    Camera::Canvas result;
+    CanvasFile::RenderInfo resultInfo;
+    quint64 rayLimitSum = 0;
+    std::vector<bool> merged;
+    foreach (const QString& fileName, fileNames) {
+        CanvasFile::RenderInfo shardInfo;
+        auto canvas = CanvasFile::read(fileName, &shardInfo);
+        if (!shardInfo.isValid())
+            fail("Shard has no render information", fileName);
+        if (result.empty()) {
+            result = canvas;
+            resultInfo = shardInfo;
+            merged.assign(shardInfo.shardCount, false);
+        }
+        else {
+            if (shardInfo.shardCount != resultInfo.shardCount   ||
+                    shardInfo.totalRayLimit != resultInfo.totalRayLimit)
+                fail("Shard comes from a different render", fileName);
+            if (canvas.size()[0] != result.size()[0]   ||   canvas.size()[1] != result.size()[1])
+                fail("Shard canvas size differs from that of other shards", fileName);
+            result += canvas;
+        }
+        if (merged[shardInfo.shardIndex])
+            fail("Shard is already merged", fileName);
+        merged[shardInfo.shardIndex] = true;
+        rayLimitSum += shardInfo.rayLimit;
+    }
+
+    // Canvas pixels are sums of ray contributions, so the sum of all shards is the full render;
+    // scale the sum if shards are missing
+    if (rayLimitSum > 0   &&   rayLimitSum != resultInfo.totalRayLimit) {
+        float scale = static_cast<float>(static_cast<double>(resultInfo.totalRayLimit) / rayLimitSum);
+        for (auto& pixel : result)
+            pixel *= scale;
+    }
+
+    if (info) {
+        *info = CanvasFile::RenderInfo();
+        info->shardCount = 1;
+        info->rayLimit = info->totalRayLimit = resultInfo.totalRayLimit;
+    }
+    return result;
+}
+
+} // end namespace raytracer
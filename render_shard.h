@@ -0,0 +1,64 @@
+/// \file
+/// \brief Declaration of the RenderShard class.
+
+#ifndef RENDER_SHARD_H
+#define RENDER_SHARD_H
+
+#include "canvas_file.h"
+#include "rnd.h"
+
+#include <QStringList>
+
+namespace raytracer {
+
+/// \brief Part of a render done by one of several independent processes.
+///
+/// The ray limit of the render (see RayTracer::Options::totalRayLimit) is split between
+/// shards, and each shard seeds the random number generator with its own seed derived from
+/// a base seed common to all shards, so shards trace different light paths. Each process saves
+/// its raw canvas, along with render information, to an OpenEXR file (see CanvasFile), and
+/// merge() sums the canvases.
+class RenderShard
+{
+public:
+    /// \brief Creates the only shard of a render.
+    RenderShard();
+
+    /// \brief Creates shard \a index (zero-based) of \a count shards.
+    RenderShard(int index, int count);
+
+    /// \brief Parses shard specification "i/n", where i is the one-based shard index,
+    /// and n is the number of shards.
+    ///
+    /// Throws an exception if the specification is invalid.
+    static RenderShard parse(const QString& spec);
+
+    int index() const;
+    int count() const;
+
+    /// \brief Returns the part of \a totalRayLimit to be traced by this shard;
+    /// parts of all shards sum up to \a totalRayLimit.
+    quint64 rayLimit(quint64 totalRayLimit) const;
+
+    /// \brief Returns the seed of this shard, derived from \a baseSeed.
+    rnd::Seed seed(rnd::Seed baseSeed) const;
+
+    /// \brief Returns render information to be saved along with the canvas of this shard.
+    CanvasFile::RenderInfo renderInfo(quint64 totalRayLimit, rnd::Seed baseSeed) const;
+
+    /// \brief Reads canvases of shards from files \a fileNames and returns their sum.
+    ///
+    /// All files must come from the same render and have render information, and each shard
+    /// may only be merged once. If some shards are missing, the sum is scaled, so that its
+    /// brightness matches the full render. If \a info is not null, it receives render
+    /// information on the merged canvas.
+    static Camera::Canvas merge(const QStringList& fileNames, CanvasFile::RenderInfo *info = nullptr);
+
+private:
+    int m_index;
+    int m_count;
+};
+
+} // end namespace raytracer
+
+#endif // RENDER_SHARD_H
@@ -6,14 +6,31 @@ namespace raytracer {
 
 std::mt19937& rnd::gen()
 {
-    static std::mt19937 g {
+    static std::mt19937 g { seedValue() };
+    return g;
+}
+
+rnd::Seed rnd::seed()
+{
+    return seedValue();
+}
+
+void rnd::setSeed(Seed seed)
+{
+    seedValue() = seed;
+    gen().seed(seed);
+}
+
+rnd::Seed& rnd::seedValue()
+{
+    static Seed s {
 #ifdef FIXED_RANDOM_SEED
         12345
 #else // FIXED_RANDOM_SEED
         std::random_device()()
 #endif // FIXED_RANDOM_SEED
     };
-    return g;
+    return s;
 }
 
 } // end namespace raytracer
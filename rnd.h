@@ -8,7 +8,18 @@ namespace raytracer {
 class rnd
 {
 public:
+    typedef std::mt19937::result_type Seed;
+
     static std::mt19937& gen();
+
+    /// \brief Returns the seed the generator was last seeded with.
+    static Seed seed();
+
+    /// \brief Reseeds the generator.
+    static void setSeed(Seed seed);
+
+private:
+    static Seed& seedValue();
 };
 
 } // end namespace raytracer
@@ -1,4 +1,6 @@
 #include "scene.h"
+#include "lights/primitive_light.h"
+#include "surfprop/emissive_surface.h"
 
 /// \file
 /// \brief Implementation of the Scene class.
@@ -28,7 +30,14 @@ void Scene::read(const QVariant& v)
     auto m = safeVariantMap(v);
     using namespace std::placeholders;
     readProperty(m, "primitives", std::bind(&readTypedInstances<Primitive>, std::ref(m_primitives), _1));
-    readProperty(m, "lights", std::bind(&readTypedInstances<LightSource>, std::ref(m_lightSources), _1));
+    readOptionalProperty(m, "lights", std::bind(&readTypedInstances<LightSource>, std::ref(m_lightSources), _1));
+
+    // Add light sources for primitives with emissive surfaces
+    for (const Primitive::Ptr& primitive : m_primitives) {
+        auto emissive = std::dynamic_pointer_cast<EmissiveSurface>(primitive->surfaceProperties());
+        if (emissive)
+            m_lightSources.push_back(std::make_shared<PrimitiveLight>(primitive, *emissive));
+    }
 }
 
 } // end namespace raytracer
@@ -27,6 +27,8 @@ public:
 
     /// \brief Returns all light sources of the scene.
     ///
+    /// Besides light sources listed in the scene file, these include
+    /// a PrimitiveLight for each primitive with EmissiveSurface surface properties.
     /// \note The scene is responsible for the lifetime of all
     /// its light sources.
     const std::vector<LightSource::Ptr>& lightSources() const;
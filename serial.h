@@ -259,6 +259,21 @@ struct Readable
 };
 
 
+/// \brief Returns \a v with properties replaced by those of \a overrides.
+///
+/// Maps are merged recursively; other values, including lists, are replaced.
+inline QVariant overrideProperties(const QVariant& v, const QVariant& overrides)
+{
+    if (v.type() != QVariant::Map   ||   overrides.type() != QVariant::Map)
+        return overrides;
+    QVariantMap result = v.toMap();
+    QVariantMap m = overrides.toMap();
+    for (auto it=m.begin(); it!=m.end(); ++it)
+        result[it.key()] = overrideProperties(result.value(it.key()), it.value());
+    return result;
+}
+
+
 /// \brief File reader interface.
 struct FileReader :
     public FactoryMixin<FileReader>
@@ -6,10 +6,7 @@
 #include "transform.h"
 #include "ray_tracer.h"
 #include "ray.h"
-#include "cxx_exception.h"
-
-#include <QFile>
-#include <QFileInfo>
+#include "ray_file_writer.h"
 
 namespace raytracer {
 
@@ -20,28 +17,16 @@ class CameraSurfProp : public SurfaceProperties
 public:
     CameraSurfProp(
             const SimpleCamera::Geometry& geom,
-            const QString& raysOutputFileName,
+            const std::shared_ptr<RayFileWriter>& raysWriter,
             Camera::Canvas& canvas,
             const m4f& transform) :
         m_geom(geom),
-        m_raysOutputFileName(raysOutputFileName),
+        m_raysWriter(raysWriter),
         m_canvas(canvas),
         m_transform(transform),
         m_invTransform(transform.inv()),
         m_ST(projectionMatrix() * m_invTransform)
     {
-        if (m_raysOutputFileName.isEmpty())
-            m_writeRays = false;
-        else
-        {
-            QFileInfo fi(m_raysOutputFileName);
-            if (fi.exists())
-                throw cxx::exception(std::string("Rays output file '") + fi.absoluteFilePath().toStdString() + "' already exists");
-            m_raysOutputFile.setFileName(m_raysOutputFileName);
-            if (!m_raysOutputFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
-                throw cxx::exception(std::string("Failed to open rays output '") + fi.absoluteFilePath().toStdString() + "'");
-            m_writeRays = true;
-        }
     }
 
     void processCollision(
@@ -49,12 +34,8 @@ public:
             const SurfacePoint& surfacePoint,
             RayTracer& rayTracer) const
     {
-        Q_UNUSED(rayTracer);
-
-        if (m_writeRays) {
-            Camera::RayData rd(ray, sppos(surfacePoint));
-            m_raysOutputFile.write(rd.rawData(), sizeof(rd));
-        }
+        if (m_raysWriter)
+            m_raysWriter->write(ray, surfacePoint);
 
         //*
         v2f re; // Screen coordinates of ray origin
@@ -78,7 +59,7 @@ public:
             return;
 
         //*
-        m_canvas[xy] += ray.color;
+        Camera::splat(m_canvas, xy, ray, rayTracer);
         /*/
         auto& pixel = m_canvas[index];
         for (int i=0; i<3; ++i)
@@ -89,12 +70,10 @@ public:
 
 private:
     const SimpleCamera::Geometry& m_geom;
-    QString m_raysOutputFileName;
+    std::shared_ptr<RayFileWriter> m_raysWriter;
     Camera::Canvas& m_canvas;
     const m4f& m_transform;
     m4f m_invTransform;
-    bool m_writeRays;
-    mutable QFile m_raysOutputFile;
 
     typedef fsmx::MX< fsmx::Data< 3, 4, float > > m3x4f;
     m3x4f m_ST; // Transformation from world coordinates to screen coordinates
@@ -139,23 +118,40 @@ void SimpleCamera::clear()
 
     m_primitive->setName("camera screen");
 
+    RayFileFormat::Header header;
+    header.setCameraType("SimpleCamera");
+    header.setScreen(T, m_geometry.screenWidth(), m_geometry.screenHeight());
+    header.resolution[0] = m_geometry.resx;
+    header.resolution[1] = m_geometry.resy;
+    header.parameters[0] = m_geometry.fovy;
+    header.parameters[1] = m_geometry.aspect;
+    header.parameters[2] = m_geometry.dist;
+    header.parameters[3] = m_geometry.focusingDistance;
+    resetRaysWriter(header);
+
     m_primitive->setSurfaceProperties(std::make_shared<CameraSurfProp>(
-                                          m_geometry, m_raysOutputFileName, m_canvas, transform()));
-    if (!m_raysInputFileName.isEmpty())
-        readRays(m_raysInputFileName);
+                                          m_geometry, raysWriter(), m_canvas, transform()));
 }
 
 const Camera::Canvas& SimpleCamera::canvas() const {
     return m_canvas;
 }
 
+Camera::Canvas& SimpleCamera::canvas() {
+    return m_canvas;
+}
+
+SurfaceProperties::Ptr SimpleCamera::makeSurfaceProperties(Canvas& canvas) const
+{
+    return std::make_shared<CameraSurfProp>(
+                m_geometry, std::shared_ptr<RayFileWriter>(), canvas, transform());
+}
+
 void SimpleCamera::read(const QVariant &v)
 {
     Camera::read(v);
 
     m_geometry = Geometry();
-    m_raysOutputFileName.clear();
-    m_raysInputFileName.clear();
 
     QVariantMap m = safeVariantMap(v);
     readOptionalProperty(m, "geometry", [this](const QVariant& v) {
@@ -169,8 +165,6 @@ void SimpleCamera::read(const QVariant &v)
         readOptionalProperty(g.focusingDistance, m, "focus_dist");
         m_geometry = g;
     });
-    readOptionalProperty(m_raysOutputFileName, m, "write_rays");
-    readOptionalProperty(m_raysInputFileName, m, "read_rays");
 }
 
 const SimpleCamera::Geometry& SimpleCamera::geometry() const {
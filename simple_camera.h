@@ -73,6 +73,9 @@ public:
     Primitive::Ptr cameraPrimitive() const;
 
     const Canvas& canvas() const;
+    Canvas& canvas();
+
+    SurfaceProperties::Ptr makeSurfaceProperties(Canvas& canvas) const;
 
     void read(const QVariant &v);
 
@@ -82,8 +85,6 @@ public:
 private:
     Primitive::Ptr m_primitive;
     Geometry m_geometry;
-    QString m_raysOutputFileName;
-    QString m_raysInputFileName;
     Canvas m_canvas;
 };
 
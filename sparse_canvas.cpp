@@ -0,0 +1,80 @@
+/// \file
+/// \brief Implementation of the SparseCanvas class.
+
+#include "sparse_canvas.h"
+
+#include <algorithm>
+
+namespace raytracer {
+
+SparseCanvas::SparseCanvas() :
+    m_size(fsmx::zero<v2i>()),
+    m_tileCount(fsmx::zero<v2i>())
+{
+}
+
+SparseCanvas::SparseCanvas(const v2i& size) :
+    m_size(size),
+    m_tileCount(mkv2i((size[0] + TileSize - 1) / TileSize, (size[1] + TileSize - 1) / TileSize)),
+    m_tiles(m_tileCount[0]*m_tileCount[1])
+{
+}
+
+const v2i& SparseCanvas::size() const
+{
+    return m_size;
+}
+
+v3f SparseCanvas::pixel(const v2i& xy) const
+{
+    Q_ASSERT(xy[0] >= 0   &&   xy[0] < m_size[0]   &&   xy[1] >= 0   &&   xy[1] < m_size[1]);
+    const auto& tile = m_tiles[(xy[0] / TileSize) + (xy[1] / TileSize)*m_tileCount[0]];
+    return tile.empty() ?   fsmx::zero<v3f>() :   tile[(xy[0] % TileSize) + (xy[1] % TileSize)*TileSize];
+}
+
+int SparseCanvas::allocatedTileCount() const
+{
+    return std::count_if(m_tiles.begin(), m_tiles.end(), [](const std::vector<v3f>& tile) {
+        return !tile.empty();
+    });
+}
+
+void SparseCanvas::addTo(v3f *data, const v3f& factor) const
+{
+    for (int ty=0; ty<m_tileCount[1]; ++ty)
+        for (int tx=0; tx<m_tileCount[0]; ++tx) {
+            const auto& tile = m_tiles[tx + ty*m_tileCount[0]];
+            if (tile.empty())
+                continue;
+            int x0 = tx*TileSize;
+            int y0 = ty*TileSize;
+            int nx = std::min(static_cast<int>(TileSize), m_size[0] - x0);
+            int ny = std::min(static_cast<int>(TileSize), m_size[1] - y0);
+            for (int y=0; y<ny; ++y) {
+                const v3f *src = tile.data() + y*TileSize;
+                v3f *dst = data + x0 + (y0 + y)*m_size[0];
+                for (int x=0; x<nx; ++x)
+                    for (int i=0; i<3; ++i)
+                        dst[x][i] += src[x][i]*factor[i];
+            }
+        }
+}
+
+SparseCanvas& SparseCanvas::operator+=(const SparseCanvas& that)
+{
+    Q_ASSERT(m_size[0] == that.m_size[0]   &&   m_size[1] == that.m_size[1]);
+    for (std::size_t i=0; i<m_tiles.size(); ++i) {
+        const auto& src = that.m_tiles[i];
+        if (src.empty())
+            continue;
+        auto& dst = m_tiles[i];
+        if (dst.empty())
+            dst = src;
+        else
+            for (std::size_t j=0; j<dst.size(); ++j)
+                dst[j] += src[j];
+    }
+    return *this;
+}
+
+} // end namespace raytracer
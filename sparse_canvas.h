@@ -0,0 +1,60 @@
+/// \file
+/// \brief Declaration of the SparseCanvas class.
+
+#ifndef SPARSE_CANVAS_H
+#define SPARSE_CANVAS_H
+
+#include "common.h"
+
+#include <vector>
+
+namespace raytracer {
+
+/// \brief Image stored in square tiles allocated on first write.
+///
+/// Used for images most pixels of which can stay black, e.g., contributions
+/// of a light that illuminates a small part of the scene (see Camera::Canvas::layer()):
+/// memory is only spent on tiles that have received a contribution.
+class SparseCanvas
+{
+public:
+    /// \brief Number of pixels along each side of a tile.
+    enum { TileSize = 32 };
+
+    SparseCanvas();
+    explicit SparseCanvas(const v2i& size);
+
+    const v2i& size() const;
+
+    /// \brief Adds \a color to pixel \a xy, allocating its tile if necessary.
+    void add(const v2i& xy, const v3f& color)
+    {
+        Q_ASSERT(xy[0] >= 0   &&   xy[0] < m_size[0]   &&   xy[1] >= 0   &&   xy[1] < m_size[1]);
+        auto& tile = m_tiles[(xy[0] / TileSize) + (xy[1] / TileSize)*m_tileCount[0]];
+        if (tile.empty())
+            tile.assign(TileSize*TileSize, fsmx::zero<v3f>());
+        tile[(xy[0] % TileSize) + (xy[1] % TileSize)*TileSize] += color;
+    }
+
+    /// \brief Returns pixel value (zero for pixels of tiles not allocated).
+    v3f pixel(const v2i& xy) const;
+
+    /// \brief Returns the number of tiles allocated.
+    int allocatedTileCount() const;
+
+    /// \brief Adds pixels multiplied component-wise by \a factor to \a data,
+    /// which is an image of the same size stored row by row.
+    void addTo(v3f *data, const v3f& factor) const;
+
+    /// \brief Adds pixels of \a that, which must have the same size.
+    SparseCanvas& operator+=(const SparseCanvas& that);
+
+private:
+    v2i m_size;
+    v2i m_tileCount;
+    std::vector< std::vector<v3f> > m_tiles;
+};
+
+} // end namespace raytracer
+
+#endif // SPARSE_CANVAS_H
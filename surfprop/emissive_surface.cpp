@@ -0,0 +1,57 @@
+/// \file
+/// \brief Implementation of the EmissiveSurface class.
+
+#include "emissive_surface.h"
+#include "ray.h"
+#include "ray_tracer.h"
+
+namespace raytracer {
+
+REGISTER_GENERATOR(EmissiveSurface)
+
+EmissiveSurface::EmissiveSurface() :
+    m_color(mkv3f(1.f, 1.f, 1.f)),
+    m_twoSided(false)
+{
+}
+
+void EmissiveSurface::processCollision(
+    const Ray& ray,
+    const SurfacePoint& surfacePoint,
+    RayTracer& rayTracer) const
+{
+    // Just consume the ray; emission is done by PrimitiveLight
+    Q_UNUSED(ray);
+    Q_UNUSED(surfacePoint);
+    Q_UNUSED(rayTracer);
+}
+
+void EmissiveSurface::read(const QVariant &v)
+{
+    m_color = mkv3f(1.f, 1.f, 1.f);
+    m_twoSided = false;
+    readOptionalProperty(m_color, v, "color");
+    readOptionalProperty(m_twoSided, v, "two_sided");
+}
+
+v3f EmissiveSurface::color() const
+{
+    return m_color;
+}
+
+void EmissiveSurface::setColor(const v3f& color)
+{
+    m_color = color;
+}
+
+bool EmissiveSurface::isTwoSided() const
+{
+    return m_twoSided;
+}
+
+void EmissiveSurface::setTwoSided(bool twoSided)
+{
+    m_twoSided = twoSided;
+}
+
+} // end namespace raytracer
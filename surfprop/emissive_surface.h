@@ -0,0 +1,49 @@
+/// \file
+/// \brief Declaration of the EmissiveSurface class.
+
+#ifndef EMISSIVE_SURFACE_H
+#define EMISSIVE_SURFACE_H
+
+#include "surface_properties.h"
+#include "common.h"
+
+namespace raytracer {
+
+/// \brief Surface properties that turn a primitive into a light source.
+///
+/// The surface absorbs all incoming rays. For each primitive having
+/// these surface properties, the scene creates a PrimitiveLight
+/// that emits rays from the primitive surface.
+class EmissiveSurface : public SurfaceProperties
+{
+    DECL_GENERATOR(EmissiveSurface)
+public:
+    EmissiveSurface();
+
+    void processCollision(
+        const Ray& ray,
+        const SurfacePoint& surfacePoint,
+        RayTracer& rayTracer) const;
+    void read(const QVariant &v);
+
+    /// \brief Returns the color of emitted rays.
+    v3f color() const;
+
+    /// \brief Sets the color of emitted rays.
+    void setColor(const v3f& color);
+
+    /// \brief Returns true if both sides of the surface emit light,
+    /// false if only the side the surface normal points to does.
+    bool isTwoSided() const;
+
+    /// \brief Sets the two-sided emission flag.
+    void setTwoSided(bool twoSided);
+
+private:
+    v3f m_color;
+    bool m_twoSided;
+};
+
+} // end namespace raytracer
+
+#endif // EMISSIVE_SURFACE_H
@@ -26,6 +26,8 @@ void SimpleDiffuseSurface::processCollision(
             ray.color[2]*m_color[2]);
 
     v3f n = spnormal(surfacePoint);
+    if (LightVertexCache *vertexCache = rayTracer.vertexCache())
+        vertexCache->add(sppos(surfacePoint), dot(n, ray.dir) > 0 ?   -n :   n, color, m_translucency, ray.generation+1);
     bool reflect;
     if (m_translucency == 0.f)
         reflect = true;
@@ -37,6 +39,10 @@ void SimpleDiffuseSurface::processCollision(
         n = -n;
     v3f dir = randomPointOnUnitSemiSphere(n);
 
+    SurfaceFeatures features;
+    features.normal = n;
+    features.albedo = m_color;
+    RayTracer::RaySourceScope raySourceScope(rayTracer, features);
     rayTracer.processRay(Ray(
         sppos(surfacePoint),
         dir,
@@ -0,0 +1,13 @@
+# Round trips of canvases through the OpenEXR and PFM writers and readers (see canvas_file.h)
+
+include(../../raytracer.pri)
+include(../../core/core.pri)
+
+QT       = core gui network testlib
+
+TARGET = canvas_file_test
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+SOURCES += canvas_file_test.cpp
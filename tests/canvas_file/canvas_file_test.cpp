@@ -0,0 +1,110 @@
+/// \file
+/// \brief Tests of round trips of canvases through files written and read by CanvasFile.
+
+#include "canvas_file.h"
+
+#include <QtTest>
+
+using namespace raytracer;
+
+Q_DECLARE_METATYPE(raytracer::CanvasFile::Compression)
+
+namespace {
+
+// Canvas whose width and height are not multiples of tile sizes or of the numbers
+// of scan lines in compressed blocks, with pixel values exactly representable as halfs
+Camera::Canvas testCanvas()
+{
+    auto result = Camera::Canvas::uninitialized(mkv2i(200, 100));
+    for (int index=0, n=static_cast<int>(result.length()); index<n; ++index) {
+        auto xy = result.xy(index);
+        result[index] = mkv3f(xy[0] / 8.f, xy[1] / 4.f, (index % 7) * 0.25f);
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+class CanvasFileTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void renderInfo();
+};
+
+void CanvasFileTest::roundTrip_data()
+{
+    QTest::addColumn<QString>("suffix");
+    QTest::addColumn<bool>("halfPrecision");
+    QTest::addColumn<CanvasFile::Compression>("compression");
+    QTest::addColumn<int>("tileSize");
+
+    QTest::newRow("pfm") << "pfm" << false << CanvasFile::NoCompression << 0;
+    QTest::newRow("scan lines") << "exr" << false << CanvasFile::NoCompression << 0;
+    QTest::newRow("scan lines, zips") << "exr" << false << CanvasFile::ZipsCompression << 0;
+    QTest::newRow("scan lines, zip, half") << "exr" << true << CanvasFile::ZipCompression << 0;
+    QTest::newRow("tiles") << "exr" << false << CanvasFile::NoCompression << 64;
+    QTest::newRow("tiles, zip, half") << "exr" << true << CanvasFile::ZipCompression << 64;
+    // OpenEXR allows tiles larger than the image
+    QTest::newRow("large tiles") << "exr" << false << CanvasFile::NoCompression << 256;
+    QTest::newRow("large tiles, zip") << "exr" << false << CanvasFile::ZipCompression << 256;
+    QTest::newRow("large tiles, zip, half") << "exr" << true << CanvasFile::ZipCompression << 256;
+}
+
+void CanvasFileTest::roundTrip()
+{
+    QFETCH(QString, suffix);
+    QFETCH(bool, halfPrecision);
+    QFETCH(CanvasFile::Compression, compression);
+    QFETCH(int, tileSize);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto fileName = dir.path() + "/canvas." + suffix;
+
+    auto canvas = testCanvas();
+    CanvasFile::write(canvas, fileName, CanvasFile::Options()
+                      .setHalfPrecision(halfPrecision)
+                      .setCompression(compression)
+                      .setTileSize(tileSize));
+    auto result = CanvasFile::read(fileName);
+
+    QCOMPARE(result.size()[0], canvas.size()[0]);
+    QCOMPARE(result.size()[1], canvas.size()[1]);
+    for (int index=0, n=static_cast<int>(canvas.length()); index<n; ++index)
+        for (int i=0; i<3; ++i)
+            if (result[index][i] != canvas[index][i])
+                QFAIL(qPrintable(QString("pixel (%1, %2) differs")
+                                 .arg(canvas.xy(index)[0]).arg(canvas.xy(index)[1])));
+}
+
+void CanvasFileTest::renderInfo()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto fileName = dir.path() + "/canvas.exr";
+
+    CanvasFile::RenderInfo info;
+    info.shardIndex = 2;
+    info.shardCount = 3;
+    info.rayLimit = 1000;
+    info.totalRayLimit = 3000;
+    info.seed = 12345;
+    CanvasFile::write(testCanvas(), fileName, info, CanvasFile::Options().setTileSize(256));
+
+    CanvasFile::RenderInfo result;
+    CanvasFile::read(fileName, &result);
+    QVERIFY(result.isValid());
+    QCOMPARE(result.shardIndex, info.shardIndex);
+    QCOMPARE(result.shardCount, info.shardCount);
+    QCOMPARE(result.rayLimit, info.rayLimit);
+    QCOMPARE(result.totalRayLimit, info.totalRayLimit);
+    QCOMPARE(result.seed, info.seed);
+}
+
+QTEST_GUILESS_MAIN(CanvasFileTest)
+
+#include "canvas_file_test.moc"
@@ -0,0 +1,13 @@
+# Behavior of the edge-aware denoiser (see denoise_image.h)
+
+include(../../raytracer.pri)
+include(../../core/core.pri)
+
+QT       = core gui network testlib
+
+TARGET = denoise_image_test
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+SOURCES += denoise_image_test.cpp
@@ -0,0 +1,126 @@
+/// \file
+/// \brief Tests of the DenoiseImage image processor.
+
+#include "denoise_image.h"
+
+#include <QtTest>
+
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace raytracer;
+
+namespace {
+
+const int Width = 64;
+const int Height = 32;
+
+// Gray canvas whose pixel values are level(x) with uniform relative noise of +-10%
+Camera::Canvas noisyCanvas(const std::function<float(int)>& level)
+{
+    std::minstd_rand generator(1);
+    std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+    auto result = Camera::Canvas::uninitialized(mkv2i(Width, Height));
+    for (int index=0, n=static_cast<int>(result.length()); index<n; ++index) {
+        float value = level(result.xy(index)[0]) * (1.f + noise(generator));
+        result[index] = mkv3f(value, value, value);
+    }
+    return result;
+}
+
+// Variance of the first color component over columns [x0, x1)
+float variance(const Camera::Canvas& canvas, int x0, int x1)
+{
+    double sum = 0, squaredSum = 0;
+    int count = 0;
+    for (int y=0; y<Height; ++y)
+        for (int x=x0; x<x1; ++x) {
+            double value = canvas[mkv2i(x, y)][0];
+            sum += value;
+            squaredSum += value*value;
+            ++count;
+        }
+    double mean = sum / count;
+    return static_cast<float>(squaredSum/count - mean*mean);
+}
+
+bool equal(const std::vector<v3f>& a, const std::vector<v3f>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (std::size_t index=0; index<a.size(); ++index)
+        for (int i=0; i<3; ++i)
+            if (a[index][i] != b[index][i])
+                return false;
+    return true;
+}
+
+} // anonymous namespace
+
+class DenoiseImageTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void smoothsFlatRegion();
+    void keepsHardEdge();
+    void keepsFeatureBuffers();
+};
+
+void DenoiseImageTest::smoothsFlatRegion()
+{
+    auto canvas = noisyCanvas([](int) { return 1.f; });
+    auto result = DenoiseImage()(canvas);
+    QCOMPARE(result.size()[0], Width);
+    QCOMPARE(result.size()[1], Height);
+    float before = variance(canvas, 0, Width);
+    float after = variance(result, 0, Width);
+    QVERIFY2(after < 0.25f*before, qPrintable(QString("variance %1 -> %2").arg(before).arg(after)));
+}
+
+void DenoiseImageTest::keepsHardEdge()
+{
+    const int edge = Width / 2;
+    auto canvas = noisyCanvas([](int x) { return x < edge ?   0.1f :   10.f; });
+    auto result = DenoiseImage()(canvas);
+
+    // Pixels next to the edge are not mixed with pixels across it
+    for (int y=0; y<Height; ++y) {
+        float dark = result[mkv2i(edge-1, y)][0];
+        float bright = result[mkv2i(edge, y)][0];
+        QVERIFY2(dark > 0.08f   &&   dark < 0.12f, qPrintable(QString("dark pixel %1").arg(dark)));
+        QVERIFY2(bright > 8.f   &&   bright < 12.f, qPrintable(QString("bright pixel %1").arg(bright)));
+    }
+
+    // Both sides are still smoothed
+    QVERIFY(variance(result, 0, edge) < 0.5f*variance(canvas, 0, edge));
+    QVERIFY(variance(result, edge, Width) < 0.5f*variance(canvas, edge, Width));
+}
+
+void DenoiseImageTest::keepsFeatureBuffers()
+{
+    Camera::Canvas canvas(mkv2i(Width, Height));
+    canvas.setFeatureBuffers(true);
+    std::minstd_rand generator(2);
+    std::uniform_real_distribution<float> noise(0.5f, 1.5f);
+    SurfaceFeatures features;
+    features.normal = mkv3f(0.f, 0.f, 1.f);
+    features.albedo = mkv3f(0.5f, 0.5f, 0.5f);
+    for (int index=0, n=static_cast<int>(canvas.length()); index<n; ++index)
+        for (int sample=0; sample<4; ++sample) {
+            float value = noise(generator);
+            canvas.add(canvas.xy(index), mkv3f(value, value, value), -1, 0, &features);
+        }
+
+    auto result = DenoiseImage()(canvas);
+    QVERIFY(result.hasFeatureBuffers());
+    QVERIFY(result.sampleCounts() == canvas.sampleCounts());
+    QVERIFY(result.squaredLuminanceSums() == canvas.squaredLuminanceSums());
+    QVERIFY(equal(result.normalSums(), canvas.normalSums()));
+    QVERIFY(equal(result.albedoSums(), canvas.albedoSums()));
+}
+
+QTEST_GUILESS_MAIN(DenoiseImageTest)
+
+#include "denoise_image_test.moc"
@@ -0,0 +1,14 @@
+# Accuracy of fast math functions against the standard library (see math_util.h),
+# and benchmarks comparing their speed (e.g., run math_util_test -iterations 100)
+
+include(../../raytracer.pri)
+include(../../core/core.pri)
+
+QT       = core gui network testlib
+
+TARGET = math_util_test
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+SOURCES += math_util_test.cpp
@@ -0,0 +1,188 @@
+/// \file
+/// \brief Tests of the accuracy of fast math functions (see math_util.h) against
+/// the standard library, and benchmarks comparing their speed.
+
+#include "math_util.h"
+
+#include <QtTest>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <vector>
+
+using namespace raytracer;
+
+namespace {
+
+// Position of x in the ordered sequence of floats; the difference
+// of positions of two floats is the distance between them in ULPs
+qint64 floatIndex(float x)
+{
+    qint32 bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits < 0 ?   -static_cast<qint64>(bits & 0x7fffffff) :   bits;
+}
+
+float indexFloat(qint64 index)
+{
+    qint32 bits = static_cast<qint32>(index < 0 ?   -index | 0x80000000 :   index);
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// Every Step-th float of a domain is tested, to keep the test fast;
+// Step = 1 tests all floats, which takes minutes
+const int Step = 251;
+
+// Returns the maximum error of f over [lo, hi], in ULPs relative to the correctly
+// rounded result; the reference function is computed in double precision
+qint64 maxUlpError(float lo, float hi, const std::function<float(float)>& f, double (*reference)(double))
+{
+    qint64 result = 0;
+    for (qint64 i=floatIndex(lo), end=floatIndex(hi); i<=end; i+=Step) {
+        float x = indexFloat(i);
+        float expected = static_cast<float>(reference(x));
+        result = std::max(result, std::abs(floatIndex(f(x)) - floatIndex(expected)));
+    }
+    return result;
+}
+
+const int BenchmarkSize = 1 << 16;
+
+// Arguments of benchmarks, uniformly distributed over [lo, hi]
+std::vector<float> benchmarkArguments(float lo, float hi)
+{
+    std::vector<float> result(BenchmarkSize);
+    for (int i=0; i<BenchmarkSize; ++i)
+        result[i] = lo + (hi - lo)*i/(BenchmarkSize - 1);
+    return result;
+}
+
+} // anonymous namespace
+
+class MathUtilTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void sinCos();
+    void sinCosLargeArguments();
+    void atan();
+    void asin();
+
+    void benchSinCos_data();
+    void benchSinCos();
+    void benchAtan_data();
+    void benchAtan();
+    void benchAsin_data();
+    void benchAsin();
+};
+
+#define VERIFY_MAX_ERROR(error, maxError) \
+    QVERIFY2((error) <= (maxError), qPrintable(QString("error %1 exceeds %2").arg(error).arg(maxError)))
+
+void MathUtilTest::sinCos()
+{
+    const float pi = static_cast<float>(M_PI);
+    VERIFY_MAX_ERROR(maxUlpError(-pi, pi, fastSin, std::sin), 1);
+    VERIFY_MAX_ERROR(maxUlpError(-pi, pi, fastCos, std::cos), 1);
+}
+
+void MathUtilTest::sinCosLargeArguments()
+{
+    double error = 0;
+    for (qint64 i=floatIndex(-100.f), end=floatIndex(100.f); i<=end; i+=Step) {
+        float x = indexFloat(i);
+        float s, c;
+        fastSinCos(x, s, c);
+        error = std::max(error, std::fabs(s - std::sin(static_cast<double>(x))));
+        error = std::max(error, std::fabs(c - std::cos(static_cast<double>(x))));
+    }
+    VERIFY_MAX_ERROR(error, 8e-8);
+}
+
+void MathUtilTest::atan()
+{
+    const float maxFloat = std::numeric_limits<float>::max();
+    VERIFY_MAX_ERROR(maxUlpError(-maxFloat, maxFloat, fastAtan, std::atan), 3);
+}
+
+void MathUtilTest::asin()
+{
+    VERIFY_MAX_ERROR(maxUlpError(-1.f, 1.f, fastAsin, std::asin), 2);
+}
+
+void MathUtilTest::benchSinCos_data()
+{
+    QTest::addColumn<bool>("fast");
+    QTest::newRow("fast") << true;
+    QTest::newRow("libm") << false;
+}
+
+void MathUtilTest::benchSinCos()
+{
+    QFETCH(bool, fast);
+    auto x = benchmarkArguments(static_cast<float>(-M_PI), static_cast<float>(M_PI));
+    std::vector<float> s(BenchmarkSize), c(BenchmarkSize);
+    if (fast)
+        QBENCHMARK { fastSinCos(x.data(), s.data(), c.data(), BenchmarkSize); }
+    else
+        QBENCHMARK {
+            for (int i=0; i<BenchmarkSize; ++i) {
+                s[i] = std::sin(x[i]);
+                c[i] = std::cos(x[i]);
+            }
+        }
+}
+
+void MathUtilTest::benchAtan_data()
+{
+    benchSinCos_data();
+}
+
+void MathUtilTest::benchAtan()
+{
+    QFETCH(bool, fast);
+    auto x = benchmarkArguments(-10.f, 10.f);
+    std::vector<float> y(BenchmarkSize);
+    if (fast)
+        QBENCHMARK {
+            for (int i=0; i<BenchmarkSize; ++i)
+                y[i] = fastAtan(x[i]);
+        }
+    else
+        QBENCHMARK {
+            for (int i=0; i<BenchmarkSize; ++i)
+                y[i] = std::atan(x[i]);
+        }
+}
+
+void MathUtilTest::benchAsin_data()
+{
+    benchSinCos_data();
+}
+
+void MathUtilTest::benchAsin()
+{
+    QFETCH(bool, fast);
+    auto x = benchmarkArguments(-1.f, 1.f);
+    std::vector<float> y(BenchmarkSize);
+    if (fast)
+        QBENCHMARK {
+            for (int i=0; i<BenchmarkSize; ++i)
+                y[i] = fastAsin(x[i]);
+        }
+    else
+        QBENCHMARK {
+            for (int i=0; i<BenchmarkSize; ++i)
+                y[i] = std::asin(x[i]);
+        }
+}
+
+QTEST_GUILESS_MAIN(MathUtilTest)
+
+#include "math_util_test.moc"
@@ -0,0 +1,13 @@
+# Replay of rays files written by cameras (see RayReplay)
+
+include(../../raytracer.pri)
+include(../../core/core.pri)
+
+QT       = core gui network testlib
+
+TARGET = ray_replay_test
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+SOURCES += ray_replay_test.cpp
@@ -0,0 +1,129 @@
+/// \file
+/// \brief Tests of replaying rays written by cameras (see RayReplay).
+
+#include "ray_tracer.h"
+#include "json_parser.h"
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+using namespace raytracer;
+
+namespace {
+
+// Floor and wall lit by a point light; %1 is the list of cameras, %2 the ray limit
+const char *SceneTemplate = R"({
+    scene: {
+        primitives: [
+            ['Rectangle', {
+                width: 4,
+                height: 4,
+                surf_prop: ['SimpleDiffuseSurface', {color: [0.8, 0.8, 0.8]}]
+            }],
+            ['Rectangle', {
+                width: 4,
+                height: 2,
+                transform: ['CombinedTransform', [
+                    ['Translate', [0, 1, 1]],
+                    ['Rotate', {axis: [1, 0, 0], angle: 90}]]
+                ],
+                surf_prop: ['SimpleDiffuseSurface', {color: [0.9, 0.2, 0.2]}]
+            }]
+        ],
+        lights: [
+            ['PointLight', {
+                transform: ['Translate', [0.3, 0.2, 0.5]],
+                color: [1, 1, 1]
+            }]
+        ]
+    },
+    cameras: [%1],
+    options: {
+        max_rays: %2,
+        max_reflections: 4,
+        intensity_threshold: 0,
+        light_canvases: true,
+        feature_canvases: true
+    }
+})";
+
+const char *CameraTransform = R"(
+    transform: ['CombinedTransform', [
+        ['Translate', [0, -3, 1.2]],
+        ['Rotate', {axis: [1, 0, 0], angle: 70}]]
+    ])";
+
+QString simpleCamera(const QString& rays)
+{
+    return QString(R"(['SimpleCamera', {%1,
+        geometry: {fovy: 60, aspect: 1.5, dist: 1.5, resx: 120, resy: 80},
+        %2
+    }])").arg(CameraTransform, rays);
+}
+
+void render(RayTracer& rayTracer, const QString& cameras, quint64 rayLimit)
+{
+    rayTracer.read(parseJson(QString(SceneTemplate).arg(cameras).arg(rayLimit)));
+    rayTracer.run();
+}
+
+double sum(const Camera::Canvas& canvas)
+{
+    double result = 0;
+    for (const v3f& pixel : canvas)
+        result += pixel[0] + pixel[1] + pixel[2];
+    return result;
+}
+
+} // anonymous namespace
+
+class RayReplayTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void replaysIntoSameCamera();
+    void reprojectsCapturePlane();
+};
+
+void RayReplayTest::replaysIntoSameCamera()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString raysFileName = dir.path() + "/camera.rays";
+
+    RayTracer writer;
+    render(writer, simpleCamera(QString("write_rays: '%1'").arg(raysFileName)), 100000);
+    double written = sum(writer.camera()->canvas());
+    QVERIFY(written > 0);
+
+    // Nothing is traced, the whole image comes from the file
+    RayTracer reader;
+    render(reader, simpleCamera(QString("read_rays: '%1'").arg(raysFileName)), 0);
+    double replayed = sum(reader.camera()->canvas());
+
+    // Rays files keep colors as half precision numbers
+    QVERIFY(qAbs(replayed - written) < 1e-2 * written);
+}
+
+void RayReplayTest::reprojectsCapturePlane()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString raysFileName = dir.path() + "/plane.rays";
+
+    // The plane is in front of the camera, so the camera sees everything through it
+    RayTracer writer;
+    render(writer, QString(R"(['CapturePlane', {%1,
+        geometry: {width: 3, height: 3, resx: 64, resy: 64},
+        write_rays: '%2'
+    }])").arg(CameraTransform, raysFileName), 100000);
+    QVERIFY(sum(writer.camera()->canvas()) > 0);
+
+    RayTracer reader;
+    render(reader, simpleCamera(QString("read_rays: '%1'").arg(raysFileName)), 0);
+    QVERIFY(sum(reader.camera()->canvas()) > 0);
+}
+
+QTEST_GUILESS_MAIN(RayReplayTest)
+
+#include "ray_replay_test.moc"
@@ -0,0 +1,14 @@
+# Round trips of render jobs between a render server and a client in one process
+# (see render_server.h and render_client.h)
+
+include(../../raytracer.pri)
+include(../../core/core.pri)
+
+QT       = core gui network testlib
+
+TARGET = render_server_test
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+SOURCES += render_server_test.cpp
@@ -0,0 +1,202 @@
+/// \file
+/// \brief Tests of render jobs sent by RenderClient to a RenderServer running in the same process.
+
+#include "render_server.h"
+#include "render_client.h"
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QLocalSocket>
+
+#include <thread>
+
+using namespace raytracer;
+
+namespace {
+
+// Floor lit by a point light, seen by one camera
+const char *SceneText = R"({
+    scene: {
+        primitives: [
+            ['Rectangle', {
+                width: 4,
+                height: 4,
+                surf_prop: ['SimpleDiffuseSurface', {color: [0.8, 0.8, 0.8]}]
+            }]
+        ],
+        lights: [
+            ['PointLight', {
+                transform: ['Translate', [0.3, 0.2, 0.5]],
+                color: [1, 1, 1]
+            }]
+        ]
+    },
+    cameras: [
+        ['SimpleCamera', {
+            name: 'main',
+            transform: ['CombinedTransform', [
+                ['Translate', [0, -3, 1.2]],
+                ['Rotate', {axis: [1, 0, 0], angle: 70}]]
+            ],
+            geometry: {fovy: 60, aspect: 1.5, dist: 1.5, resx: 60, resy: 40}
+        }]
+    ],
+    options: {
+        max_rays: 20000,
+        max_reflections: 2
+    }
+})";
+
+double sum(const Camera::Canvas& canvas)
+{
+    double result = 0;
+    for (const v3f& pixel : canvas)
+        result += pixel[0] + pixel[1] + pixel[2];
+    return result;
+}
+
+} // anonymous namespace
+
+class RenderServerTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void rendersScene();
+    void reusesPreparedScene();
+    void rendersShard();
+    void repliesWithError();
+
+private:
+    QString m_serverName;
+    std::thread m_serverThread;
+    QString m_serverError;
+    QTemporaryDir m_dir;
+    QString m_sceneFileName;
+
+    QVariantMap request() const;
+};
+
+void RenderServerTest::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    m_sceneFileName = m_dir.path() + "/scene.scn";
+    QFile file(m_sceneFileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QVERIFY(file.write(SceneText) > 0);
+    file.close();
+
+    // The socket name is unique, so that tests run at the same time do not interfere
+    m_serverName = QString("raytracer_render_server_test_%1").arg(QCoreApplication::applicationPid());
+    m_serverThread = std::thread([this] {
+        try {
+            RenderServer(m_serverName).run();
+        }
+        catch (const std::exception& e) {
+            m_serverError = QString::fromUtf8(e.what());
+        }
+    });
+
+    // Wait until the server listens; it drops the probe connection, which sends no request
+    QElapsedTimer timer;
+    timer.start();
+    forever {
+        QLocalSocket socket;
+        socket.connectToServer(m_serverName);
+        if (socket.waitForConnected(1000))
+            break;
+        QVERIFY2(timer.elapsed() < 10000, "Render server does not listen");
+        QThread::msleep(10);
+    }
+}
+
+void RenderServerTest::cleanupTestCase()
+{
+    if (!m_serverThread.joinable())
+        return;
+    try {
+        RenderClient(m_serverName).quit();
+    }
+    catch (const std::exception& e) {
+        QWARN(e.what());
+    }
+    m_serverThread.join();
+    QVERIFY2(m_serverError.isEmpty(), qPrintable(m_serverError));
+}
+
+QVariantMap RenderServerTest::request() const
+{
+    QVariantMap result;
+    result["scene"] = m_sceneFileName;
+    result["dir"] = m_dir.path();
+    result["seed"] = 1234u;
+    return result;
+}
+
+void RenderServerTest::rendersScene()
+{
+    quint64 lastRays = 0;
+    auto result = RenderClient(m_serverName).render(request(), [&](float, quint64 rays) {
+        lastRays = rays;
+    });
+    QCOMPARE(static_cast<int>(result.outputs.size()), 1);
+    const auto& output = result.outputs[0];
+    QCOMPARE(output.camera, QString("main"));
+    QCOMPARE(output.canvas.size()[0], 60);
+    QCOMPARE(output.canvas.size()[1], 40);
+    QVERIFY(sum(output.canvas) > 0);
+    QVERIFY(!result.cached);
+    QVERIFY(lastRays > 0);
+    QCOMPARE(output.info.seed, 1234u);
+}
+
+void RenderServerTest::reusesPreparedScene()
+{
+    RenderClient client(m_serverName);
+    client.render(request());
+    auto result = client.render(request());
+    QVERIFY(result.cached);
+    QCOMPARE(static_cast<int>(result.outputs.size()), 1);
+    QVERIFY(sum(result.outputs[0].canvas) > 0);
+
+    // Overrides of options keep the scene prepared
+    auto r = request();
+    QVariantMap options;
+    options["max_rays"] = 5000;
+    QVariantMap overrides;
+    overrides["options"] = options;
+    r["overrides"] = overrides;
+    result = client.render(r);
+    QVERIFY(result.cached);
+    QCOMPARE(result.outputs[0].info.totalRayLimit, Q_UINT64_C(5000));
+}
+
+void RenderServerTest::rendersShard()
+{
+    auto r = request();
+    r["shard"] = "2/4";
+    auto result = RenderClient(m_serverName).render(r);
+    QCOMPARE(static_cast<int>(result.outputs.size()), 1);
+    const auto& info = result.outputs[0].info;
+    QVERIFY(info.isValid());
+    QCOMPARE(info.shardIndex, 1);
+    QCOMPARE(info.shardCount, 4);
+    QCOMPARE(info.totalRayLimit, Q_UINT64_C(20000));
+    QCOMPARE(info.rayLimit, Q_UINT64_C(5000));
+}
+
+void RenderServerTest::repliesWithError()
+{
+    auto r = request();
+    r["scene"] = m_dir.path() + "/missing.scn";
+    QVERIFY_EXCEPTION_THROWN(RenderClient(m_serverName).render(r), std::exception);
+
+    // The server keeps serving after an error
+    auto result = RenderClient(m_serverName).render(request());
+    QCOMPARE(static_cast<int>(result.outputs.size()), 1);
+}
+
+QTEST_GUILESS_MAIN(RenderServerTest)
+
+#include "render_server_test.moc"
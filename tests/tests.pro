@@ -0,0 +1,5 @@
+# Tests of the core library, run by 'make check'
+
+TEMPLATE = subdirs
+
+SUBDIRS = ray_replay math_util canvas_file denoise_image render_server
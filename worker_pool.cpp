@@ -0,0 +1,135 @@
+/// \file
+/// \brief Implementation of the WorkerPool class.
+
+#include "worker_pool.h"
+
+#include <QThread>
+
+#include <algorithm>
+
+namespace raytracer {
+
+namespace {
+
+// Number of workers of the shared pool; zero means QThread::idealThreadCount()
+int instanceThreadCount = 0;
+bool instanceCreated = false;
+
+} // anonymous namespace
+
+class WorkerPool::Worker : public QThread
+{
+public:
+    explicit Worker(WorkerPool& pool) : m_pool(pool) {}
+
+protected:
+    void run()
+    {
+        QMutexLocker lock(&m_pool.m_mutex);
+        forever {
+            while (!m_pool.m_stopRequested   &&   m_pool.m_nextTask >= m_pool.m_taskCount)
+                m_pool.m_taskAvailable.wait(&m_pool.m_mutex);
+            if (m_pool.m_stopRequested)
+                return;
+            m_pool.runTasks();
+        }
+    }
+
+private:
+    WorkerPool& m_pool;
+};
+
+
+
+WorkerPool::WorkerPool(int threadCount) :
+    m_task(nullptr),
+    m_taskCount(0),
+    m_nextTask(0),
+    m_unfinishedTaskCount(0),
+    m_stopRequested(false)
+{
+    for (int i=1; i<threadCount; ++i) {
+        m_workers.emplace_back(new Worker(*this));
+        m_workers.back()->start();
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stopRequested = true;
+        m_taskAvailable.wakeAll();
+    }
+    for (const auto& worker : m_workers)
+        worker->wait();
+}
+
+int WorkerPool::threadCount() const
+{
+    return m_workers.size() + 1;
+}
+
+void WorkerPool::run(int taskCount, const std::function<void(int)>& task)
+{
+    if (taskCount <= 0)
+        return;
+    QMutexLocker runLock(&m_runMutex);
+    QMutexLocker lock(&m_mutex);
+    m_task = &task;
+    m_taskCount = taskCount;
+    m_nextTask = 0;
+    m_unfinishedTaskCount = taskCount;
+    m_error = std::exception_ptr();
+    if (taskCount > 1)
+        m_taskAvailable.wakeAll();
+    runTasks();
+    while (m_unfinishedTaskCount > 0)
+        m_tasksFinished.wait(&m_mutex);
+    m_task = nullptr;
+    m_taskCount = 0;
+    if (m_error)
+        std::rethrow_exception(m_error);
+}
+
+WorkerPool& WorkerPool::instance()
+{
+    static WorkerPool pool(instanceThreadCount > 0 ?   instanceThreadCount :   std::max(1, QThread::idealThreadCount()));
+    instanceCreated = true;
+    return pool;
+}
+
+void WorkerPool::setInstanceThreadCount(int threadCount)
+{
+    Q_ASSERT(threadCount > 0);
+    Q_ASSERT(!instanceCreated);
+    instanceThreadCount = threadCount;
+}
+
+void WorkerPool::runTasks()
+{
+    while (m_nextTask < m_taskCount) {
+        int index = m_nextTask++;
+        const auto& task = *m_task;
+        m_mutex.unlock();
+        std::exception_ptr error;
+        try {
+            task(index);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        m_mutex.lock();
+        if (error) {
+            if (!m_error)
+                m_error = error;
+            // Skip remaining tasks
+            m_unfinishedTaskCount -= m_taskCount - m_nextTask;
+            m_nextTask = m_taskCount;
+        }
+        if (--m_unfinishedTaskCount == 0)
+            m_tasksFinished.wakeAll();
+    }
+}
+
+} // end namespace raytracer
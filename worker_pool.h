@@ -0,0 +1,71 @@
+/// \file
+/// \brief Declaration of the WorkerPool class.
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <functional>
+#include <exception>
+#include <memory>
+#include <vector>
+
+namespace raytracer {
+
+/// \brief Pool of threads running tasks of a parallel loop.
+///
+/// Threads are created once and wait for tasks between calls to run().
+class WorkerPool
+{
+public:
+    /// \brief Creates \a threadCount - 1 threads; the thread calling run() is the last worker.
+    explicit WorkerPool(int threadCount);
+
+    /// \brief Stops and deletes all threads.
+    ~WorkerPool();
+
+    /// \brief Returns the number of workers, including the thread calling run().
+    int threadCount() const;
+
+    /// \brief Calls \a task for each index in the range [0, \a taskCount) and returns
+    /// when all tasks are finished.
+    ///
+    /// Tasks are distributed among workers in the order of indices. If a task throws an
+    /// exception, remaining tasks are skipped, and the exception is rethrown by this method.
+    /// Calls from different threads are serialized; tasks must not call run().
+    void run(int taskCount, const std::function<void(int)>& task);
+
+    /// \brief Returns the pool shared by the application, having QThread::idealThreadCount() workers
+    /// unless another number is set by setInstanceThreadCount().
+    static WorkerPool& instance();
+
+    /// \brief Sets the number of workers of the shared pool.
+    ///
+    /// Must be called before the first call to instance(), which creates the pool.
+    static void setInstanceThreadCount(int threadCount);
+
+private:
+    class Worker;
+    friend class Worker;
+
+    std::vector< std::unique_ptr<Worker> > m_workers;
+    QMutex m_runMutex;
+    QMutex m_mutex;
+    QWaitCondition m_taskAvailable;
+    QWaitCondition m_tasksFinished;
+    const std::function<void(int)> *m_task;
+    int m_taskCount;
+    int m_nextTask;
+    int m_unfinishedTaskCount;
+    std::exception_ptr m_error;
+    bool m_stopRequested;
+
+    // Runs tasks while there are any; called with m_mutex locked
+    void runTasks();
+};
+
+} // end namespace raytracer
+
+#endif // WORKER_POOL_H